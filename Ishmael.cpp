@@ -23,6 +23,9 @@
  * #include <chrono>
  * #include <thread>
  * #include <string>
+ * #include <string_view>
+ * #include <array>
+ * #include <vector>
  * #include <atomic>
  * #include <exception>
  * #include <stdexcept>
@@ -30,9 +33,11 @@
  * #include <variant>
  * #include <memory>
  * #include <mutex>
+ * #include <random>
  * #include <cstdlib>
  * #include <dpp/snowflake.h>
  * #include <dpp/cluster.h>
+ * #include <dpp/coro.h>
  * #include <dpp/dispatcher.h>
  * #include <dpp/exception.h>
  * #include <dpp/appcommand.h>
@@ -44,11 +49,22 @@
  * #include <dpp/permissions.h>
  * #include <Ishmael.hpp>
  * #include <ICommands.hpp>
+ * #include <command_table.hpp>
+ * #include <command_registration.hpp>
  * #include <logger/logger.hpp>
  * #include <secrets/secrets.hpp>
  * #include <moderation/mod_utils.hpp>
+ * #include <moderation/permission_cache.hpp>
+ * #include <moderation/channel_permissions.hpp>
+ * #include <moderation/member_resolver.hpp>
+ * #include <moderation/mod_journal.hpp>
  * #include <other_utils/other_utils.hpp>
  * #include <console_utils/console_utils.hpp>
+ * #include <executor/executor.hpp>
+ * #include <rest_scheduler/rest_scheduler.hpp>
+ * #include <shutdown/shutdown.hpp>
+ * #include <backup/backup.hpp>
+ * #include <render/render.hpp>
  * #include <exception/exception.hpp>
  */
 
@@ -56,65 +72,100 @@
 
 std::chrono::steady_clock::time_point session_start_time;
 
-std::unordered_map<std::string, command_t> commands;
+std::array<command_t, command_table::size> commands;
 std::unordered_map<std::string, select_handler_t> select_handlers;
 
 // Global flag and pointer to signal the main loop
 static std::atomic_bool shutting_down{ false };
+static std::mutex bot_mtx; // Guards `bot_ptr`, the main loop swaps the cluster while a shutdown may be using it
 static dpp::cluster* bot_ptr{ nullptr };
 static std::thread shutdown_thread;
 
-static void initiate_shutdown() {
-	if (!bot_ptr) return;
+// Interactions that come in once a shutdown has started are answered with this
+static constexpr std::string_view shutting_down_reply{ "The bot is shutting down, please try again later." };
 
-	Logger::warn(true, "Shutdown signal received. Cleaning up commands.");
+// What the last `get_gateway_bot()` said about the identify budget, reconnects wait when it runs out
+static std::atomic<uint32_t> session_starts_remaining{ 1000 };
+static std::atomic<std::chrono::steady_clock::time_point> session_starts_reset_at{};
 
-	std::promise<void> global_delete_promise, guild_delete_promise;
-	std::future<void> global_delete_future{ global_delete_promise.get_future() }, guild_delete_future{ guild_delete_promise.get_future() };
+// Exponential backoff, 250 ms doubling up to 30 s, with the upper half jittered so shards don't retry in lockstep
+static std::chrono::milliseconds reconnect_delay(const uint32_t failed_attempts) {
+	static thread_local std::mt19937 rng{ std::random_device{}() };
 
-	// Set presence to DND
-	bot_ptr->set_presence(dpp::presence{ dpp::ps_dnd, dpp::at_listening, "shutdown signal" });
-
-	// Before trying to delete guild commands, first check if any are even registered
-	const std::atomic_bool are_guild_commands_registered{ []() -> bool {
-		for (const auto& pair : commands) if (pair.second.is_restricted_to_owners) return true;
-		return false;
-	}()};
-	
-	if (are_guild_commands_registered.load()) {
-		try {
-			bot_ptr->guild_bulk_command_delete(dpp::snowflake{ secrets.at("DEV_GUILD_ID") }, [&](const dpp::confirmation_callback_t& callback) {
-				if (callback.is_error()) Logger::exception(true, "Failed to bulk delete guild commands: {}", callback.get_error().message);
-				else Logger::info(true, "Successfully bulk deleted guild commands.");
-				guild_delete_promise.set_value();
-			});
-		}
-		catch (const std::exception& e) {
-			Logger::exception(true, "Exception during guild command deletion: {}", std::string{ e.what() });
-			guild_delete_promise.set_value();
-		}
+	const uint32_t shift{ std::min<uint32_t>(failed_attempts > 0 ? failed_attempts - 1 : 0, 7) };
+	const int64_t ceiling{ std::min<int64_t>(int64_t{ 250 } << shift, 30'000) };
+	std::uniform_int_distribution<int64_t> jitter{ ceiling / 2, ceiling };
+	return std::chrono::milliseconds{ jitter(rng) };
+}
+
+// Interactions that were queued for too long are answered with this, they would fail if handled this late
+static constexpr std::string_view too_late_reply{ "The bot is busy right now, please try again." };
+
+// The `JobDone` of each running coroutine command, by interaction ID, until its handler acknowledges
+static std::mutex command_strands_mtx;
+static std::unordered_map<uint64_t, CommandExecutor::JobDone> command_strands;
+
+void release_command_strand(const dpp::slashcommand_t& event) {
+	CommandExecutor::JobDone done{};
+	{
+		std::scoped_lock lock{ command_strands_mtx };
+		auto it{ command_strands.find(event.command.id) };
+		if (it == command_strands.end()) return;
+		done = std::move(it->second);
+		command_strands.erase(it);
 	}
-	else {
-		Logger::info(true, "Skipped deleting guild commands as none were registered.");
-		guild_delete_promise.set_value();
+	done();
+}
+
+// Starts a coroutine command and owns its event until the handler's task completes
+// `dpp::job` takes its parameters by value, hence the pointers
+// The guild's next command starts once the handler acknowledges, see `release_command_strand`, or when it completes
+static dpp::job run_command_coroutine(const command_t* command, dpp::cluster* bot, dpp::slashcommand_t event, CommandExecutor::JobDone done) {
+	// Lives in the coroutine frame, so shutdown waits for the handler and not just its first suspension
+	const auto in_flight{ pending_interactions.track() };
+
+	{
+		std::scoped_lock lock{ command_strands_mtx };
+		command_strands.insert_or_assign(event.command.id, std::move(done));
 	}
 
-	// Delete global commands
-	bot_ptr->global_bulk_command_delete([&](const dpp::confirmation_callback_t& callback) {
-		if (callback.is_error()) Logger::error(true, "Failed to bulk delete global commands: {}", callback.get_error().message);
-		else Logger::info(true, "Successfully bulk deleted all global commands.");
-		global_delete_promise.set_value();
-	});
+	try {
+		co_await command->coroutine(*bot, event);
+	}
+	catch (const std::exception& e) {
+		Logger::exception(false, "Exception escaped the `/{}` coroutine: {}", event.command.get_command_name(), std::string{ e.what() });
+	}
+	catch (...) {
+		Logger::exception(false, "Unknown exception escaped the `/{}` coroutine", event.command.get_command_name());
+	}
 
-	Logger::info(true, "Waiting for command deletions to complete");
-	global_delete_future.wait();
-	guild_delete_future.wait();
-	Logger::info(true, "Command cleanups finished!");
+	// A handler that returned before acknowledging, ex. on an early error
+	release_command_strand(event);
+}
 
-	// Now that cleanup is done, we can safely shut down the cluster
-	std::this_thread::sleep_for(std::chrono::seconds{ 2 });
-	bot_ptr->shutdown();
-	std::this_thread::sleep_for(std::chrono::seconds{ 2 });
+// Waits for everything that may still use a cluster: handlers, coroutine commands, and REST calls until their callbacks return
+static bool wait_session_idle(const std::chrono::steady_clock::time_point deadline) {
+	return command_executor.wait_idle(deadline) && pending_interactions.wait_idle(deadline)
+		&& rest_scheduler.wait_idle(deadline) && webhook_scheduler.wait_idle(deadline);
+}
+
+static void initiate_shutdown() {
+	// Held throughout, so the main loop can't swap the cluster out from under the shutdown
+	// Without a cluster (ex. between two sessions) the work is still drained, and the main loop won't start another one
+	std::scoped_lock lock{ bot_mtx };
+
+	// Commands stay registered on Discord across restarts, see `sync_commands`
+	Logger::warn(true, "Shutdown signal received.");
+
+	// Set presence to DND
+	if (bot_ptr) bot_ptr->set_presence(dpp::presence{ dpp::ps_dnd, dpp::at_listening, "shutdown signal" });
+
+	// Jobs are checkpointed and resumed on the next start, rather than drained
+	job_engine.pause_all();
+
+	// Queued handlers still need the gateway and REST to answer, so the cluster stays up until they're done
+	drain_for_shutdown(std::chrono::steady_clock::now() + shutdown_drain_deadline());
+	if (bot_ptr) bot_ptr->shutdown();
 }
 
 static void shutdown_signal_handler(const int signum) {
@@ -139,7 +190,147 @@ static BOOL WINAPI CtrlHandler(const DWORD FdwCtrlType) {
 }
 #endif // _WIN32
 
-int main() {
+static void attach_event_handlers(dpp::cluster& bot) {
+	bot.on_log([&](const dpp::log_t& event) {
+		if (event.severity == dpp::ll_warning) Logger::warn(false, event.message);
+		if (event.severity == dpp::ll_error) Logger::error(false, event.message);
+		if (event.severity == dpp::ll_critical) Logger::error(false, event.message);
+	});
+
+	// Keeps the permission checks of the moderation commands off D++'s cache lock
+	permission_cache.attach(bot);
+	channel_permissions.attach(bot);
+	member_resolver.attach(bot);
+
+	// Resumes the bulk jobs a previous cluster paused
+	job_engine.attach(bot);
+
+	// This event is fired when a user uses a slash command
+	bot.on_slashcommand([&bot](const dpp::slashcommand_t& event) {
+		// Read the interaction in place, `get_command_interaction()` would return a copy
+		const auto* interaction{ std::get_if<dpp::command_interaction>(&event.command.data) };
+		const std::string_view command_name{ interaction ? std::string_view{ interaction->name } : std::string_view{} };
+
+		// Route on the ID Discord assigned at registration
+		// Only commands registered before the ID was recorded fall back to their name
+		auto index{ interaction ? command_table::find_by_id(interaction->id) : std::nullopt };
+		if (!index.has_value() && interaction) {
+			index = command_table::find(command_name);
+
+			// A command whose ID is known but doesn't match is a stale copy, ex. left behind in another scope
+			if (index.has_value() && command_table::recorded_id(index.value()) != 0) {
+				event.reply(dpp::message("This command is outdated, please use the current `/" + std::string{ command_name } + "`.").set_flags(dpp::m_ephemeral));
+				Logger::warn(false, "Received `/{}` with the stale command ID {}", command_name, interaction->id.str());
+				return;
+			}
+		}
+
+		if (index.has_value() && (commands[index.value()].function || commands[index.value()].coroutine)) {
+			// Handlers run on the command executor so a slow one can't stall this shard's events
+			const uint32_t shard_id{ static_cast<uint32_t>((event.command.guild_id >> 22) % std::max<uint32_t>(bot.numshards, 1)) };
+			const command_t& command{ commands[index.value()] };
+
+			// Only one of the job and its expiry handler runs, so they share a single copy of the event
+			const auto queued_event{ std::make_shared<dpp::slashcommand_t>(event) };
+			const bool queued{ command_executor.submit_async(event.command.guild_id, shard_id, interaction_deadline(event.command.id, JobLane::Command),
+				[&bot, &command, queued_event](CommandExecutor::JobDone done) {
+					if (command.coroutine) run_command_coroutine(&command, &bot, std::move(*queued_event), std::move(done));
+					else {
+						command.function(bot, *queued_event);
+						done();
+					}
+				},
+				[queued_event] { queued_event->reply(dpp::message(std::string{ too_late_reply }).set_flags(dpp::m_ephemeral)); }) };
+
+			if (!queued) event.reply(dpp::message(std::string{ shutting_down_reply }).set_flags(dpp::m_ephemeral));
+		}
+		else {
+			event.reply(dpp::message("Unknown command").set_flags(dpp::m_ephemeral));
+			Logger::warn(false, "Received an unknown command: {}", command_name);
+		}
+	});
+
+	bot.on_select_click([&bot](const dpp::select_click_t& event) {
+		if (auto it{ select_handlers.find(event.custom_id) }; it != select_handlers.end()) {
+			// Found a handler
+			const auto& handler{ it->second };
+			const uint32_t shard_id{ static_cast<uint32_t>((event.command.guild_id >> 22) % std::max<uint32_t>(bot.numshards, 1)) };
+
+			// Select handlers may write the guild settings to disk, keep that off the gateway thread
+			const auto queued_event{ std::make_shared<dpp::select_click_t>(event) };
+			const bool queued{ command_executor.submit(event.command.guild_id, shard_id, interaction_deadline(event.command.id, JobLane::Component), [&bot, &handler, queued_event] {
+				const dpp::select_click_t& event{ *queued_event };
+
+				// Check permissions
+				const dpp::permission issuer_perms{ calculate_permissions(event.command.member) };
+				const bool is_owner{ event.command.member.is_guild_owner() };
+				const bool is_admin{ issuer_perms.has(dpp::p_administrator) };
+				const bool has_required_perms{ (issuer_perms & handler.required_permissions) == handler.required_permissions };
+
+				if (!is_owner && !is_admin && !has_required_perms) {
+					event.reply(dpp::message("You don't have the required permissions to use this menu.").set_flags(dpp::m_ephemeral));
+					return;
+				}
+
+				// Run the specific function
+				handler.function(bot, event);
+			},
+			[queued_event] { queued_event->reply(dpp::message(std::string{ too_late_reply }).set_flags(dpp::m_ephemeral)); }) };
+
+			// Answer rather than let the menu spin until Discord gives up on it
+			if (!queued) event.reply(dpp::message(std::string{ shutting_down_reply }).set_flags(dpp::m_ephemeral));
+		}
+		// If no handler is found, we simply ignore the click
+	});
+
+	// The gateway details belong to this cluster, a rebuilt cluster logs them again
+	const auto cluster_once{ std::make_shared<std::once_flag>() };
+
+	bot.on_ready([&bot, cluster_once](const dpp::ready_t& event) {
+		// Registration and its command IDs are process state, they survive a rebuilt cluster
+		if (dpp::run_once<struct register_bot_commands>()) sync_commands(bot);
+
+		std::call_once(*cluster_once, [&bot] {
+			// Log remaining connections on session startup
+			bot.get_gateway_bot([](const dpp::confirmation_callback_t& gateway_callback) {
+				if (gateway_callback.is_error()) {
+					Logger::error(true, "Failed to get gateway details: {}", gateway_callback.get_error().message);
+					return;
+				}
+
+				try {
+					const dpp::gateway gw{ gateway_callback.get<dpp::gateway>() };
+
+					// Remembered so reconnects don't identify more often than Discord allows
+					session_starts_remaining.store(gw.session_start_remaining);
+					session_starts_reset_at.store(std::chrono::steady_clock::now() + std::chrono::milliseconds{ gw.session_start_reset_after });
+
+					// Build a single string to prevent race conditions in the output
+					std::stringstream ss{};
+					ss << "Gateway Details:\n"
+						<< "  - Session Start Max Concurrency: " << gw.session_start_max_concurrency << "\n"
+						<< "  - Sessions Remaining: " << gw.session_start_remaining << "/" << gw.session_start_total << "\n"
+						<< "  - Session Start Reset After: " << convert_time(gw.session_start_reset_after / 1000);
+
+					Logger::info(true, ss.str());
+				}
+				catch (const std::bad_variant_access& e) {
+					Logger::exception(true, "Bad variant access on gateway callback: {}", std::string{ e.what() });
+				}
+			});
+		});
+
+		// Sets the bot's status. Here, "Listening to birds!"
+		bot.set_presence(dpp::presence{ dpp::ps_online, dpp::at_listening, "birds!" });
+
+		Logger::info(true, "Logged in as {}", bot.me.format_username());
+	});
+}
+
+int main(int argc, char* argv[]) {
+	// Backup maintenance runs instead of the bot, without the secrets or a connection
+	if (argc > 1) return run_backup_tool(std::vector<std::string_view>(argv + 1, argv + argc));
+
 	/*
 	* One Time Setup
 	* This outer try-catch handles the `secrets` map
@@ -159,6 +350,16 @@ int main() {
 			throw std::runtime_error("7-Zip not found in system path, `where 7z` return code: " + std::to_string(rc));
 
 		Logger::success("Secrets loaded successfully!");
+
+		// The owner mention and other constant reply fragments are built once
+		render::init();
+
+		// Settings, commands and handlers are process state, a crashed session doesn't lose them
+		load_guild_settings();
+		mod_journal.open("data/modlog.journal");
+		mod_journal.compact(journal_retention);
+		register_all_commands();
+		register_all_select_handlers();
 	}
 	catch (const std::exception& e) {
 		Logger::exception("Exception before startup: " + std::string{ e.what() });
@@ -171,14 +372,60 @@ int main() {
 
 	int exit_code{ EXIT_SUCCESS };
 
+	// The executor and the REST scheduler outlive the bot sessions below
+	command_executor.start(std::clamp<std::size_t>(std::thread::hardware_concurrency(), 2, 8));
+	rest_scheduler.start();
+	webhook_scheduler.start();
+	start_settings_writer();
+	backup_engine.start();
+
 	/*
 	* Bot Restart Loop
 	* Should any exception be thrown, the bot would automatically try to recover itself
-	* by restarting 10 seconds after the exception throw
+	* Reconnects back off exponentially with jitter, and a session that ran for a while resets the backoff
 	*/
+	std::unique_ptr<dpp::cluster> bot{};
+	// Clusters of crashed sessions whose work hadn't finished when they were replaced
+	std::vector<std::unique_ptr<dpp::cluster>> retired_clusters{};
+	uint32_t failed_attempts{ 0 };
+
 	while (!shutting_down.load()) {
-		dpp::cluster bot{ secrets.at("BOT_TOKEN") };
-		bot_ptr = &bot; // Assign the bot instance to the global ptr
+		if (bot) {
+			// Jobs checkpoint and stop queueing work against the old cluster
+			job_engine.pause_all();
+			// Buffered audit logs are flushed before the old cluster goes away, the next `start` binds the new one
+			audit_batcher.stop();
+			{
+				std::scoped_lock lock{ bot_mtx };
+				bot_ptr = nullptr;
+			}
+
+			// Handlers, coroutine commands and REST callbacks may still use the old cluster, so it is only freed once they're done
+			// Until then it stays alive without its gateway, and the next rebuild or the exit tries again
+			bot->shutdown();
+			retired_clusters.push_back(std::move(bot));
+			if (wait_session_idle(std::chrono::steady_clock::now() + std::chrono::seconds{ 2 })) retired_clusters.clear();
+			else Logger::warn(true, "Old session still has work in flight, keeping {} old clusters until it is done", retired_clusters.size());
+		}
+
+		// Don't burn the identify budget, Discord resets it once a day
+		if (session_starts_remaining.load() == 0) {
+			const auto reset_at{ session_starts_reset_at.load() };
+			Logger::warn(true, "No session starts left, waiting for the limit to reset");
+			while (!shutting_down.load() && std::chrono::steady_clock::now() < reset_at) std::this_thread::sleep_for(std::chrono::seconds{ 1 });
+			if (shutting_down.load()) break;
+		}
+		else session_starts_remaining.fetch_sub(1);
+
+		bot = std::make_unique<dpp::cluster>(secrets.at("BOT_TOKEN"));
+		attach_event_handlers(*bot);
+		{
+			std::scoped_lock lock{ bot_mtx };
+			// A shutdown that came in while there was no cluster has drained already
+			if (shutting_down.load()) break;
+			bot_ptr = bot.get(); // Assign the bot instance to the global ptr
+		}
+		audit_batcher.start(*bot, audit_batch_window());
 
 		try {
 			Logger::info(true, "Ishmael session starting");
@@ -194,102 +441,7 @@ int main() {
 			signal(SIGTERM, shutdown_signal_handler);
 #endif // _WIN32
 
-			bot.on_log([&](const dpp::log_t& event) {
-				if (event.severity == dpp::ll_warning) Logger::warn(false, event.message);
-				if (event.severity == dpp::ll_error) Logger::error(false, event.message);
-				if (event.severity == dpp::ll_critical) Logger::error(false, event.message);
-			});
-
-			load_guild_settings();
-			register_all_commands();
-			register_all_select_handlers();
-
-			// This event is fired when a user uses a slash command
-			bot.on_slashcommand([&bot](const dpp::slashcommand_t& event) {
-				const std::string command_name{ event.command.get_command_name() };
-
-				auto it{ commands.find(command_name) };
-
-				if (it != commands.end()) it->second.function(bot, event);
-				else {
-					event.reply(dpp::message("Unknown command").set_flags(dpp::m_ephemeral));
-					Logger::warn(false, "Received an unknown command: {}", command_name);
-				}
-			});
-
-			bot.on_select_click([&bot](const dpp::select_click_t& event) {
-				if (auto it{ select_handlers.find(event.custom_id) }; it != select_handlers.end()) {
-					// Found a handler
-					const auto& handler{ it->second };
-
-					// Check permissions
-					const dpp::permission issuer_perms{ calculate_permissions(event.command.member) };
-					const bool is_owner{ event.command.member.is_guild_owner() };
-					const bool is_admin{ issuer_perms.has(dpp::p_administrator) };
-					const bool has_required_perms{ (issuer_perms & handler.required_permissions) == handler.required_permissions };
-
-					if (!is_owner && !is_admin && !has_required_perms) {
-						event.reply(dpp::message("You don't have the required permissions to use this menu.").set_flags(dpp::m_ephemeral));
-						return;
-					}
-
-					// Run the specific function
-					handler.function(bot, event);
-				}
-				// If no handler is found, we simply ignore the click
-			});
-
-			bot.on_ready([&bot](const dpp::ready_t& event) {
-				if (dpp::run_once<struct register_bot_commands>()) {
-					for (const auto& pair : commands) {
-						dpp::slashcommand cmd{ pair.first, pair.second.description, bot.me.id };
-
-						for (const auto& opt : pair.second.options) cmd.add_option(opt);
-
-						cmd.set_default_permissions(pair.second.permissions);
-						cmd.set_dm_permission(false);
-
-						// If a command is restricted to only owners, create the command in their server
-						if (pair.second.is_restricted_to_owners) bot.guild_command_create(cmd, dpp::snowflake{ secrets.at("DEV_GUILD_ID") });
-						// Else, it is a global command
-						else bot.global_command_create(cmd);
-					}
-				}
-
-				if (dpp::run_once<struct initialize_backup_once>()) initialize_backups(bot);
-
-				// Log remaining connections on session startup
-				if (dpp::run_once<struct log_connections>()) {
-					bot.get_gateway_bot([&bot](const dpp::confirmation_callback_t& gateway_callback) {
-						if (gateway_callback.is_error()) {
-							Logger::error(true, "Failed to get gateway details: {}", gateway_callback.get_error().message);
-							return;
-						}
-
-						try {
-							const dpp::gateway gw{ gateway_callback.get<dpp::gateway>() };
-
-							// Build a single string to prevent race conditions in the output
-							std::stringstream ss{};
-							ss << "Gateway Details:\n"
-								<< "  - Session Start Max Concurrency: " << gw.session_start_max_concurrency << "\n"
-								<< "  - Sessions Remaining: " << gw.session_start_remaining << "/" << gw.session_start_total << "\n"
-								<< "  - Session Start Reset After: " << convert_time(gw.session_start_reset_after / 1000);
-
-							Logger::info(true, ss.str());
-						}
-						catch (const std::bad_variant_access& e) {
-							Logger::exception(true, "Bad variant access on gateway callback: {}", std::string{ e.what() });
-						}
-					});
-				}
-
-				// Sets the bot's status. Here, "Listening to birds!"
-				bot.set_presence(dpp::presence{ dpp::ps_online, dpp::at_listening, "birds!" });
-
-				Logger::info(true, "Logged in as {}", bot.me.format_username());
-			});
-			bot.start(dpp::st_wait);
+			bot->start(dpp::st_wait);
 		}
 		catch (const FatalError& e) {
 			exit_code = EXIT_FAILURE;
@@ -338,20 +490,34 @@ int main() {
 		Logger::warn(true, "Bot session ended");
 
 		// If `shutting_down` is false, the bot crashed
-		// We are to wait 10 seconds before trying to reconnect
 		if (!shutting_down.load()) {
-			Logger::warn(true, "Reconnecting in 10 seconds");
-			std::this_thread::sleep_for(std::chrono::seconds{ 10 });
-#ifdef _WIN32
-			if (std::system("cls")) Logger::error("'cls' failed");
-#else // ^^^ _WIN32 || !_WIN32
-			if (std::system("clear")) Logger::error("'clear' failed");
-#endif // _WIN32
+			// A session that stayed up for a while was healthy, start the backoff over
+			if (std::chrono::steady_clock::now() - session_start_time > std::chrono::seconds{ 60 }) failed_attempts = 0;
+			++failed_attempts;
+
+			const std::chrono::milliseconds delay{ reconnect_delay(failed_attempts) };
+			Logger::warn(true, "Reconnecting in {} ms (attempt {})", delay.count(), failed_attempts);
+			std::this_thread::sleep_for(delay);
 		}
 	}
 
 	// Wait for the shutdown thread to finish its work before exiting
 	if (shutdown_thread.joinable()) shutdown_thread.join();
+	{
+		std::scoped_lock lock{ bot_mtx };
+		bot_ptr = nullptr;
+	}
+
+	// Stopping sheds what is still queued, and the shed callbacks may still use a cluster, so the clusters go last
+	command_executor.stop();
+	rest_scheduler.stop();
+	webhook_scheduler.stop();
+	if (!wait_session_idle(std::chrono::steady_clock::now() + std::chrono::seconds{ 2 }))
+		Logger::warn(true, "{} interactions were still waiting on Discord at exit", pending_interactions.count());
+	bot.reset();
+	retired_clusters.clear();
+	backup_engine.stop();
+	stop_settings_writer();
 	Logger::info(true, "Bot has shutdown");
 	return exit_code;
 }
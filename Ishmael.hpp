@@ -23,6 +23,7 @@
 /*
  * The following includes are performed:
  * #include <vector>
+ * #include <array>
  * #include <unordered_map>
  * #include <string>
  * #include <functional>
@@ -30,7 +31,9 @@
  * #include <cstdint>
  * #include <dpp/dispatcher.h>
  * #include <dpp/cluster.h>
+ * #include <dpp/coro.h>
  * #include <logger/logger.hpp>
+ * #include <command_table.hpp>
  */
 
 #include <pch.hpp>
@@ -39,17 +42,25 @@
 // using command_function = std::function<void(dpp::cluster&, const dpp::slashcommand_t&)>;
 
 // A struct to hold information about a command
+// A command sets either `function` or `coroutine`
 struct command_t {
 	std::function<void(dpp::cluster&, const dpp::slashcommand_t&)> function;
+	// The event is owned by the coroutine frame that awaits the returned task, so the
+	// handler can keep using the reference across `co_await`s without copying the event
+	std::function<dpp::task<void>(dpp::cluster&, const dpp::slashcommand_t&)> coroutine;
 	std::string description;
 	uint64_t permissions;
 	bool is_restricted_to_owners{ false }; // Restriction to dev guild
 	std::vector<dpp::command_option> options;
 };
 
-// The global map that stores all commands
-// The key is the command's name
-extern std::unordered_map<std::string, command_t> commands;
+// Lets the guild's next command start while this coroutine command keeps running
+// Handlers call it once they acknowledged the interaction, so a long one (ex. `/mass_ban`) doesn't hold up the guild
+void release_command_strand(const dpp::slashcommand_t& event);
+
+// The global table that stores all commands
+// It is indexed by `command_table::index_of(name)`, so its layout is fixed at compile time
+extern std::array<command_t, command_table::size> commands;
 
 // Type alias for a function that handles a select menu click
 // using select_handler_function = std::function<void(dpp::cluster& bot, const dpp::select_click_t&)>;
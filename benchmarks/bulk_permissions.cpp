@@ -0,0 +1,95 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Compares the bulk permission evaluator with one pass per member over the same roles
+ * Synthetic guild: 200k members with 0 to 7 roles out of 300, every 1000th member has 150 roles
+ *
+ * The following includes are performed:
+ * #include <iostream>
+ * #include <vector>
+ * #include <random>
+ * #include <chrono>
+ * #include <format>
+ * #include <cstdint>
+ * #include <dpp/permissions.h>
+ * #include <moderation/bulk_permissions.hpp>
+ */
+
+#include <pch.hpp>
+
+static constexpr std::size_t member_count{ 200000 };
+static constexpr std::size_t role_count{ 300 };
+static constexpr int runs{ 20 };
+
+int main() {
+	std::mt19937_64 rng{ 1 };
+
+	// Slot 0 is the padding role
+	std::vector<uint64_t> role_masks(role_count + 1, 0);
+	for (std::size_t i{ 1 }; i <= role_count; ++i) role_masks[i] = rng() & rng() & rng();
+
+	std::vector<uint64_t> member_ids(member_count);
+	std::vector<uint32_t> offsets{ 0 }, slots{};
+	for (std::size_t i{ 0 }; i < member_count; ++i) {
+		member_ids[i] = i + 1;
+		const std::size_t roles{ i % 1000 == 0 ? 150 : rng() % 8 };
+		for (std::size_t j{ 0 }; j < roles; ++j) slots.push_back(static_cast<uint32_t>(1 + rng() % role_count));
+		offsets.push_back(static_cast<uint32_t>(slots.size()));
+	}
+
+	const uint64_t everyone{ role_masks[5] };
+	const uint64_t owner_id{ 77 };
+	const uint64_t required{ dpp::p_ban_members | dpp::p_moderate_members };
+	const PermissionTable table{ make_permission_table(everyone, owner_id, role_masks, member_ids, offsets, slots) };
+
+	std::vector<uint64_t> effective(member_count);
+	std::vector<uint8_t> allowed(member_count);
+	std::size_t bulk_allowed{ 0 };
+	auto bulk_best{ std::chrono::nanoseconds::max() };
+	for (int run{ 0 }; run < runs; ++run) {
+		const auto start{ std::chrono::steady_clock::now() };
+		evaluate_permissions(table, effective);
+		bulk_allowed = evaluate_allowed(table, effective, required, allowed);
+		bulk_best = std::min(bulk_best, std::chrono::steady_clock::now() - start);
+	}
+
+	// What the per-member path does: walk each member's roles and OR their masks
+	std::vector<uint64_t> naive(member_count);
+	std::size_t naive_allowed{ 0 };
+	auto naive_best{ std::chrono::nanoseconds::max() };
+	for (int run{ 0 }; run < runs; ++run) {
+		naive_allowed = 0;
+		const auto start{ std::chrono::steady_clock::now() };
+		for (std::size_t i{ 0 }; i < member_count; ++i) {
+			uint64_t perms{ everyone };
+			for (uint32_t j{ offsets[i] }; j < offsets[i + 1]; ++j) perms |= role_masks[slots[j]];
+			naive[i] = perms;
+			if ((perms & required) == required || (perms & dpp::p_administrator) || member_ids[i] == owner_id) ++naive_allowed;
+		}
+		naive_best = std::min(naive_best, std::chrono::steady_clock::now() - start);
+	}
+
+	std::size_t mismatches{ 0 };
+	for (std::size_t i{ 0 }; i < member_count; ++i) mismatches += effective[i] != naive[i] ? 1 : 0;
+
+	std::cout << std::format("bulk ({}): {} us, {} allowed, width {}, {} overflow slots\n", bulk_permissions_use_simd() ? "AVX2" : "scalar",
+		std::chrono::duration_cast<std::chrono::microseconds>(bulk_best).count(), bulk_allowed, table.width, table.overflow.size());
+	std::cout << std::format("per member: {} us, {} allowed\n", std::chrono::duration_cast<std::chrono::microseconds>(naive_best).count(), naive_allowed);
+	std::cout << std::format("mismatched members: {}\n", mismatches);
+	return mismatches == 0 && bulk_allowed == naive_allowed ? 0 : 1;
+}
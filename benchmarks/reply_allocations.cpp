@@ -0,0 +1,131 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Counts the heap allocations of the reply texts built with `render::` against the
+ * string concatenations and `std::format` calls they replaced
+ * The allocations of the text alone, the D++ message it ends up in isn't counted
+ *
+ * The following includes are performed:
+ * #include <iostream>
+ * #include <string>
+ * #include <vector>
+ * #include <format>
+ * #include <new>
+ * #include <cstdlib>
+ * #include <cstdint>
+ * #include <render/render.hpp>
+ */
+
+#include <pch.hpp>
+
+// This executable doesn't link `render.cpp`, so it counts with its own `operator new`
+static uint64_t allocations{ 0 };
+
+void* operator new(std::size_t size) {
+	++allocations;
+	if (void* p{ std::malloc(size == 0 ? 1 : size) }) return p;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+// Every text is moved in here, so the compiler can't drop an unused string and its allocation
+static std::vector<std::string> kept{};
+
+static void keep(std::string&& text) {
+	kept.push_back(std::move(text));
+}
+
+template <typename F>
+static uint64_t count_allocations(F&& f) {
+	const uint64_t before{ allocations };
+	f();
+	return allocations - before;
+}
+
+static void report(const std::string_view name, const uint64_t before, const uint64_t after) {
+	std::cout << std::format("{:<28} {:>3} -> {}\n", name, before, after);
+}
+
+int main() {
+	kept.reserve(64);
+	const std::string owner_id{ "123456789012345678" };
+	const uint64_t role_id{ 987654321098765432 };
+	const uint64_t user_id{ 123456789012345678 };
+
+	// Built once at startup by `render::init()`
+	constexpr render::Template<1> mention{ "<@{}>" };
+	constexpr render::Template<1> exception{ "An exception was thrown while processing this command. Please inform {} of this." };
+	const std::string exception_text{ exception(mention(owner_id)) };
+	report("exception reply",
+		count_allocations([&] { keep("An exception was thrown while processing this command. Please inform <@" + owner_id + "> of this."); }),
+		count_allocations([&] { keep(std::string{ exception_text }); }));
+
+	constexpr render::Template<2> role_added{ "Successfully added the <@&{}> role to <@{}>!" };
+	report("/role_add success reply",
+		count_allocations([&] { keep("Successfully added the <@&" + std::to_string(role_id) + "> role to <@" + std::to_string(user_id) + ">!"); }),
+		count_allocations([&] { keep(role_added(role_id, user_id)); }));
+
+	// The target list of a bulk audit log embed, capped at a field's length
+	const std::vector<uint64_t> targets(40, user_id);
+	constexpr render::Template<1> target_mention{ "<@{}> " };
+	report("40 target mentions",
+		count_allocations([&] {
+			std::string text{};
+			for (const uint64_t id : targets) {
+				const std::string part{ std::format("<@{}> ", id) };
+				if (text.size() + part.size() > 1000) break;
+				text += part;
+			}
+			keep(std::string{ text });
+		}),
+		count_allocations([&] {
+			render::Arena arena{};
+			std::pmr::string text{ arena.string() };
+			for (const uint64_t id : targets) {
+				const std::size_t before{ text.size() };
+				target_mention.append_to(text, id);
+				if (text.size() > 1000) {
+					text.resize(before);
+					break;
+				}
+			}
+			keep(render::to_string(text));
+		}));
+
+	report("/stats REST lanes field",
+		count_allocations([&] {
+			std::string text{};
+			for (int i{ 0 }; i < 4; ++i) text += std::format("{}: `{} ms` avg, `{}` shed\n", "Interaction", 12, 0);
+			keep(std::string{ text });
+		}),
+		count_allocations([&] {
+			render::Arena arena{};
+			std::pmr::string text{ arena.string() };
+			for (int i{ 0 }; i < 4; ++i) render::Arena::format_to(text, "{}: `{} ms` avg, `{}` shed\n", "Interaction", 12, 0);
+			keep(render::to_string(text));
+		}));
+
+	return 0;
+}
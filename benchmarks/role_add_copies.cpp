@@ -0,0 +1,197 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Counts what `/role_add` allocates to carry its state from the member lookup to the audit log,
+ * with the nested REST callbacks it used to have against the coroutines it runs as now
+ * Both shapes are driven the same way and their REST calls complete right away: the requests themselves,
+ * the reply and the audit log are the same in both and aren't counted
+ *
+ * The following includes are performed:
+ * #include <iostream>
+ * #include <string>
+ * #include <vector>
+ * #include <optional>
+ * #include <format>
+ * #include <new>
+ * #include <cstdlib>
+ * #include <cstdint>
+ * #include <dpp/dispatcher.h>
+ * #include <dpp/appcommand.h>
+ * #include <dpp/guild.h>
+ * #include <dpp/restresults.h>
+ * #include <dpp/coro.h>
+ */
+
+#include <pch.hpp>
+
+// Every allocation and its size, the bytes stand for what was copied into the new blocks
+static uint64_t allocations{ 0 };
+static uint64_t allocated_bytes{ 0 };
+
+void* operator new(std::size_t size) {
+	++allocations;
+	allocated_bytes += size;
+	if (void* p{ std::malloc(size == 0 ? 1 : size) }) return p;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+struct Usage {
+	uint64_t allocations{ 0 };
+	uint64_t bytes{ 0 };
+};
+
+template <typename F>
+static Usage measure(F&& f) {
+	const uint64_t allocations_before{ allocations };
+	const uint64_t bytes_before{ allocated_bytes };
+	f();
+	return Usage{ .allocations = allocations - allocations_before, .bytes = allocated_bytes - bytes_before };
+}
+
+static constexpr uint64_t guild_id{ 825407338755653642 };
+static constexpr uint64_t role_id{ 987654321098765432 };
+static constexpr uint64_t target_id{ 123456789012345678 };
+static constexpr uint64_t issuer_id{ 234567890123456789 };
+
+// Roughly what Discord sends for `/role_add role user reason`, with the issuer and the resolved target
+static dpp::slashcommand_t make_event() {
+	dpp::slashcommand_t event{};
+	event.raw_event = std::string(2400, ' ');
+
+	event.command.id = 1300000000000000000;
+	event.command.guild_id = guild_id;
+	event.command.token = std::string(220, 't');
+	event.command.locale = "en-GB";
+	event.command.guild_locale = "en-US";
+
+	event.command.usr.id = issuer_id;
+	event.command.usr.username = "issuer";
+	event.command.usr.global_name = "Issuer";
+	event.command.member.guild_id = guild_id;
+	event.command.member.user_id = issuer_id;
+	event.command.member.set_nickname("Issuer Nickname");
+	for (uint64_t i{ 1 }; i <= 6; ++i) event.command.member.add_role(role_id - i);
+
+	dpp::guild_member target{};
+	target.guild_id = guild_id;
+	target.user_id = target_id;
+	target.set_nickname("Target Nickname");
+	for (uint64_t i{ 10 }; i <= 13; ++i) target.add_role(role_id - i);
+	event.command.resolved.members.emplace(target_id, target);
+	dpp::user target_user{};
+	target_user.id = target_id;
+	target_user.username = "target";
+	event.command.resolved.users.emplace(target_id, target_user);
+
+	dpp::command_interaction data{};
+	data.id = 1200000000000000000;
+	data.name = "role_add";
+	data.options.push_back(dpp::command_data_option{ .name = "role", .type = dpp::co_role, .value = dpp::snowflake{ role_id } });
+	data.options.push_back(dpp::command_data_option{ .name = "user", .type = dpp::co_user, .value = dpp::snowflake{ target_id } });
+	data.options.push_back(dpp::command_data_option{ .name = "reason", .type = dpp::co_string, .value = std::string{ "Verified in #introductions" } });
+	event.command.data = data;
+	return event;
+}
+
+// Where the REST layer keeps a request's callback until its response arrives, reserved up front
+static std::vector<dpp::command_completion_event_t> pending_callbacks{};
+
+static void complete_next(const dpp::confirmation_callback_t& result) {
+	const dpp::command_completion_event_t callback{ std::move(pending_callbacks.front()) };
+	pending_callbacks.erase(pending_callbacks.begin());
+	callback(result);
+}
+
+static uint64_t audit_logs_sent{ 0 };
+
+// The callback chain `/role_add` had: each callback captures the event, and the last one the two members too
+static void callback_chain(const dpp::slashcommand_t& event) {
+	// `bot.guild_get_member(...)`
+	pending_callbacks.push_back([event](const dpp::confirmation_callback_t& target_callback) {
+		const dpp::guild_member target_user{ target_callback.get<dpp::guild_member>() };
+		const dpp::guild_member issuer_member{ event.command.member };
+
+		// `bot.guild_member_add_role(...)`
+		pending_callbacks.push_back([event, target_user, issuer_member](const dpp::confirmation_callback_t&) {
+			audit_logs_sent += target_user.user_id == target_id && issuer_member.user_id == issuer_id ? 1 : 0;
+		});
+	});
+}
+
+// The coroutines it runs as now: the event stays where the command's job put it and the members are read in place
+// Stands in for `member_resolver.co_resolve`, which hands out a copy of the member
+static dpp::task<std::optional<dpp::guild_member>> resolve_member(const dpp::guild_member& member) {
+	co_return std::optional<dpp::guild_member>{ member };
+}
+
+// Stands in for `rest_scheduler.co_submit`
+static dpp::task<dpp::confirmation_callback_t> add_role() {
+	co_return dpp::confirmation_callback_t{};
+}
+
+static dpp::task<void> handle_role_add(const dpp::slashcommand_t& event, const dpp::guild_member& target_member) {
+	const dpp::guild_member& issuer_member{ event.command.member };
+	const std::optional<dpp::guild_member> target{ co_await resolve_member(target_member) };
+	if (!target.has_value()) co_return;
+
+	co_await add_role();
+	audit_logs_sent += target->user_id == target_id && issuer_member.user_id == issuer_id ? 1 : 0;
+}
+
+// As `run_command_coroutine` starts it
+static dpp::job run_coroutine(const dpp::slashcommand_t* event, const dpp::guild_member* target_member) {
+	co_await handle_role_add(*event, *target_member);
+}
+
+static void report(const std::string_view name, const Usage usage) {
+	std::cout << std::format("{:<16} {:>3} allocations, {:>6} bytes\n", name, usage.allocations, usage.bytes);
+}
+
+int main() {
+	pending_callbacks.reserve(2);
+	const dpp::slashcommand_t event{ make_event() };
+	const dpp::guild_member& target_member{ event.command.resolved.members.at(target_id) };
+
+	// What the two REST calls hand back. 204 so `get()` doesn't try to parse an error out of the empty body
+	dpp::confirmation_callback_t member_result{};
+	member_result.value = target_member;
+	member_result.http_info.status = 204;
+	dpp::confirmation_callback_t role_result{};
+	role_result.http_info.status = 204;
+
+	const Usage callbacks{ measure([&] {
+		callback_chain(event);
+		complete_next(member_result);
+		complete_next(role_result);
+	}) };
+
+	const Usage coroutines{ measure([&] { run_coroutine(&event, &target_member); }) };
+
+	std::cout << std::format("sizeof(dpp::slashcommand_t) = {}, sizeof(dpp::guild_member) = {}\n", sizeof(dpp::slashcommand_t), sizeof(dpp::guild_member));
+	report("callback chain", callbacks);
+	report("coroutines", coroutines);
+	return audit_logs_sent == 2 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Compares log channel lookups behind one mutex, which a backup held while serializing,
+ * with the `GuildSettingsStore` `other_utils.cpp` reads and writes the settings through
+ * 20000 guilds, one writer changing a guild every 5 ms and a backup serializing every 100 ms
+ * The store's settings start in a mapped snapshot, and its backup writes a new snapshot like a checkpoint does
+ *
+ * The following includes are performed:
+ * #include <iostream>
+ * #include <vector>
+ * #include <random>
+ * #include <chrono>
+ * #include <thread>
+ * #include <atomic>
+ * #include <memory>
+ * #include <mutex>
+ * #include <format>
+ * #include <algorithm>
+ * #include <filesystem>
+ * #include <system_error>
+ * #include <cstdint>
+ * #include <guild_settings/guild_settings.hpp>
+ * #include <guild_settings/settings_state.hpp>
+ */
+
+#include <pch.hpp>
+
+static constexpr std::size_t guild_count{ 20000 };
+static constexpr auto run_time{ std::chrono::seconds{ 2 } };
+static constexpr auto write_interval{ std::chrono::milliseconds{ 5 } };
+static constexpr auto backup_interval{ std::chrono::milliseconds{ 100 } };
+
+// Before: every access takes the one mutex, the backup holds it while it serializes
+static GuildSettingsMap locked_settings{};
+static std::mutex settings_mutex;
+
+// Now: the store the bot uses, its writers ordered by a mutex as `settings_write_mutex` does
+static GuildSettingsStore store;
+static std::mutex write_mutex;
+
+// Where the initial snapshot and the backups' snapshots are written
+static const std::filesystem::path snapshot_dir{ std::filesystem::temp_directory_path() / "ishmael_settings_contention" };
+
+// Same lookup as `get_log_channel()`: the guilds changed since the snapshot first, then the snapshot
+static uint64_t log_channel(const GuildSettingsState& state, const uint64_t guild_id) {
+	if (const GuildSettings* changed{ state.changes.find(guild_id) }) return changed->log_channels[0];
+	const GuildSettingsRecord* record{ state.snapshot->find(guild_id) };
+	return record ? record->log_channels[0] : 0;
+}
+
+struct RunResult {
+	uint64_t lookups{ 0 };
+	std::chrono::nanoseconds worst_batch{ 0 };
+};
+
+template <bool UseStore>
+static RunResult run(const std::size_t readers, const std::vector<uint64_t>& guild_ids) {
+	std::atomic<bool> stop{ false };
+	std::atomic<uint64_t> sink{ 0 };
+	std::vector<RunResult> results(readers);
+
+	std::vector<std::thread> threads{};
+	for (std::size_t r{ 0 }; r < readers; ++r) {
+		threads.emplace_back([&, r] {
+			std::size_t next{ r };
+			uint64_t sum{ 0 };
+			while (!stop.load(std::memory_order_relaxed)) {
+				// Timed in batches, so the clock doesn't dominate a lookup
+				const auto start{ std::chrono::steady_clock::now() };
+				for (int i{ 0 }; i < 64; ++i) {
+					const uint64_t guild_id{ guild_ids[next++ % guild_ids.size()] };
+					if constexpr (UseStore) sum += log_channel(store.current(), guild_id);
+					else {
+						std::scoped_lock lock{ settings_mutex };
+						const GuildSettings* settings{ locked_settings.find(guild_id) };
+						sum += settings ? settings->log_channels[0] : 0;
+					}
+				}
+				results[r].worst_batch = std::max(results[r].worst_batch, std::chrono::steady_clock::now() - start);
+				results[r].lookups += 64;
+			}
+			sink += sum;
+		});
+	}
+
+	threads.emplace_back([&] {
+		std::mt19937_64 rng{ 7 };
+		while (!stop.load(std::memory_order_relaxed)) {
+			const uint64_t guild_id{ guild_ids[rng() % guild_ids.size()] };
+			if constexpr (UseStore) {
+				std::scoped_lock lock{ write_mutex };
+				if (std::shared_ptr<GuildSettingsState> next{ store.copy_with(SettingsChange{ .kind = SettingsChange::Kind::LogChannel, .guild_id = guild_id, .channel_id = guild_id, .command_type = CommandType::BanEdit }) }) {
+					store.publish(std::move(next));
+				}
+			}
+			else {
+				std::scoped_lock lock{ settings_mutex };
+				locked_settings.get_or_insert(guild_id).log_channels[1] = guild_id;
+			}
+			std::this_thread::sleep_for(write_interval);
+		}
+	});
+
+	threads.emplace_back([&] {
+		while (!stop.load(std::memory_order_relaxed)) {
+			if constexpr (UseStore) {
+				// Written with no lock held, as `checkpoint_guild_settings()` writes it
+				const std::shared_ptr<const GuildSettingsState> state{ store.load() };
+				sink += GuildSettingsSnapshot::write(snapshot_dir / "backup.bin", *state->snapshot, state->changes) ? 1 : 0;
+			}
+			else {
+				std::scoped_lock lock{ settings_mutex };
+				sink += guild_settings_to_json(locked_settings).dump().size();
+			}
+			std::this_thread::sleep_for(backup_interval);
+		}
+	});
+
+	std::this_thread::sleep_for(run_time);
+	stop = true;
+	for (std::thread& thread : threads) thread.join();
+
+	RunResult total{};
+	for (const RunResult& result : results) {
+		total.lookups += result.lookups;
+		total.worst_batch = std::max(total.worst_batch, result.worst_batch);
+	}
+	return total;
+}
+
+static void report(const std::string_view scheme, const std::size_t readers, const RunResult& result) {
+	std::cout << std::format("{:<10} {} readers: {:.1f} M lookups/s, worst batch of 64 {:.2f} ms\n", scheme, readers,
+		static_cast<double>(result.lookups) / std::chrono::duration<double>(run_time).count() / 1e6,
+		std::chrono::duration<double, std::milli>(result.worst_batch).count());
+}
+
+int main() {
+	std::mt19937_64 rng{ 1 };
+	std::vector<uint64_t> guild_ids(guild_count);
+	GuildSettingsMap initial{};
+	for (uint64_t& guild_id : guild_ids) {
+		guild_id = (rng() >> 4) | (uint64_t{ 1 } << 59);
+		initial.get_or_insert(guild_id).log_channels[0] = guild_id + 1;
+	}
+	locked_settings = initial;
+
+	// The store starts from a snapshot holding every guild, as after a restart
+	std::error_code ec{};
+	std::filesystem::create_directories(snapshot_dir, ec);
+	std::shared_ptr<GuildSettingsSnapshot> snapshot{ std::make_shared<GuildSettingsSnapshot>() };
+	if (!GuildSettingsSnapshot::write(snapshot_dir / "initial.bin", GuildSettingsSnapshot{}, initial) || !snapshot->open(snapshot_dir / "initial.bin")) {
+		std::cerr << std::format("Couldn't write a settings snapshot in {}\n", snapshot_dir.string());
+		return 1;
+	}
+	std::shared_ptr<GuildSettingsState> state{ std::make_shared<GuildSettingsState>() };
+	state->snapshot = std::move(snapshot);
+	store.publish(std::move(state));
+
+	std::cout << std::format("{} hardware threads\n", std::thread::hardware_concurrency());
+	for (const std::size_t readers : { std::size_t{ 2 }, std::size_t{ 8 } }) {
+		report("mutex", readers, run<false>(readers, guild_ids));
+		report("store", readers, run<true>(readers, guild_ids));
+	}
+
+	store.publish(std::make_shared<const GuildSettingsState>());
+	std::filesystem::remove_all(snapshot_dir, ec);
+	return 0;
+}
@@ -0,0 +1,181 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Compares loading the settings on startup from the mapped binary snapshot with parsing
+ * the `guild_settings.json` it replaced, in time and in resident memory
+ * 250000 guilds by default, or the count given as the first argument
+ * Each load runs in a new process started with `--load`, so neither finds the heap the other
+ * or the file generation left behind. Both files were just written, so they're read from the page cache
+ *
+ * The following includes are performed:
+ * #include <iostream>
+ * #include <fstream>
+ * #include <string>
+ * #include <string_view>
+ * #include <vector>
+ * #include <random>
+ * #include <chrono>
+ * #include <format>
+ * #include <filesystem>
+ * #include <system_error>
+ * #include <cstdlib>
+ * #include <cstdint>
+ * #include <Windows.h>
+ * #include <psapi.h>
+ * #include <unistd.h>
+ * #include <dpp/nlohmann/json.hpp>
+ * #include <guild_settings/guild_settings.hpp>
+ */
+
+#include <pch.hpp>
+
+#ifdef _WIN32
+	#include <psapi.h>
+#endif // _WIN32
+
+using json = nlohmann::json;
+
+static constexpr std::size_t default_guild_count{ 250000 };
+// Looked up after loading, the snapshot only pages in what these touch
+static constexpr std::size_t lookup_count{ 100000 };
+
+static const std::filesystem::path bench_dir{ std::filesystem::temp_directory_path() / "ishmael_settings_startup" };
+static const std::filesystem::path snapshot_path{ bench_dir / "guild_settings.bin" };
+static const std::filesystem::path json_path{ bench_dir / "guild_settings.json" };
+// The guild IDs to look up, written by the parent so both loads look up the same ones
+static const std::filesystem::path lookups_path{ bench_dir / "lookups.bin" };
+
+// Resident memory of this process in bytes, 0 where it can't be read
+static uint64_t resident_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.WorkingSetSize;
+#else
+	std::ifstream statm{ "/proc/self/statm" };
+	uint64_t total_pages{ 0 };
+	uint64_t resident_pages{ 0 };
+	if (!(statm >> total_pages >> resident_pages)) return 0;
+	return resident_pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif // _WIN32
+}
+
+static double mebibytes(const int64_t bytes) {
+	return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+static double milliseconds(const std::chrono::nanoseconds time) {
+	return std::chrono::duration<double, std::milli>(time).count();
+}
+
+// Writes both files and the IDs to look up
+static bool write_files(const std::size_t guild_count) {
+	std::mt19937_64 rng{ 1 };
+	std::vector<uint64_t> guild_ids(guild_count);
+	GuildSettingsMap settings{};
+	for (uint64_t& guild_id : guild_ids) {
+		guild_id = (rng() >> 4) | (uint64_t{ 1 } << 59);
+		GuildSettings& guild{ settings.get_or_insert(guild_id) };
+		for (std::size_t i{ 0 }; i < command_type_count; ++i) guild.log_channels[i] = guild_id + i + 1;
+	}
+
+	std::vector<uint64_t> lookup_ids(lookup_count);
+	for (uint64_t& guild_id : lookup_ids) guild_id = guild_ids[rng() % guild_ids.size()];
+
+	std::error_code ec{};
+	std::filesystem::create_directories(bench_dir, ec);
+	std::ofstream json_file{ json_path };
+	json_file << guild_settings_to_json(settings).dump(4);
+	json_file.close();
+	std::ofstream lookups_file{ lookups_path, std::ios::binary };
+	lookups_file.write(reinterpret_cast<const char*>(lookup_ids.data()), static_cast<std::streamsize>(lookup_ids.size() * sizeof(uint64_t)));
+	lookups_file.close();
+	return json_file && lookups_file && GuildSettingsSnapshot::write(snapshot_path, GuildSettingsSnapshot{}, settings);
+}
+
+// Loads one of the files the way the bot did or does, then looks guilds up in it. Returns the process' exit code
+static int run_load(const std::string_view format) {
+	std::vector<uint64_t> lookup_ids(lookup_count);
+	std::ifstream lookups_file{ lookups_path, std::ios::binary };
+	if (!lookups_file.read(reinterpret_cast<char*>(lookup_ids.data()), static_cast<std::streamsize>(lookup_ids.size() * sizeof(uint64_t)))) return 1;
+
+	GuildSettingsSnapshot snapshot{};
+	GuildSettingsMap settings{};
+	std::chrono::nanoseconds load_time{ 0 };
+	const uint64_t before{ resident_bytes() };
+	uint64_t loaded{ 0 };
+	const auto load_start{ std::chrono::steady_clock::now() };
+	if (format == "snapshot") {
+		// What `load_guild_settings()` does now: map the file and check its header
+		if (!snapshot.open(snapshot_path)) return 1;
+		load_time = std::chrono::steady_clock::now() - load_start;
+		loaded = resident_bytes();
+	}
+	else {
+		// What it did before: parse the whole file into a map. The document is only freed after the memory is read
+		std::ifstream file{ json_path };
+		json document{};
+		file >> document;
+		settings = guild_settings_from_json(document);
+		load_time = std::chrono::steady_clock::now() - load_start;
+		loaded = resident_bytes();
+	}
+	std::cout << std::format("{:<8} load {:>10.3f} ms, +{:>7.1f} MiB", format, milliseconds(load_time), mebibytes(static_cast<int64_t>(loaded) - static_cast<int64_t>(before)));
+
+	// A snapshot's pages are clean and the kernel can drop them again, unlike the parsed map
+	const uint64_t before_lookups{ resident_bytes() };
+	const auto lookup_start{ std::chrono::steady_clock::now() };
+	std::size_t found{ 0 };
+	for (const uint64_t guild_id : lookup_ids) {
+		if (format == "snapshot") {
+			const GuildSettingsRecord* record{ snapshot.find(guild_id) };
+			found += record && record->log_channels[0] == guild_id + 1 ? 1 : 0;
+		}
+		else {
+			const GuildSettings* guild{ settings.find(guild_id) };
+			found += guild && guild->log_channels[0] == guild_id + 1 ? 1 : 0;
+		}
+	}
+	const auto lookup_time{ std::chrono::steady_clock::now() - lookup_start };
+
+	std::cout << std::format(" | {} lookups {:>8.3f} ms, +{:>6.1f} MiB\n", lookup_count, milliseconds(lookup_time), mebibytes(static_cast<int64_t>(resident_bytes()) - static_cast<int64_t>(before_lookups)));
+	return found == lookup_count ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	if (argc > 2 && std::string_view{ argv[1] } == "--load") return run_load(argv[2]);
+
+	const std::size_t guild_count{ argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : default_guild_count };
+	if (!write_files(guild_count)) {
+		std::cerr << std::format("Couldn't write the settings files in {}\n", bench_dir.string());
+		return 1;
+	}
+
+	std::cout << std::format("{} guilds: snapshot {:.1f} MiB, JSON {:.1f} MiB\n", guild_count,
+		mebibytes(static_cast<int64_t>(std::filesystem::file_size(snapshot_path))), mebibytes(static_cast<int64_t>(std::filesystem::file_size(json_path))));
+	std::cout.flush();
+
+	int result{ 0 };
+	for (const std::string_view format : { "snapshot", "json" }) {
+		if (std::system(std::format("\"{}\" --load {}", argv[0], format).c_str()) != 0) result = 1;
+	}
+
+	std::error_code ec{};
+	std::filesystem::remove_all(bench_dir, ec);
+	return result;
+}
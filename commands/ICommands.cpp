@@ -23,15 +23,20 @@
 #include <pch.hpp>
 
 // This creates a central registry
-// Whenever a new command is created, its registration function is called here
+// Whenever a new command is created, its name is added to `command_table::names`
+// and its registration function is called here
 void register_all_commands() {
 
 	// From `/utility/`
 	register_ping_command();
 	register_stats_command();
+	register_perm_audit_command();
 
 	// From `/moderation/`
 	register_role_add_command();
+	register_role_add_bulk_command();
+	register_mass_ban_command();
+	register_modlog_command();
 	// TODO: Add other command registration calls here
 }
 
@@ -40,6 +45,6 @@ void register_all_commands() {
 void register_all_select_handlers() {
 
 	// From `/moderation/`
-	register_role_add_command(); // This function now *also* registers its select handler
+	register_role_add_select_handlers();
 	// TODO: Add other select handler registration calls here
 }
@@ -27,6 +27,13 @@ void register_all_select_handlers();
 // Command specific registration functions
 void register_ping_command();
 void register_stats_command();
+void register_perm_audit_command();
 void register_role_add_command();
+void register_role_add_bulk_command();
+void register_mass_ban_command();
+void register_modlog_command();
+
+// Select handler specific registration functions
+void register_role_add_select_handlers();
 
 #endif // ICOMMANDS_HPP
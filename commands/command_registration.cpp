@@ -0,0 +1,203 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <fstream>
+ * #include <string>
+ * #include <vector>
+ * #include <algorithm>
+ * #include <filesystem>
+ * #include <format>
+ * #include <mutex>
+ * #include <cstdint>
+ * #include <dpp/appcommand.h>
+ * #include <dpp/cluster.h>
+ * #include <dpp/nlohmann/json.hpp>
+ * #include <Ishmael.hpp>
+ * #include <command_table.hpp>
+ * #include <command_registration.hpp>
+ * #include <rest_scheduler/rest_scheduler.hpp>
+ * #include <secrets/secrets.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+using json = nlohmann::json;
+
+static const std::string registration_state_file_path{ "data/command_registration.json" };
+static std::mutex registration_state_mutex;
+
+enum class CommandScope {
+	Global,
+	DevGuild
+};
+
+static std::string scope_key(const CommandScope scope) {
+	return scope == CommandScope::Global ? "global" : "dev_guild";
+}
+
+// FNV-1a (64-bit), stable across runs and platforms unlike std::hash
+static uint64_t hash_command_set(const std::vector<dpp::slashcommand>& command_set) {
+	uint64_t h{ 14695981039346656037ull };
+	for (const dpp::slashcommand& cmd : command_set) {
+		// The JSON without the ID holds the name, description, permissions and options
+		for (const char c : cmd.build_json(false)) {
+			h ^= static_cast<uint8_t>(c);
+			h *= 1099511628211ull;
+		}
+		h ^= 0xFF; // Separator, so two commands can't hash like one
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+static json read_registration_state() {
+	std::ifstream file{ registration_state_file_path };
+	if (!file.is_open()) return json::object();
+
+	try {
+		json state{};
+		file >> state;
+		return state.is_object() ? state : json::object();
+	}
+	catch (const json::parse_error& e) {
+		Logger::error(true, "Couldn't parse {}, all commands will be overwritten: {}", registration_state_file_path, e.what());
+		return json::object();
+	}
+}
+
+static void save_registration_hash(const CommandScope scope, const uint64_t hash) {
+	std::scoped_lock lock{ registration_state_mutex };
+
+	json state(read_registration_state());
+	state[scope_key(scope)] = std::format("{:016x}", hash);
+	if (scope == CommandScope::DevGuild) state["dev_guild_id"] = secrets.at("DEV_GUILD_ID");
+
+	try {
+		std::filesystem::create_directories(std::filesystem::path{ registration_state_file_path }.parent_path());
+
+		// Write to a temporary file first, a crash mid-write then can't leave a truncated state behind
+		const std::string temp_path{ registration_state_file_path + ".tmp" };
+		{
+			std::ofstream file{ temp_path, std::ios::trunc };
+			if (!file.is_open()) {
+				Logger::error(true, "Couldn't open {} for writing", temp_path);
+				return;
+			}
+			file << state.dump(4);
+		}
+		std::filesystem::rename(temp_path, registration_state_file_path);
+	}
+	catch (const std::exception& e) {
+		Logger::exception(true, "Failed to save {}: {}", registration_state_file_path, e.what());
+	}
+}
+
+static void record_command_ids(const dpp::slashcommand_map& registered, const CommandScope scope) {
+	for (const auto& [id, cmd] : registered) {
+		const auto index{ command_table::find(cmd.name) };
+		if (!index.has_value()) continue;
+
+		// Only keep the IDs of the scope a command is declared in, a stale copy in the other scope is ignored
+		const bool is_dev_guild_command{ commands[index.value()].is_restricted_to_owners };
+		if (is_dev_guild_command == (scope == CommandScope::DevGuild)) command_table::record_id(index.value(), id);
+	}
+}
+
+static bool has_same_names(const dpp::slashcommand_map& registered, const std::vector<dpp::slashcommand>& declared) {
+	if (registered.size() != declared.size()) return false;
+	return std::all_of(declared.begin(), declared.end(), [&registered](const dpp::slashcommand& cmd) {
+		return std::any_of(registered.begin(), registered.end(), [&cmd](const auto& pair) { return pair.second.name == cmd.name; });
+	});
+}
+
+static void sync_scope(dpp::cluster& bot, const CommandScope scope, std::vector<dpp::slashcommand> declared, const std::string& saved_hash) {
+	const uint64_t declared_hash{ hash_command_set(declared) };
+	const bool hash_matches{ saved_hash == std::format("{:016x}", declared_hash) };
+	const dpp::snowflake dev_guild_id{ secrets.at("DEV_GUILD_ID") };
+	// Global commands are limited per application, guild commands per guild
+	const uint64_t major_parameter{ scope == CommandScope::Global ? static_cast<uint64_t>(bot.me.id) : static_cast<uint64_t>(dev_guild_id) };
+	const std::string route{ rest_route(scope == CommandScope::Global ? "global_commands_get" : "guild_commands_get", major_parameter) };
+	const std::string overwrite_route{ rest_route(scope == CommandScope::Global ? "global_bulk_command_create" : "guild_bulk_command_create", major_parameter) };
+
+	// One fetch per scope, to pick up the IDs and to notice commands changed from outside the bot
+	rest_scheduler.submit(RestLane::Background, route, [&bot, scope, dev_guild_id](dpp::command_completion_event_t callback) {
+		if (scope == CommandScope::Global) bot.global_commands_get(std::move(callback));
+		else bot.guild_commands_get(dev_guild_id, std::move(callback));
+	}, [&bot, scope, declared = std::move(declared), declared_hash, hash_matches, overwrite_route, dev_guild_id](const dpp::confirmation_callback_t& fetched) {
+		if (!fetched.is_error()) {
+			const dpp::slashcommand_map registered{ fetched.get<dpp::slashcommand_map>() };
+			if (hash_matches && has_same_names(registered, declared)) {
+				record_command_ids(registered, scope);
+				Logger::info(true, "{} commands are up to date, skipped registration", scope_key(scope));
+				return;
+			}
+		}
+		else Logger::warn(true, "Failed to fetch the registered {} commands, overwriting them: {}", scope_key(scope), fetched.get_error().message);
+
+		Logger::info(true, "{} commands changed, sending a bulk overwrite of {} commands", scope_key(scope), declared.size());
+
+		rest_scheduler.submit(RestLane::Background, overwrite_route, [&bot, scope, declared, dev_guild_id](dpp::command_completion_event_t callback) {
+			if (scope == CommandScope::Global) bot.global_bulk_command_create(declared, std::move(callback));
+			else bot.guild_bulk_command_create(declared, dev_guild_id, std::move(callback));
+		}, [scope, declared_hash](const dpp::confirmation_callback_t& overwritten) {
+			if (overwritten.is_error()) {
+				Logger::error(true, "Failed to overwrite the {} commands: {}", scope_key(scope), overwritten.get_error().message);
+				return;
+			}
+			record_command_ids(overwritten.get<dpp::slashcommand_map>(), scope);
+			save_registration_hash(scope, declared_hash);
+		});
+	});
+}
+
+void sync_commands(dpp::cluster& bot) {
+	std::vector<dpp::slashcommand> global_commands{}, guild_commands{};
+
+	for (std::size_t i{ 0 }; i < command_table::size; ++i) {
+		const command_t& command{ commands[i] };
+		if (!command.function && !command.coroutine) {
+			Logger::warn(true, "Command `{}` is in the command table but was never registered", command_table::names[i]);
+			continue;
+		}
+
+		dpp::slashcommand cmd{ std::string{ command_table::names[i] }, command.description, bot.me.id };
+
+		for (const auto& opt : command.options) cmd.add_option(opt);
+
+		cmd.set_default_permissions(command.permissions);
+		cmd.set_dm_permission(false);
+
+		// If a command is restricted to only owners, it lives in their server, else it is a global command
+		if (command.is_restricted_to_owners) guild_commands.push_back(std::move(cmd));
+		else global_commands.push_back(std::move(cmd));
+	}
+
+	json state{};
+	{
+		std::scoped_lock lock{ registration_state_mutex };
+		state = read_registration_state();
+	}
+
+	// A hash saved for another dev guild says nothing about this one
+	const bool same_dev_guild{ state.value("dev_guild_id", std::string{}) == secrets.at("DEV_GUILD_ID") };
+
+	sync_scope(bot, CommandScope::Global, std::move(global_commands), state.value(scope_key(CommandScope::Global), std::string{}));
+	sync_scope(bot, CommandScope::DevGuild, std::move(guild_commands), same_dev_guild ? state.value(scope_key(CommandScope::DevGuild), std::string{}) : std::string{});
+}
@@ -0,0 +1,40 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMMAND_REGISTRATION_HPP
+#define COMMAND_REGISTRATION_HPP
+
+#pragma once
+
+/*
+ * The following include is performed:
+ * #include <dpp/cluster.h>
+ */
+
+#include <pch.hpp>
+
+/*
+ * @brief Brings the commands registered on Discord in line with `commands`
+ *
+ * The declared command set of each scope (global and the dev guild) is hashed and
+ * compared with the hash saved by the last successful sync. The existing commands are
+ * fetched once per scope, and a single bulk overwrite is only sent when the set changed
+ * Either way, the command IDs are recorded for `command_table::find_by_id`
+ */
+void sync_commands(dpp::cluster& bot);
+
+#endif // COMMAND_REGISTRATION_HPP
@@ -0,0 +1,52 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <array>
+ * #include <atomic>
+ * #include <optional>
+ * #include <cstddef>
+ * #include <cstdint>
+ * #include <dpp/snowflake.h>
+ * #include <command_table.hpp>
+ */
+
+#include <pch.hpp>
+
+// The Discord ID of each command, at the same index as `commands`
+// The IDs are written from REST threads and read from the gateway threads, hence the atomics
+// 0 means the command hasn't been registered (yet) in this session
+static std::array<std::atomic<uint64_t>, command_table::size> command_ids{};
+
+void command_table::record_id(const std::size_t index, const dpp::snowflake command_id) noexcept {
+	if (index < command_ids.size()) command_ids[index].store(command_id, std::memory_order_release);
+}
+
+std::optional<std::size_t> command_table::find_by_id(const dpp::snowflake command_id) noexcept {
+	if (command_id == 0) return std::nullopt;
+
+	// The table holds a handful of IDs in one contiguous array, a linear scan beats hashing here
+	for (std::size_t i{ 0 }; i < command_ids.size(); ++i)
+		if (command_ids[i].load(std::memory_order_acquire) == command_id) return i;
+
+	return std::nullopt;
+}
+
+dpp::snowflake command_table::recorded_id(const std::size_t index) noexcept {
+	return index < command_ids.size() ? command_ids[index].load(std::memory_order_acquire) : 0;
+}
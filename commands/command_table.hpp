@@ -0,0 +1,150 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMMAND_TABLE_HPP
+#define COMMAND_TABLE_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <array>
+ * #include <bit>
+ * #include <optional>
+ * #include <string_view>
+ * #include <stdexcept>
+ * #include <cstddef>
+ * #include <cstdint>
+ * #include <dpp/snowflake.h>
+ */
+
+#include <pch.hpp>
+
+namespace command_table {
+	// Every slash command the bot knows about, in registration order
+	// The index of a name in this array is the index of its `command_t` in `commands`
+	// Whenever a new command is created, its name has to be added here
+	inline constexpr std::array<std::string_view, 7> names{
+		// From `/utility/`
+		"ping",
+		"stats",
+		"perm_audit",
+
+		// From `/moderation/`
+		"role_add",
+		"role_add_bulk",
+		"mass_ban",
+		"modlog"
+	};
+
+	inline constexpr std::size_t size{ names.size() };
+
+	static_assert(size < UINT8_MAX, "The command table stores indices as uint8_t");
+
+	consteval bool has_unique_names() {
+		for (std::size_t i{ 0 }; i < size; ++i)
+			for (std::size_t j{ i + 1 }; j < size; ++j)
+				if (names[i] == names[j]) return false;
+		return true;
+	}
+
+	static_assert(has_unique_names(), "A command name is registered more than once in command_table::names");
+
+	// FNV-1a, with the seed folded into the offset basis
+	constexpr uint32_t hash(const std::string_view name, const uint32_t seed) noexcept {
+		uint32_t h{ 2166136261u ^ seed };
+		for (const char c : name) {
+			h ^= static_cast<uint8_t>(c);
+			h *= 16777619u;
+		}
+		return h;
+	}
+
+	// Twice the number of commands, rounded up to a power of two, so a seed is found quickly
+	inline constexpr std::size_t slot_count{ std::bit_ceil(size * 2 < 4 ? std::size_t{ 4 } : size * 2) };
+
+	consteval uint32_t find_seed() {
+		for (uint32_t seed{ 0 }; seed < (1u << 20); ++seed) {
+			std::array<bool, slot_count> taken{};
+			bool collided{ false };
+
+			for (const std::string_view name : names) {
+				const std::size_t slot{ hash(name, seed) & (slot_count - 1) };
+				if (taken[slot]) {
+					collided = true;
+					break;
+				}
+				taken[slot] = true;
+			}
+
+			if (!collided) return seed;
+		}
+		throw std::logic_error("No perfect hash seed found for command_table::names");
+	}
+
+	inline constexpr uint32_t seed{ find_seed() };
+
+	// Maps a hash slot to `index + 1`, 0 meaning the slot is empty
+	inline constexpr std::array<uint8_t, slot_count> slots{ [] {
+		std::array<uint8_t, slot_count> s{};
+		for (std::size_t i{ 0 }; i < size; ++i) s[hash(names[i], seed) & (slot_count - 1)] = static_cast<uint8_t>(i + 1);
+		return s;
+	}() };
+
+	/*
+	 * @brief Finds the index of a command without allocating
+	 * @param name The command name, as sent by Discord
+	 * @return The index into `commands`, or std::nullopt if the name is unknown
+	 */
+	constexpr std::optional<std::size_t> find(const std::string_view name) noexcept {
+		const uint8_t slot{ slots[hash(name, seed) & (slot_count - 1)] };
+		if (slot == 0 || names[slot - 1] != name) return std::nullopt;
+		return static_cast<std::size_t>(slot - 1);
+	}
+
+	/*
+	 * @brief Compile-time lookup used by the registration functions
+	 * Naming a command that is not in `names` is a compile error
+	 */
+	consteval std::size_t index_of(const std::string_view name) {
+		const auto index{ find(name) };
+		if (!index.has_value()) throw std::logic_error("Command is missing from command_table::names");
+		return index.value();
+	}
+
+	/*
+	 * @brief Stores the snowflake Discord assigned to a command when it was registered
+	 * @param index The command's index, as returned by `find` or `index_of`
+	 * @param command_id The ID returned by `global_command_create`/`guild_command_create`
+	 */
+	void record_id(const std::size_t index, const dpp::snowflake command_id) noexcept;
+
+	/*
+	 * @brief Finds a command by the ID Discord sends with each interaction
+	 * Global and guild commands get different IDs, even if they share a name
+	 * @return The index into `commands`, or std::nullopt if the ID was never recorded
+	 */
+	std::optional<std::size_t> find_by_id(const dpp::snowflake command_id) noexcept;
+
+	/*
+	 * @brief The snowflake recorded for a command
+	 * @return 0 if the command has no ID recorded in this session
+	 */
+	dpp::snowflake recorded_id(const std::size_t index) noexcept;
+}
+
+#endif // COMMAND_TABLE_HPP
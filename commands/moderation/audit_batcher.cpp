@@ -0,0 +1,261 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <deque>
+ * #include <vector>
+ * #include <tuple>
+ * #include <unordered_map>
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <thread>
+ * #include <chrono>
+ * #include <format>
+ * #include <algorithm>
+ * #include <cstdint>
+ * #include <dpp/cluster.h>
+ * #include <dpp/message.h>
+ * #include <dpp/restresults.h>
+ * #include <moderation/audit_batcher.hpp>
+ * #include <config/config.hpp>
+ * #include <rest_scheduler/rest_scheduler.hpp>
+ * #include <other_utils/other_utils.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+AuditLogBatcher audit_batcher;
+
+// Discord's limits for a single message
+static constexpr std::size_t max_embeds_per_message{ 10 };
+static constexpr std::size_t max_embed_characters{ 6000 };
+
+// Server errors are retried this many times, rate limits as often as it takes
+static constexpr uint8_t max_delivery_attempts{ 3 };
+
+// Answers a send that came up before any cluster was bound, it's retried like a server error
+static dpp::confirmation_callback_t make_unbound_result() {
+	dpp::confirmation_callback_t result{};
+	result.http_info.status = 503;
+	result.http_info.body = R"({"message":"No cluster to send audit logs on","code":0})";
+	return result;
+}
+
+std::chrono::milliseconds audit_batch_window() {
+	return config_milliseconds("AUDIT_BATCH_WINDOW_MS", default_audit_batch_window);
+}
+
+// Roughly what an embed counts against `max_embed_characters`, the footer and field names are covered by the margin
+static std::size_t embed_length(const dpp::embed& log_embed) {
+	std::size_t length{ log_embed.title.size() + log_embed.description.size() + 100 };
+	for (const dpp::embed_field& field : log_embed.fields) length += field.name.size() + field.value.size();
+	return length;
+}
+
+AuditLogBatcher::~AuditLogBatcher() {
+	stop();
+}
+
+void AuditLogBatcher::start(dpp::cluster& cluster, const std::chrono::milliseconds batch_window) {
+	{
+		std::scoped_lock lock{ mtx };
+		bot = &cluster;
+		window = batch_window;
+	}
+
+	if (running.exchange(true)) return;
+	flusher = std::thread{ [this] { flush_loop(); } };
+}
+
+void AuditLogBatcher::stop() {
+	if (!running.exchange(false)) return;
+
+	{
+		std::scoped_lock lock{ mtx };
+	}
+	cv.notify_all();
+	if (flusher.joinable()) flusher.join();
+
+	// No window from here on, whatever is buffered goes out now. Channels with a message in flight follow up from `on_sent`
+	std::vector<std::tuple<uint64_t, uint64_t, std::vector<Pending>>> batches{};
+	{
+		std::scoped_lock lock{ mtx };
+		const clock::time_point now{ clock::now() };
+		for (auto& [channel_id, channel] : channels) {
+			std::vector<Pending> batch{ take_batch(channel, now, true) };
+			if (!batch.empty()) batches.emplace_back(channel.guild_id, channel_id, std::move(batch));
+		}
+	}
+	for (auto& [guild_id, channel_id, batch] : batches) send(guild_id, channel_id, std::move(batch));
+}
+
+void AuditLogBatcher::enqueue(const uint64_t guild_id, const uint64_t channel_id, const dpp::embed& log_embed) {
+	std::vector<Pending> batch{};
+	{
+		std::scoped_lock lock{ mtx };
+		const clock::time_point now{ clock::now() };
+		Channel& channel{ channels[channel_id] };
+		channel.guild_id = guild_id;
+		channel.buffer.push_back(Pending{ .embed = log_embed, .enqueued = now });
+
+		// An idle channel sends right away, a busy one is picked up by `on_sent` or the flush thread
+		batch = take_batch(channel, now, false);
+	}
+
+	if (!batch.empty()) send(guild_id, channel_id, std::move(batch));
+	else cv.notify_one();
+}
+
+AuditBatcherStats AuditLogBatcher::get_stats() const {
+	std::scoped_lock lock{ mtx };
+	return stats;
+}
+
+std::vector<AuditLogBatcher::Pending> AuditLogBatcher::take_batch(Channel& channel, const clock::time_point now, const bool force) {
+	if (channel.buffer.empty() || channel.in_flight || !bot) return {};
+
+	const bool window_passed{ now - channel.last_sent >= window };
+	if (!force && running.load() && !window_passed && channel.buffer.size() < max_embeds_per_message) return {};
+
+	std::vector<Pending> batch{};
+	std::size_t characters{ 0 };
+	while (!channel.buffer.empty() && batch.size() < max_embeds_per_message) {
+		const std::size_t length{ embed_length(channel.buffer.front().embed) };
+		if (!batch.empty() && characters + length > max_embed_characters) break;
+		characters += length;
+		batch.push_back(std::move(channel.buffer.front()));
+		channel.buffer.pop_front();
+	}
+
+	channel.in_flight = true;
+	channel.last_sent = now;
+	return batch;
+}
+
+dpp::cluster* AuditLogBatcher::current_cluster() const {
+	std::scoped_lock lock{ mtx };
+	return bot;
+}
+
+void AuditLogBatcher::send(const uint64_t guild_id, const uint64_t channel_id, std::vector<Pending> batch) {
+	dpp::message message{};
+	message.channel_id = channel_id;
+	for (const Pending& pending : batch) message.add_embed(pending.embed);
+
+	// A webhook has its own rate limit, and its calls queue apart from the bot's
+	if (const auto log_webhook{ get_log_webhook(guild_id, channel_id) }) {
+		dpp::webhook webhook{};
+		webhook.id = log_webhook->id;
+		webhook.token = log_webhook->token;
+
+		webhook_scheduler.submit(RestLane::AuditLog, rest_route("webhook", log_webhook->id),
+			[this, webhook = std::move(webhook), message = std::move(message)](dpp::command_completion_event_t callback) {
+				if (dpp::cluster* cluster{ current_cluster() }) cluster->execute_webhook(webhook, message, false, 0, "", std::move(callback));
+				else callback(make_unbound_result());
+			},
+			[this, channel_id, batch = std::move(batch)](const dpp::confirmation_callback_t& result) { on_sent(channel_id, batch, true, result); });
+		return;
+	}
+
+	// Audit logs yield to interaction traffic
+	rest_scheduler.submit(RestLane::AuditLog, rest_route("message_create", channel_id),
+		[this, message = std::move(message)](dpp::command_completion_event_t callback) {
+			if (dpp::cluster* cluster{ current_cluster() }) cluster->message_create(message, std::move(callback));
+			else callback(make_unbound_result());
+		},
+		[this, channel_id, batch = std::move(batch)](const dpp::confirmation_callback_t& result) { on_sent(channel_id, batch, false, result); });
+}
+
+void AuditLogBatcher::on_sent(const uint64_t channel_id, std::vector<Pending> batch, const bool via_webhook, const dpp::confirmation_callback_t& result) {
+	std::vector<Pending> next{};
+	uint64_t guild_id{ 0 };
+	bool webhook_gone{ false };
+	{
+		std::scoped_lock lock{ mtx };
+		const clock::time_point now{ clock::now() };
+		Channel& channel{ channels[channel_id] };
+		channel.in_flight = false;
+
+		if (!result.is_error()) {
+			stats.embeds_sent += batch.size();
+			++stats.messages_sent;
+			const auto delay{ std::chrono::duration_cast<std::chrono::milliseconds>(now - batch.front().enqueued) };
+			if (delay > stats.max_delay) stats.max_delay = delay;
+		}
+		else {
+			const uint16_t status{ static_cast<uint16_t>(result.http_info.status) };
+			// A deleted webhook answers 401 or 404, the batch is resent as a bot message
+			webhook_gone = via_webhook && (status == 401 || status == 404);
+
+			bool retry{ false };
+			if (webhook_gone) retry = true;
+			// Rate limited or shed. Once stopped, they'd only be shed again
+			else if (status == 429) retry = running.load();
+			else if (status == 0 || status >= 500) retry = std::all_of(batch.begin(), batch.end(), [](const Pending& pending) { return pending.attempts + 1 < max_delivery_attempts; });
+
+			if (retry) {
+				// Back to the front, to keep their order
+				for (auto it{ batch.rbegin() }; it != batch.rend(); ++it) {
+					if (status != 429 && !webhook_gone) ++it->attempts;
+					channel.buffer.push_front(std::move(*it));
+				}
+			}
+			else Logger::error(false, "Failed to send {} audit log embeds to channel {}: {}", batch.size(), channel_id, result.get_error().message);
+		}
+
+		// The fallback doesn't wait for the window
+		next = take_batch(channel, now, webhook_gone);
+		guild_id = channel.guild_id;
+	}
+
+	if (webhook_gone) {
+		Logger::warn(false, "The audit log webhook of channel {} is gone, falling back to bot messages", channel_id);
+		forget_log_webhook(guild_id, channel_id);
+	}
+
+	if (!next.empty()) send(guild_id, channel_id, std::move(next));
+	else cv.notify_one();
+}
+
+void AuditLogBatcher::flush_loop() {
+	while (running.load()) {
+		std::vector<std::tuple<uint64_t, uint64_t, std::vector<Pending>>> batches{};
+		{
+			std::unique_lock lock{ mtx };
+			const clock::time_point now{ clock::now() };
+			clock::time_point next_due{ now + std::chrono::seconds{ 5 } };
+
+			for (auto& [channel_id, channel] : channels) {
+				std::vector<Pending> batch{ take_batch(channel, now, false) };
+				if (!batch.empty()) batches.emplace_back(channel.guild_id, channel_id, std::move(batch));
+				else if (!channel.buffer.empty() && !channel.in_flight) next_due = std::min(next_due, channel.last_sent + window);
+			}
+
+			// Forget quiet channels once there are many of them
+			if (channels.size() > 1024) std::erase_if(channels, [](const auto& pair) { return pair.second.buffer.empty() && !pair.second.in_flight; });
+
+			if (batches.empty()) {
+				cv.wait_until(lock, next_due);
+				continue;
+			}
+		}
+
+		for (auto& [guild_id, channel_id, batch] : batches) send(guild_id, channel_id, std::move(batch));
+	}
+}
@@ -0,0 +1,120 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef AUDIT_BATCHER_HPP
+#define AUDIT_BATCHER_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <deque>
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <thread>
+ * #include <atomic>
+ * #include <chrono>
+ * #include <cstdint>
+ * #include <dpp/cluster.h>
+ * #include <dpp/message.h>
+ */
+
+#include <pch.hpp>
+
+// How long a busy log channel buffers embeds before sending them together, unless `AUDIT_BATCH_WINDOW_MS` is set in the config
+constexpr std::chrono::milliseconds default_audit_batch_window{ 750 };
+
+std::chrono::milliseconds audit_batch_window();
+
+struct AuditBatcherStats {
+	uint64_t embeds_sent{ 0 };
+	uint64_t messages_sent{ 0 };
+	std::chrono::milliseconds max_delay{ 0 }; // From an embed being queued to its message being accepted
+};
+
+/*
+ * @brief Packs the audit log embeds of a channel into as few messages as possible
+ *
+ * A channel that's idle gets its embed sent right away. While a message is in flight, or within `window`
+ * of the last one, embeds are buffered and go out together, up to 10 per message
+ * Ten buffered embeds are sent without waiting for the window
+ *
+ * Channels with a log webhook are delivered through `webhook_scheduler`, off the bot's own REST budget
+ * Failed deliveries are put back in the buffer and retried
+ *
+ * Sends go out on the cluster given to `start`, looked up when the scheduler issues them rather than when they're queued,
+ * so a send queued before a rebuild goes out on whichever cluster is current by then
+ */
+class AuditLogBatcher {
+public:
+	using clock = std::chrono::steady_clock;
+
+	AuditLogBatcher() = default;
+	AuditLogBatcher(const AuditLogBatcher&) = delete;
+	AuditLogBatcher& operator=(const AuditLogBatcher&) = delete;
+	AuditLogBatcher(AuditLogBatcher&&) = delete;
+	AuditLogBatcher& operator=(AuditLogBatcher&&) = delete;
+	~AuditLogBatcher();
+
+	// Sends on `bot` from here on. Embeds buffered while stopped go out with the next flush
+	void start(dpp::cluster& bot, const std::chrono::milliseconds batch_window);
+	// Sends whatever is buffered, then stops the flush thread. The cluster stays bound until the next `start`, for the sends still queued
+	void stop();
+
+	void enqueue(const uint64_t guild_id, const uint64_t channel_id, const dpp::embed& log_embed);
+
+	AuditBatcherStats get_stats() const;
+
+private:
+	struct Pending {
+		dpp::embed embed;
+		clock::time_point enqueued;
+		uint8_t attempts{ 0 };
+	};
+
+	struct Channel {
+		uint64_t guild_id{ 0 };
+		std::deque<Pending> buffer{};
+		bool in_flight{ false };
+		clock::time_point last_sent{};
+	};
+
+	mutable std::mutex mtx;
+	std::condition_variable cv;
+	std::thread flusher;
+	std::atomic_bool running{ false };
+	std::chrono::milliseconds window{ default_audit_batch_window };
+	dpp::cluster* bot{ nullptr }; // Set by `start`, guarded by `mtx`
+
+	std::unordered_map<uint64_t, Channel> channels;
+	AuditBatcherStats stats{};
+
+	// Takes the next batch of a channel if it may be sent now. Must be called with `mtx` held
+	std::vector<Pending> take_batch(Channel& channel, const clock::time_point now, const bool force);
+	// The cluster to issue a send on, or nothing if none was ever bound
+	dpp::cluster* current_cluster() const;
+	// Must be called without `mtx` held
+	void send(const uint64_t guild_id, const uint64_t channel_id, std::vector<Pending> batch);
+	void on_sent(const uint64_t channel_id, std::vector<Pending> batch, const bool via_webhook, const dpp::confirmation_callback_t& result);
+	void flush_loop();
+};
+
+extern AuditLogBatcher audit_batcher;
+
+#endif // AUDIT_BATCHER_HPP
@@ -0,0 +1,353 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <string>
+ * #include <memory_resource>
+ * #include <span>
+ * #include <chrono>
+ * #include <format>
+ * #include <algorithm>
+ * #include <exception>
+ * #include <variant>
+ * #include <cstdint>
+ * #include <dpp/appcommand.h>
+ * #include <dpp/cache.h>
+ * #include <dpp/cluster.h>
+ * #include <dpp/message.h>
+ * #include <dpp/dispatcher.h>
+ * #include <dpp/permissions.h>
+ * #include <dpp/exception.h>
+ * #include <dpp/guild.h>
+ * #include <dpp/restresults.h>
+ * #include <dpp/snowflake.h>
+ * #include <dpp/coro.h>
+ * #include <commands/command_table.hpp>
+ * #include <commands/moderation/mod_utils.hpp>
+ * #include <commands/moderation/permission_cache.hpp>
+ * #include <commands/moderation/member_resolver.hpp>
+ * #include <commands/ICommands.hpp>
+ * #include <utilities/rest_scheduler/rest_scheduler.hpp>
+ * #include <utilities/render/render.hpp>
+ * #include <utilities/logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+// Discord's bulk ban endpoint takes at most 200 users per call
+static constexpr std::size_t bulk_ban_chunk_size{ 200 };
+static constexpr std::size_t max_mass_ban_targets{ 1000 };
+
+// `guild_get_members` returns at most 1000 members per call, a filter lists at most `max_scanned_pages` of them
+static constexpr uint16_t members_page_size{ 1000 };
+static constexpr std::size_t max_scanned_pages{ 50 };
+
+// Discord's epoch, in milliseconds since the Unix epoch
+static constexpr uint64_t discord_epoch_ms{ 1420070400000 };
+
+struct MemberScan {
+	std::vector<dpp::guild_member> matches;
+	std::size_t scanned{ 0 };
+	bool truncated{ false }; // The listing stopped at `max_scanned_pages`, the newest accounts weren't listed
+	bool failed{ false }; // A listing call failed, the members after it weren't listed
+};
+
+/*
+ * The bot doesn't request the members intent, so D++'s cache only holds the members it happened to see
+ * The filters list the guild's members over REST instead. The listing is by ascending user ID, which grows with the
+ * account's creation time, so the account age filter starts it at its cutoff rather than at the oldest account
+ */
+static dpp::task<MemberScan> co_scan_members(dpp::cluster& bot, const uint64_t guild_id, const int64_t joined_within_minutes, const int64_t account_younger_than_hours) {
+	const int64_t now{ std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count() };
+	const int64_t joined_after{ now - joined_within_minutes * 60 };
+	const int64_t created_after{ now - account_younger_than_hours * 3600 };
+
+	MemberScan scan{};
+	uint64_t after{ 0 };
+	if (account_younger_than_hours > 0 && static_cast<uint64_t>(created_after) * 1000 > discord_epoch_ms)
+		after = (static_cast<uint64_t>(created_after) * 1000 - discord_epoch_ms) << 22;
+
+	for (std::size_t page{ 0 }; ; ++page) {
+		if (page == max_scanned_pages) {
+			scan.truncated = true;
+			break;
+		}
+
+		const dpp::confirmation_callback_t result{ co_await rest_scheduler.co_submit(RestLane::Interaction, rest_route("guild_members", guild_id),
+			[&bot, guild_id, after](dpp::command_completion_event_t callback) { bot.guild_get_members(guild_id, members_page_size, after, std::move(callback)); }) };
+		if (result.is_error()) {
+			Logger::error(false, "`/mass_ban` couldn't list the members of guild {}: {}", guild_id, result.get_error().message);
+			scan.failed = true;
+			break;
+		}
+
+		const dpp::guild_member_map members{ result.get<dpp::guild_member_map>() };
+		scan.scanned += members.size();
+		for (const auto& [user_id, member] : members) {
+			after = std::max<uint64_t>(after, user_id);
+			if (joined_within_minutes > 0 && static_cast<int64_t>(member.joined_at) < joined_after) continue;
+			if (account_younger_than_hours > 0 && user_id.get_creation_time() < static_cast<double>(created_after)) continue;
+
+			dpp::guild_member match{ member };
+			match.guild_id = guild_id;
+			scan.matches.push_back(std::move(match));
+		}
+
+		// A short page is the last one
+		if (members.size() < members_page_size) break;
+	}
+
+	co_return scan;
+}
+
+static dpp::task<void> handle_mass_ban(dpp::cluster& bot, const dpp::slashcommand_t& event) {
+	try {
+		co_await event.co_thinking(true);
+		release_command_strand(event);
+
+		const dpp::guild* g{ dpp::find_guild(event.command.get_guild().id) };
+		if (!g) {
+			event.co_edit_original_response(dpp::message{ "Error: Couldn't retrieve the server information." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		const dpp::guild_member& issuer_member{ event.command.member };
+		if (issuer_member.user_id == 0) {
+			event.co_edit_original_response(dpp::message{ "Error: Could not retrieve your member information." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		const dpp::permission issuer_perms{ calculate_permissions(issuer_member) };
+		if (!(issuer_member.is_guild_owner() || issuer_perms & dpp::p_administrator || issuer_perms & dpp::p_ban_members)) {
+			event.co_edit_original_response(dpp::message{ "You don't have permission to use this command." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		// The bulk ban endpoint needs both
+		const uint64_t bulk_ban_permissions{ dpp::p_ban_members | dpp::p_manage_guild };
+		const dpp::guild_member bot_member{ dpp::find_guild_member(g->id, bot.me.id) };
+		const uint64_t bot_perms{ calculate_permissions(bot_member) };
+		if (!(bot_perms & dpp::p_administrator) && (bot_perms & bulk_ban_permissions) != bulk_ban_permissions) {
+			event.co_edit_original_response(dpp::message{ "I can't ban members in bulk as I lack the `Ban Members` or the `Manage Server` permission." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		// `g` may be gone after the first `co_await`
+		const uint64_t guild_id{ g->id };
+		const uint64_t owner_id{ g->owner_id };
+		const uint64_t member_count{ g->member_count };
+
+		const auto users_param{ event.get_parameter("users") };
+		const auto joined_param{ event.get_parameter("joined_within_minutes") };
+		const auto age_param{ event.get_parameter("account_younger_than_hours") };
+		const auto delete_param{ event.get_parameter("delete_message_hours") };
+		const auto dry_run_param{ event.get_parameter("dry_run") };
+
+		const int64_t joined_within{ std::holds_alternative<int64_t>(joined_param) ? std::get<int64_t>(joined_param) : 0 };
+		const int64_t younger_than{ std::holds_alternative<int64_t>(age_param) ? std::get<int64_t>(age_param) : 0 };
+		const int64_t delete_hours{ std::holds_alternative<int64_t>(delete_param) ? std::get<int64_t>(delete_param) : 0 };
+		const bool dry_run{ std::holds_alternative<bool>(dry_run_param) && std::get<bool>(dry_run_param) };
+		const bool has_filters{ joined_within > 0 || younger_than > 0 };
+
+		if (std::holds_alternative<std::string>(users_param) == has_filters) {
+			event.co_edit_original_response(dpp::message{ "Error: Give either `users`, or the `joined_within_minutes`/`account_younger_than_hours` filters, but not both." }
+				.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		// The join filter alone lists from the oldest account on, and the recent joiners are mostly the newest accounts
+		// On a server larger than one listing, it would stop before reaching them
+		if (joined_within > 0 && younger_than == 0 && member_count > max_scanned_pages * members_page_size) {
+			event.co_edit_original_response(dpp::message{ std::format("Error: This server has more than {} members, too many to list for `joined_within_minutes` alone. "
+				"Add `account_younger_than_hours`, which starts the listing at its cutoff.", max_scanned_pages * members_page_size) }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		std::vector<dpp::snowflake> candidates{};
+		// Members the filters listed, so their hierarchy can be checked without looking them up again
+		std::unordered_map<uint64_t, dpp::guild_member> listed{};
+		bool scan_truncated{ false }, scan_failed{ false };
+		if (has_filters) {
+			MemberScan scan{ co_await co_scan_members(bot, guild_id, joined_within, younger_than) };
+			scan_truncated = scan.truncated;
+			scan_failed = scan.failed;
+			for (dpp::guild_member& member : scan.matches) {
+				candidates.push_back(member.user_id);
+				listed.emplace(member.user_id, std::move(member));
+			}
+		}
+		else for (const uint64_t user_id : parse_user_ids(std::get<std::string>(users_param))) candidates.emplace_back(user_id);
+
+		if (candidates.empty()) {
+			event.co_edit_original_response(dpp::message{ "No accounts matched." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+		// A filter that's too wide could take the whole server with it
+		if (candidates.size() > max_mass_ban_targets) {
+			event.co_edit_original_response(dpp::message{ std::format("Error: {} accounts matched, at most {} can be banned at once. Narrow it down and try again.", candidates.size(), max_mass_ban_targets) }
+				.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		// Same hierarchy rules as a single ban, for the issuer and for the bot, in one pass each
+		std::vector<HierarchyCheck> issuer_checks{ permission_cache.can_act_on(issuer_member, std::span<const dpp::snowflake>{ candidates }) };
+		std::vector<HierarchyCheck> bot_checks{ permission_cache.can_act_on(bot_member, std::span<const dpp::snowflake>{ candidates }) };
+
+		// Targets the permission cache doesn't have may well outrank the issuer or the bot, so each is looked up
+		// Only a user Discord confirms isn't a member (ex. they already left) is banned without a role to compare
+		std::vector<std::size_t> to_look_up{};
+		std::vector<dpp::task<MemberLookup>> lookups{};
+		for (std::size_t i{ 0 }; i < candidates.size(); ++i) {
+			if (issuer_checks[i] != HierarchyCheck::Unknown && bot_checks[i] != HierarchyCheck::Unknown) continue;
+
+			if (const auto it{ listed.find(candidates[i]) }; it != listed.end()) {
+				issuer_checks[i] = permission_cache.can_act_on(issuer_member, it->second);
+				bot_checks[i] = permission_cache.can_act_on(bot_member, it->second);
+				continue;
+			}
+			// Started right away, the REST scheduler paces them
+			to_look_up.push_back(i);
+			lookups.push_back(member_resolver.co_lookup(bot, guild_id, candidates[i]));
+		}
+
+		uint64_t unverified{ 0 };
+		for (std::size_t j{ 0 }; j < lookups.size(); ++j) {
+			const std::size_t i{ to_look_up[j] };
+			const MemberLookup lookup{ co_await lookups[j] };
+			if (lookup.member.has_value()) {
+				issuer_checks[i] = permission_cache.can_act_on(issuer_member, lookup.member.value());
+				bot_checks[i] = permission_cache.can_act_on(bot_member, lookup.member.value());
+			}
+			else if (lookup.not_a_member) issuer_checks[i] = bot_checks[i] = HierarchyCheck::Allowed;
+			else ++unverified;
+		}
+
+		std::vector<dpp::snowflake> targets{};
+		targets.reserve(candidates.size());
+		for (std::size_t i{ 0 }; i < candidates.size(); ++i) {
+			if (candidates[i] == bot.me.id || candidates[i] == issuer_member.user_id || candidates[i] == owner_id) continue;
+			// Still unknown when the lookup failed, which counts as protected
+			if (issuer_checks[i] != HierarchyCheck::Allowed || bot_checks[i] != HierarchyCheck::Allowed) continue;
+			targets.push_back(candidates[i]);
+		}
+		const uint64_t skipped{ candidates.size() - targets.size() };
+
+		// Appended to every reply below
+		std::string notes{};
+		if (unverified > 0) notes += std::format(" {} of the skipped accounts couldn't be looked up.", unverified);
+		if (scan_truncated) notes += std::format(" The listing stopped after {} members, newer accounts weren't checked. Lower `account_younger_than_hours` to reach them.", max_scanned_pages * members_page_size);
+		if (scan_failed) notes += " Listing the server's members failed partway, not every member was checked.";
+
+		if (dry_run) {
+			event.co_edit_original_response(dpp::message{ std::format("{} accounts would be banned, {} are protected by the role hierarchy.{}", targets.size(), skipped, notes) }
+				.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+		if (targets.empty()) {
+			event.co_edit_original_response(dpp::message{ std::format("All {} matched accounts are protected by the role hierarchy.{}", skipped, notes) }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		const uint32_t delete_message_seconds{ static_cast<uint32_t>(std::clamp<int64_t>(delete_hours, 0, 168) * 3600) };
+		const std::string route{ rest_route("guild_bulk_ban", guild_id) };
+
+		// Every chunk is queued before the first one is awaited, the scheduler spaces them to the route's rate limit
+		const auto started{ std::chrono::steady_clock::now() };
+		std::vector<dpp::async<dpp::confirmation_callback_t>> calls{};
+		for (std::size_t first{ 0 }; first < targets.size(); first += bulk_ban_chunk_size) {
+			std::vector<dpp::snowflake> chunk{ targets.begin() + first, targets.begin() + std::min(first + bulk_ban_chunk_size, targets.size()) };
+			calls.push_back(rest_scheduler.co_submit(RestLane::Interaction, route,
+				[&bot, guild_id, chunk = std::move(chunk), delete_message_seconds](dpp::command_completion_event_t callback) {
+					bot.guild_bulk_ban_create(guild_id, chunk, delete_message_seconds, std::move(callback));
+				}));
+		}
+
+		std::vector<dpp::snowflake> banned{};
+		uint64_t failed{ 0 };
+		std::string last_error{};
+		for (std::size_t i{ 0 }; i < calls.size(); ++i) {
+			const dpp::confirmation_callback_t result{ co_await calls[i] };
+			const std::size_t chunk_size{ std::min(bulk_ban_chunk_size, targets.size() - i * bulk_ban_chunk_size) };
+
+			if (result.is_error()) {
+				failed += chunk_size;
+				last_error = result.get_error().message;
+				continue;
+			}
+
+			const dpp::bulk_ban outcome{ result.get<dpp::bulk_ban>() };
+			banned.insert(banned.end(), outcome.banned.begin(), outcome.banned.end());
+			failed += outcome.failed.size();
+		}
+
+		const double elapsed{ std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(), 0.001) };
+		const double bans_per_second{ static_cast<double>(banned.size()) / elapsed };
+
+		Logger::info(false, "`/mass_ban` in guild {}: {} banned, {} failed, {} skipped in {:.2f} s ({:.1f} bans/s)",
+			guild_id, banned.size(), failed, skipped, elapsed, bans_per_second);
+		if (!last_error.empty()) Logger::error(false, "`/mass_ban` bulk ban call failed: {}", last_error);
+
+		{
+			// Scoped to the reply, the audit log below isn't part of it
+			render::ReplyMeter meter{ "mass_ban" };
+			render::Arena arena{};
+
+			std::pmr::string reply{ arena.format("Banned {} of {} accounts in {:.2f} s ({:.1f} bans/s).", banned.size(), targets.size(), elapsed, bans_per_second) };
+			if (failed > 0) render::Arena::format_to(reply, " {} couldn't be banned.", failed);
+			if (skipped > 0) render::Arena::format_to(reply, " {} were skipped as the role hierarchy protects them.", skipped);
+			reply += notes;
+			if (!get_log_channel(guild_id, CommandType::BanEdit).has_value()) reply += " No ban log channel is set, so this wasn't logged.";
+			event.co_edit_original_response(dpp::message{ render::to_string(reply) }.set_flags(dpp::m_ephemeral));
+		}
+
+		// One entry for the whole raid, not one per account
+		send_audit_log(bot, event, CommandType::BanEdit, 15158332, "Mass Ban", std::span<const dpp::snowflake>{ banned }, issuer_member, // 15158332 = Hex: #E74C3C
+			BulkOutcome{ .succeeded = banned.size(), .failed = failed, .skipped = skipped, .per_second = bans_per_second }, get_reason_from_event(event));
+	}
+	catch (const dpp::exception& e) {
+		Logger::exception(false, "D++ exception thrown in `/mass_ban`: {}", std::string(e.what()));
+		event.co_edit_original_response(render::exception_reply());
+	}
+	catch (const std::exception& e) {
+		Logger::exception(false, "Standard exception thrown in `/mass_ban`: {}", std::string(e.what()));
+		event.co_edit_original_response(render::exception_reply());
+	}
+	catch (...) {
+		Logger::exception(false, "Unknown exception thrown in `/mass_ban`");
+		event.co_edit_original_response(render::exception_reply());
+	}
+}
+
+void register_mass_ban_command() {
+	commands[command_table::index_of("mass_ban")] = {
+		.coroutine = handle_mass_ban,
+		.description = "Bans many accounts at once, by ID or by join time and account age.",
+		.permissions = dpp::p_ban_members, // Base permission
+		.is_restricted_to_owners = false, // Not restricted to dev guild
+		.options = {
+			dpp::command_option(dpp::co_string, "users", "User IDs or mentions to ban", false),
+			dpp::command_option(dpp::co_integer, "joined_within_minutes", "Ban the members who joined in the last N minutes", false).set_min_value(1).set_max_value(10080),
+			dpp::command_option(dpp::co_integer, "account_younger_than_hours", "Ban the members whose account is younger than N hours", false).set_min_value(1).set_max_value(8760),
+			dpp::command_option(dpp::co_integer, "delete_message_hours", "Delete the last N hours of their messages (defaults to 0)", false).set_min_value(0).set_max_value(168),
+			dpp::command_option(dpp::co_boolean, "dry_run", "Only count the accounts that would be banned", false),
+			dpp::command_option(dpp::co_string, "reason", "The reason", false)
+		}
+	};
+}
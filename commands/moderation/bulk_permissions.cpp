@@ -0,0 +1,137 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <immintrin.h> (with AVX2)
+ * #include <vector>
+ * #include <span>
+ * #include <algorithm>
+ * #include <bit>
+ * #include <cstdint>
+ * #include <dpp/permissions.h>
+ * #include <moderation/bulk_permissions.hpp>
+ */
+
+#include <pch.hpp>
+
+// Members processed per block, so the block's masks stay in L1 across the columns
+static constexpr std::size_t block_size{ 1024 };
+
+// Share of members whose roles all fit in the columns, the rest spill into `overflow`
+static constexpr double column_coverage{ 0.99 };
+
+PermissionTable make_permission_table(const uint64_t everyone, const uint64_t owner_id, std::vector<uint64_t> role_masks, std::vector<uint64_t> member_ids,
+	std::span<const uint32_t> member_offsets, std::span<const uint32_t> member_slots) {
+	PermissionTable table{ .everyone = everyone, .owner_id = owner_id, .role_masks = std::move(role_masks), .member_ids = std::move(member_ids) };
+	if (table.role_masks.empty()) table.role_masks.push_back(0);
+
+	const std::size_t n{ table.size() };
+
+	// Pick the width from the distribution of role counts, one member with 200 roles shouldn't pad every other member to 200
+	std::vector<std::size_t> counts(n);
+	for (std::size_t i{ 0 }; i < n; ++i) counts[i] = member_offsets[i + 1] - member_offsets[i];
+	if (n > 0) {
+		std::vector<std::size_t> sorted{ counts };
+		const std::size_t cut{ std::min(n - 1, static_cast<std::size_t>(static_cast<double>(n) * column_coverage)) };
+		std::nth_element(sorted.begin(), sorted.begin() + cut, sorted.end());
+		table.width = sorted[cut];
+	}
+
+	table.slots.assign(table.width * n, 0);
+	for (std::size_t i{ 0 }; i < n; ++i) {
+		const uint32_t* member{ member_slots.data() + member_offsets[i] };
+		for (std::size_t j{ 0 }; j < counts[i]; ++j) {
+			if (j < table.width) table.slots[j * n + i] = member[j];
+			else table.overflow.emplace_back(static_cast<uint32_t>(i), member[j]);
+		}
+	}
+	return table;
+}
+
+void evaluate_permissions(const PermissionTable& table, std::span<uint64_t> out) {
+	const std::size_t n{ table.size() };
+	const uint64_t* masks{ table.role_masks.data() };
+
+	for (std::size_t begin{ 0 }; begin < n; begin += block_size) {
+		const std::size_t end{ std::min(n, begin + block_size) };
+		std::fill(out.begin() + begin, out.begin() + end, table.everyone);
+
+		for (std::size_t column{ 0 }; column < table.width; ++column) {
+			const uint32_t* slots{ table.slots.data() + column * n };
+			std::size_t i{ begin };
+
+#if defined(__AVX2__)
+			// Four members at a time: gather their role's mask and OR it in
+			for (; i + 4 <= end; i += 4) {
+				const __m128i index{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots + i)) };
+				const __m256i gathered{ _mm256_i32gather_epi64(reinterpret_cast<const long long*>(masks), index, 8) };
+				const __m256i acc{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out.data() + i)) };
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out.data() + i), _mm256_or_si256(acc, gathered));
+			}
+#endif // __AVX2__
+
+			for (; i < end; ++i) out[i] |= masks[slots[i]];
+		}
+	}
+
+	for (const auto& [row, slot] : table.overflow) out[row] |= masks[slot];
+}
+
+std::size_t evaluate_allowed(const PermissionTable& table, std::span<const uint64_t> effective, const uint64_t required, std::span<uint8_t> allowed) {
+	const std::size_t n{ table.size() };
+	const uint64_t admin{ dpp::p_administrator };
+	std::size_t count{ 0 };
+	std::size_t i{ 0 };
+
+#if defined(__AVX2__)
+	const __m256i required_v{ _mm256_set1_epi64x(static_cast<long long>(required)) };
+	const __m256i admin_v{ _mm256_set1_epi64x(static_cast<long long>(admin)) };
+	for (; i + 4 <= n; i += 4) {
+		const __m256i v{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(effective.data() + i)) };
+		const __m256i has_required{ _mm256_cmpeq_epi64(_mm256_and_si256(v, required_v), required_v) };
+		const __m256i is_admin{ _mm256_cmpeq_epi64(_mm256_and_si256(v, admin_v), admin_v) };
+		const int bits{ _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_or_si256(has_required, is_admin))) };
+
+		for (std::size_t lane{ 0 }; lane < 4; ++lane) allowed[i + lane] = static_cast<uint8_t>((bits >> lane) & 1);
+		count += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(bits)));
+	}
+#endif // __AVX2__
+
+	for (; i < n; ++i) {
+		const bool ok{ (effective[i] & required) == required || (effective[i] & admin) == admin };
+		allowed[i] = ok ? 1 : 0;
+		count += ok ? 1 : 0;
+	}
+
+	// The owner has every permission regardless of their roles
+	for (std::size_t row{ 0 }; row < n; ++row) {
+		if (table.member_ids[row] != table.owner_id) continue;
+		if (!allowed[row]) ++count;
+		allowed[row] = 1;
+		break;
+	}
+	return count;
+}
+
+bool bulk_permissions_use_simd() {
+#if defined(__AVX2__)
+	return true;
+#else
+	return false;
+#endif // __AVX2__
+}
@@ -0,0 +1,76 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BULK_PERMISSIONS_HPP
+#define BULK_PERMISSIONS_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <vector>
+ * #include <span>
+ * #include <utility>
+ * #include <cstdint>
+ */
+
+#include <pch.hpp>
+
+/*
+ * @brief A guild's members and roles laid out for bulk permission evaluation
+ *
+ * Role permissions are kept in `role_masks`, and each member's roles are stored as indices ("slots") into it
+ * The first `width` roles of every member are stored column by column, so one column holds
+ * one role of every member, padded with slot 0 (no permissions)
+ * The few members with more roles than `width` keep the rest in `overflow`
+ */
+struct PermissionTable {
+	uint64_t everyone{ 0 }; // Permissions of @everyone, every member has them
+	uint64_t owner_id{ 0 };
+	std::vector<uint64_t> role_masks; // Slot 0 is the padding role
+	std::vector<uint64_t> member_ids;
+	std::size_t width{ 0 };
+	std::vector<uint32_t> slots; // `width` columns of `member_ids.size()` slots each
+	std::vector<std::pair<uint32_t, uint32_t>> overflow; // (member row, role slot)
+
+	std::size_t size() const { return member_ids.size(); }
+};
+
+/*
+ * @brief Builds a table from each member's role slots
+ * @param role_masks Permissions per slot, slot 0 must be 0
+ * @param member_offsets The slots of member `i` are `member_slots[member_offsets[i]..member_offsets[i + 1]]`
+ */
+PermissionTable make_permission_table(const uint64_t everyone, const uint64_t owner_id, std::vector<uint64_t> role_masks, std::vector<uint64_t> member_ids,
+	std::span<const uint32_t> member_offsets, std::span<const uint32_t> member_slots);
+
+// Effective permissions of every member of `table`, channel overwrites not included
+// `out` must hold `table.size()` masks
+void evaluate_permissions(const PermissionTable& table, std::span<uint64_t> out);
+
+/*
+ * @brief Which members have all of `required`, administrators and the owner always do
+ * @param effective The output of `evaluate_permissions`
+ * @param allowed Set to 1 for each allowed member, must hold `table.size()` entries
+ * @return The number of allowed members
+ */
+std::size_t evaluate_allowed(const PermissionTable& table, std::span<const uint64_t> effective, const uint64_t required, std::span<uint8_t> allowed);
+
+// Whether the kernels above were built with AVX2
+bool bulk_permissions_use_simd();
+
+#endif // BULK_PERMISSIONS_HPP
@@ -0,0 +1,222 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <optional>
+ * #include <shared_mutex>
+ * #include <mutex>
+ * #include <algorithm>
+ * #include <cstdint>
+ * #include <dpp/cache.h>
+ * #include <dpp/channel.h>
+ * #include <dpp/cluster.h>
+ * #include <dpp/dispatcher.h>
+ * #include <dpp/guild.h>
+ * #include <dpp/permissions.h>
+ * #include <moderation/channel_permissions.hpp>
+ * #include <moderation/permission_cache.hpp>
+ * #include <moderation/mod_utils.hpp>
+ */
+
+#include <pch.hpp>
+
+ChannelPermissionResolver channel_permissions;
+
+// Memoized members per channel before the channel's memo starts over
+static constexpr std::size_t memo_capacity{ 4096 };
+
+ChannelPermissionResolver::ChannelEntry ChannelPermissionResolver::load_channel(const dpp::channel& c) {
+	ChannelEntry channel{ .guild_id = c.guild_id, .overwrites = {}, .memo = {} };
+	channel.overwrites.reserve(c.permission_overwrites.size());
+	for (const dpp::permission_overwrite& o : c.permission_overwrites)
+		channel.overwrites.push_back(Overwrite{ .id = o.id, .allow = o.allow, .deny = o.deny, .is_member = o.type == dpp::ot_member });
+	return channel;
+}
+
+uint64_t ChannelPermissionResolver::apply_overwrites(const ChannelEntry& channel, const dpp::guild_member& member, uint64_t permissions) {
+	const std::vector<dpp::snowflake>& roles{ member.get_roles() };
+	uint64_t role_allow{ 0 }, role_deny{ 0 };
+	const Overwrite* member_overwrite{ nullptr };
+
+	// @everyone's overwrite comes first, then all role overwrites at once, then the member's
+	for (const Overwrite& o : channel.overwrites) {
+		if (o.is_member) {
+			if (o.id == static_cast<uint64_t>(member.user_id)) member_overwrite = &o;
+		}
+		else if (o.id == channel.guild_id) permissions = (permissions & ~o.deny) | o.allow;
+		else if (std::find(roles.begin(), roles.end(), dpp::snowflake{ o.id }) != roles.end()) {
+			role_allow |= o.allow;
+			role_deny |= o.deny;
+		}
+	}
+
+	permissions = (permissions & ~role_deny) | role_allow;
+	if (member_overwrite) permissions = (permissions & ~member_overwrite->deny) | member_overwrite->allow;
+	return permissions;
+}
+
+std::optional<dpp::permission> ChannelPermissionResolver::get(const dpp::guild_member& member, const uint64_t channel_id) {
+	const uint64_t fingerprint{ roles_fingerprint(member.get_roles()) };
+
+	// Owners and administrators aren't affected by overwrites
+	const uint64_t role_permissions{ permission_cache.get(member).permissions };
+	const bool is_owner{ permission_cache.get_owner_id(member.guild_id) == static_cast<uint64_t>(member.user_id) };
+	const bool bypasses_overwrites{ is_owner || (role_permissions & dpp::p_administrator) == dpp::p_administrator };
+	const uint64_t base{ bypasses_overwrites ? ~uint64_t{ 0 } : role_permissions };
+
+	Stripe& stripe{ stripe_of(channel_id) };
+
+	{
+		std::shared_lock lock{ stripe.mtx };
+		if (const auto channel{ stripe.channels.find(channel_id) }; channel != stripe.channels.end()) {
+			const auto memo{ channel->second.memo.find(member.user_id) };
+			if (memo != channel->second.memo.end() && memo->second.fingerprint == fingerprint && memo->second.base == base)
+				return dpp::permission{ memo->second.permissions };
+		}
+	}
+
+	bool has_channel{ false };
+	{
+		std::shared_lock lock{ stripe.mtx };
+		has_channel = stripe.channels.contains(channel_id);
+	}
+	if (!has_channel) {
+		const dpp::channel* c{ dpp::find_channel(channel_id) };
+		if (!c) return std::nullopt;
+		on_channel_changed(*c);
+	}
+
+	std::unique_lock lock{ stripe.mtx };
+	const auto channel{ stripe.channels.find(channel_id) };
+	if (channel == stripe.channels.end()) return std::nullopt; // Deleted meanwhile
+
+	const uint64_t permissions{ bypasses_overwrites ? base : apply_overwrites(channel->second, member, base) };
+	if (channel->second.memo.size() >= memo_capacity) channel->second.memo.clear();
+	channel->second.memo.insert_or_assign(member.user_id, MemoEntry{ .fingerprint = fingerprint, .base = base, .permissions = permissions });
+	return dpp::permission{ permissions };
+}
+
+bool ChannelPermissionResolver::has(const dpp::guild_member& member, const uint64_t channel_id, const uint64_t required) {
+	const std::optional<dpp::permission> permissions{ get(member, channel_id) };
+	return !permissions.has_value() || (static_cast<uint64_t>(permissions.value()) & required) == required;
+}
+
+void ChannelPermissionResolver::index_overwrites(const uint64_t channel_id, const std::vector<Overwrite>& removed, const std::vector<Overwrite>& added) {
+	std::lock_guard lock{ index_mtx };
+	for (const Overwrite& o : removed) {
+		if (o.is_member) continue;
+		const auto it{ channels_by_role.find(o.id) };
+		if (it == channels_by_role.end()) continue;
+		std::erase(it->second, channel_id);
+		if (it->second.empty()) channels_by_role.erase(it);
+	}
+	for (const Overwrite& o : added) if (!o.is_member) channels_by_role[o.id].push_back(channel_id);
+}
+
+void ChannelPermissionResolver::index_guild(const uint64_t channel_id, const uint64_t guild_id, const bool cached) {
+	std::lock_guard lock{ index_mtx };
+	if (cached) {
+		channels_by_guild[guild_id].push_back(channel_id);
+		return;
+	}
+
+	const auto it{ channels_by_guild.find(guild_id) };
+	if (it == channels_by_guild.end()) return;
+	std::erase(it->second, channel_id);
+	if (it->second.empty()) channels_by_guild.erase(it);
+}
+
+void ChannelPermissionResolver::on_channel_changed(const dpp::channel& c) {
+	// Built outside the lock, the overwrites are copied out of D++'s channel
+	ChannelEntry channel{ load_channel(c) };
+
+	Stripe& stripe{ stripe_of(c.id) };
+	std::unique_lock lock{ stripe.mtx };
+	const auto it{ stripe.channels.find(c.id) };
+	if (it != stripe.channels.end()) index_overwrites(c.id, it->second.overwrites, channel.overwrites);
+	else {
+		index_overwrites(c.id, {}, channel.overwrites);
+		index_guild(c.id, channel.guild_id, true);
+	}
+	stripe.channels.insert_or_assign(c.id, std::move(channel));
+}
+
+void ChannelPermissionResolver::on_channel_removed(const uint64_t channel_id) {
+	Stripe& stripe{ stripe_of(channel_id) };
+	std::unique_lock lock{ stripe.mtx };
+	const auto it{ stripe.channels.find(channel_id) };
+	if (it == stripe.channels.end()) return;
+	index_overwrites(channel_id, it->second.overwrites, {});
+	index_guild(channel_id, it->second.guild_id, false);
+	stripe.channels.erase(it);
+}
+
+void ChannelPermissionResolver::on_role_deleted(const uint64_t role_id) {
+	// Role creates and updates need nothing here, a memoized result is checked against the member's current role permissions
+	// A deleted role's overwrites stay on the channels though, and would still apply to members whose cached roles list it
+	std::vector<uint64_t> channel_ids{};
+	{
+		std::lock_guard lock{ index_mtx };
+		const auto it{ channels_by_role.find(role_id) };
+		if (it == channels_by_role.end()) return;
+		channel_ids = std::move(it->second);
+		channels_by_role.erase(it);
+	}
+
+	for (const uint64_t channel_id : channel_ids) {
+		Stripe& stripe{ stripe_of(channel_id) };
+		std::unique_lock lock{ stripe.mtx };
+		const auto it{ stripe.channels.find(channel_id) };
+		if (it == stripe.channels.end()) continue;
+		std::erase_if(it->second.overwrites, [role_id](const Overwrite& o) { return !o.is_member && o.id == role_id; });
+		it->second.memo.clear();
+	}
+}
+
+void ChannelPermissionResolver::on_guild_removed(const uint64_t guild_id) {
+	std::vector<uint64_t> channel_ids{};
+	{
+		std::lock_guard lock{ index_mtx };
+		const auto it{ channels_by_guild.find(guild_id) };
+		if (it == channels_by_guild.end()) return;
+		channel_ids = it->second;
+	}
+
+	for (const uint64_t channel_id : channel_ids) on_channel_removed(channel_id);
+}
+
+void ChannelPermissionResolver::attach(dpp::cluster& bot) {
+	bot.on_channel_update([this](const dpp::channel_update_t& event) {
+		if (const dpp::channel* c{ event_object(event.updated) }) on_channel_changed(*c);
+	});
+
+	bot.on_channel_delete([this](const dpp::channel_delete_t& event) {
+		if (const dpp::channel* c{ event_object(event.deleted) }) on_channel_removed(c->id);
+	});
+
+	bot.on_guild_role_delete([this](const dpp::guild_role_delete_t& event) {
+		on_role_deleted(event.role_id);
+	});
+
+	// Members whose roles changed are caught by their fingerprint, those who left go when the channel's memo starts over
+	bot.on_guild_delete([this](const dpp::guild_delete_t& event) {
+		if (const dpp::guild* g{ event_object(event.deleted) }) on_guild_removed(g->id);
+	});
+}
@@ -0,0 +1,110 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHANNEL_PERMISSIONS_HPP
+#define CHANNEL_PERMISSIONS_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <array>
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <optional>
+ * #include <shared_mutex>
+ * #include <mutex>
+ * #include <cstdint>
+ * #include <dpp/channel.h>
+ * #include <dpp/cluster.h>
+ * #include <dpp/guild.h>
+ * #include <dpp/permissions.h>
+ */
+
+#include <pch.hpp>
+
+/*
+ * @brief Resolves a member's permissions in a channel, channel overwrites included
+ *
+ * Overwrites are applied the way Discord does: @everyone's, then all of the member's roles' together, then the member's own
+ * Results are memoized per (channel, member) along with the role permissions they were built from, so a member
+ * whose roles or role permissions changed is resolved again. A channel update drops the channel's results, and a deleted
+ * role drops the results of the channels that have an overwrite for it, found through `channels_by_role`
+ * A guild the bot leaves drops its channels, found through `channels_by_guild`
+ */
+class ChannelPermissionResolver {
+public:
+	void attach(dpp::cluster& bot);
+
+	// The member's permissions in the channel, or nothing if the channel isn't cached
+	std::optional<dpp::permission> get(const dpp::guild_member& member, const uint64_t channel_id);
+
+	// Whether the member has all of `required` in the channel. An uncached channel counts as allowed, the REST call will tell
+	bool has(const dpp::guild_member& member, const uint64_t channel_id, const uint64_t required);
+
+private:
+	struct Overwrite {
+		uint64_t id{ 0 };
+		uint64_t allow{ 0 };
+		uint64_t deny{ 0 };
+		bool is_member{ false };
+	};
+
+	struct MemoEntry {
+		uint64_t fingerprint{ 0 }; // Of the member's roles
+		uint64_t base{ 0 }; // The permissions from the member's roles the result was built from, all of them for owners and administrators
+		uint64_t permissions{ 0 };
+	};
+
+	struct ChannelEntry {
+		uint64_t guild_id{ 0 };
+		std::vector<Overwrite> overwrites;
+		std::unordered_map<uint64_t, MemoEntry> memo; // By user ID
+	};
+
+	struct Stripe {
+		std::shared_mutex mtx;
+		std::unordered_map<uint64_t, ChannelEntry> channels;
+	};
+
+	static constexpr std::size_t stripe_count{ 16 };
+	std::array<Stripe, stripe_count> stripes;
+
+	// Channels with a role overwrite, by role ID, and cached channels by guild ID. Taken after a stripe's lock, never before
+	std::mutex index_mtx;
+	std::unordered_map<uint64_t, std::vector<uint64_t>> channels_by_role;
+	std::unordered_map<uint64_t, std::vector<uint64_t>> channels_by_guild;
+
+	Stripe& stripe_of(const uint64_t channel_id) { return stripes[(channel_id >> 22) % stripe_count]; }
+
+	static ChannelEntry load_channel(const dpp::channel& c);
+	static uint64_t apply_overwrites(const ChannelEntry& channel, const dpp::guild_member& member, uint64_t permissions);
+
+	// Moves `channel_id` from the roles overwritten in `removed` to those in `added`, with the channel's stripe locked
+	void index_overwrites(const uint64_t channel_id, const std::vector<Overwrite>& removed, const std::vector<Overwrite>& added);
+	// Adds or removes `channel_id` from its guild's channels, with the channel's stripe locked
+	void index_guild(const uint64_t channel_id, const uint64_t guild_id, const bool cached);
+
+	void on_channel_changed(const dpp::channel& c);
+	void on_channel_removed(const uint64_t channel_id);
+	void on_role_deleted(const uint64_t role_id);
+	void on_guild_removed(const uint64_t guild_id);
+};
+
+extern ChannelPermissionResolver channel_permissions;
+
+#endif // CHANNEL_PERMISSIONS_HPP
@@ -0,0 +1,248 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <list>
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <unordered_set>
+ * #include <optional>
+ * #include <mutex>
+ * #include <chrono>
+ * #include <format>
+ * #include <cstdint>
+ * #include <dpp/cluster.h>
+ * #include <dpp/coro.h>
+ * #include <dpp/discordclient.h>
+ * #include <dpp/dispatcher.h>
+ * #include <dpp/guild.h>
+ * #include <dpp/appcommand.h>
+ * #include <dpp/nlohmann/json.hpp>
+ * #include <moderation/member_resolver.hpp>
+ * #include <moderation/mod_utils.hpp>
+ * #include <rest_scheduler/rest_scheduler.hpp>
+ */
+
+#include <pch.hpp>
+
+using json = nlohmann::json;
+
+MemberResolver member_resolver;
+
+// Members kept across all shards
+static constexpr std::size_t member_cache_capacity{ 50'000 };
+
+// Without the members intent, member updates aren't received, so entries can't be trusted forever
+static constexpr std::chrono::minutes member_ttl{ 5 };
+
+// How often the queued refreshes are sent to the gateway
+static constexpr uint64_t prefetch_interval_seconds{ 5 };
+
+// Discord accepts up to 100 user IDs per member request
+static constexpr std::size_t max_ids_per_request{ 100 };
+
+std::optional<dpp::guild_member> MemberResolver::lookup(const Key& key) {
+	Shard& shard{ shard_of(key) };
+	bool needs_refresh{ false };
+	std::optional<dpp::guild_member> member{};
+
+	{
+		std::scoped_lock lock{ shard.mtx };
+		const auto it{ shard.index.find(key) };
+		if (it == shard.index.end()) return std::nullopt;
+
+		const auto age{ clock::now() - it->second->stored_at };
+		if (age > member_ttl) {
+			shard.lru.erase(it->second);
+			shard.index.erase(it);
+			return std::nullopt;
+		}
+
+		shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+		member = it->second->member;
+		needs_refresh = age > member_ttl / 2;
+	}
+
+	if (needs_refresh) queue_prefetch(key);
+	return member;
+}
+
+void MemberResolver::store(const dpp::guild_member& member) {
+	const Key key{ .guild_id = member.guild_id, .user_id = member.user_id };
+	if (key.guild_id == 0 || key.user_id == 0) return;
+
+	Shard& shard{ shard_of(key) };
+	std::scoped_lock lock{ shard.mtx };
+
+	if (const auto it{ shard.index.find(key) }; it != shard.index.end()) {
+		it->second->member = member;
+		it->second->stored_at = clock::now();
+		shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+		return;
+	}
+
+	shard.lru.push_front(Entry{ .key = key, .member = member, .stored_at = clock::now() });
+	shard.index.emplace(key, shard.lru.begin());
+
+	// Evict the least recently used
+	while (shard.lru.size() > member_cache_capacity / shard_count) {
+		shard.index.erase(shard.lru.back().key);
+		shard.lru.pop_back();
+	}
+}
+
+void MemberResolver::forget(const uint64_t guild_id, const uint64_t user_id) {
+	const Key key{ .guild_id = guild_id, .user_id = user_id };
+	Shard& shard{ shard_of(key) };
+	std::scoped_lock lock{ shard.mtx };
+
+	if (const auto it{ shard.index.find(key) }; it != shard.index.end()) {
+		shard.lru.erase(it->second);
+		shard.index.erase(it);
+	}
+}
+
+dpp::task<std::optional<dpp::guild_member>> MemberResolver::co_resolve(dpp::cluster& bot, const uint64_t guild_id, const uint64_t user_id) {
+	MemberLookup lookup{ co_await co_lookup(bot, guild_id, user_id) };
+	co_return std::move(lookup.member);
+}
+
+dpp::task<MemberLookup> MemberResolver::co_lookup(dpp::cluster& bot, const uint64_t guild_id, const uint64_t user_id) {
+	const Key key{ .guild_id = guild_id, .user_id = user_id };
+
+	if (std::optional<dpp::guild_member> member{ lookup(key) }) {
+		hits.fetch_add(1, std::memory_order_relaxed);
+		co_return MemberLookup{ .member = std::move(member), .not_a_member = false };
+	}
+
+	// D++'s member cache isn't consulted: without the members intent its copies are never updated, and they carry no age the TTL could apply to
+
+	const auto started{ clock::now() };
+	const dpp::confirmation_callback_t result{ co_await rest_scheduler.co_submit(RestLane::Interaction, rest_route("guild_member", guild_id),
+		[&bot, guild_id, user_id](dpp::command_completion_event_t callback) { bot.guild_get_member(guild_id, user_id, std::move(callback)); }) };
+
+	rest_fetches.fetch_add(1, std::memory_order_relaxed);
+	rest_latency_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - started).count(), std::memory_order_relaxed);
+
+	if (result.is_error()) {
+		// Unknown Member, or Unknown User for an ID that was never an account
+		const int code{ static_cast<int>(result.get_error().code) };
+		if (code == 10007 || code == 10013) co_return MemberLookup{ .member = std::nullopt, .not_a_member = true };
+
+		failures.fetch_add(1, std::memory_order_relaxed);
+		co_return MemberLookup{};
+	}
+
+	dpp::guild_member member{ result.get<dpp::guild_member>() };
+	member.guild_id = guild_id;
+	store(member);
+	co_return MemberLookup{ .member = std::move(member), .not_a_member = false };
+}
+
+std::optional<MemberLookup> MemberResolver::from_interaction(const dpp::interaction& command, const uint64_t user_id) {
+	std::optional<dpp::guild_member> member{};
+	if (static_cast<uint64_t>(command.member.user_id) == user_id) member = command.member;
+	else if (const auto it{ command.resolved.members.find(user_id) }; it != command.resolved.members.end()) member = it->second;
+	// Discord resolves the user either way, and leaves their member data out when they aren't in the guild
+	else if (!command.resolved.users.contains(user_id)) return std::nullopt;
+
+	hits.fetch_add(1, std::memory_order_relaxed);
+	interaction_hits.fetch_add(1, std::memory_order_relaxed);
+	if (!member.has_value()) return MemberLookup{ .member = std::nullopt, .not_a_member = true };
+
+	member->guild_id = command.guild_id;
+	member->user_id = user_id;
+	return MemberLookup{ .member = std::move(member), .not_a_member = false };
+}
+
+void MemberResolver::store_interaction(const dpp::interaction& command) {
+	dpp::guild_member issuer{ command.member };
+	issuer.guild_id = command.guild_id;
+	store(issuer);
+
+	for (const auto& [user_id, resolved] : command.resolved.members) {
+		dpp::guild_member member{ resolved };
+		member.guild_id = command.guild_id;
+		member.user_id = user_id;
+		store(member);
+	}
+}
+
+MemberResolverStats MemberResolver::get_stats() const {
+	return MemberResolverStats{
+		.hits = hits.load(std::memory_order_relaxed),
+		.interaction_hits = interaction_hits.load(std::memory_order_relaxed),
+		.rest_fetches = rest_fetches.load(std::memory_order_relaxed),
+		.failures = failures.load(std::memory_order_relaxed),
+		.rest_latency = std::chrono::microseconds{ rest_latency_us.load(std::memory_order_relaxed) }
+	};
+}
+
+void MemberResolver::queue_prefetch(const Key& key) {
+	std::scoped_lock lock{ prefetch_mtx };
+	prefetch[key.guild_id].insert(key.user_id);
+}
+
+void MemberResolver::flush_prefetch(dpp::cluster& bot) {
+	std::unordered_map<uint64_t, std::unordered_set<uint64_t>> pending{};
+	{
+		std::scoped_lock lock{ prefetch_mtx };
+		pending.swap(prefetch);
+	}
+
+	for (const auto& [guild_id, user_ids] : pending) {
+		dpp::discord_client* shard{ bot.get_shard(static_cast<uint32_t>((guild_id >> 22) % std::max<uint32_t>(bot.numshards, 1))) };
+		if (!shard) continue;
+
+		// Request Guild Members, answered with a member chunk event
+		json ids(json::array());
+		for (const uint64_t user_id : user_ids) {
+			ids.push_back(std::to_string(user_id));
+			if (ids.size() < max_ids_per_request) continue;
+			shard->queue_message(json{ { "op", 8 }, { "d", { { "guild_id", std::to_string(guild_id) }, { "user_ids", ids } } } }.dump());
+			ids = json::array();
+		}
+		if (!ids.empty()) shard->queue_message(json{ { "op", 8 }, { "d", { { "guild_id", std::to_string(guild_id) }, { "user_ids", ids } } } }.dump());
+	}
+}
+
+void MemberResolver::attach(dpp::cluster& bot) {
+	// Interactions carry the current member data of the issuer and of the users in their options for free
+	bot.on_slashcommand([this](const dpp::slashcommand_t& event) {
+		store_interaction(event.command);
+	});
+
+	bot.on_guild_member_add([this](const dpp::guild_member_add_t& event) {
+		store(event.added);
+	});
+
+	bot.on_guild_member_update([this](const dpp::guild_member_update_t& event) {
+		store(event.updated);
+	});
+
+	bot.on_guild_member_remove([this](const dpp::guild_member_remove_t& event) {
+		forget(event.guild_id, event.removed.id);
+	});
+
+	bot.on_guild_members_chunk([this](const dpp::guild_members_chunk_t& event) {
+		if (const dpp::guild_member_map* members{ event_object(event.members) })
+			for (const auto& [user_id, member] : *members) store(member);
+	});
+
+	bot.start_timer([this, &bot](dpp::timer) { flush_prefetch(bot); }, prefetch_interval_seconds);
+}
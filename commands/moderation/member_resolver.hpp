@@ -0,0 +1,139 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef MEMBER_RESOLVER_HPP
+#define MEMBER_RESOLVER_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <array>
+ * #include <list>
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <unordered_set>
+ * #include <optional>
+ * #include <mutex>
+ * #include <atomic>
+ * #include <chrono>
+ * #include <cstdint>
+ * #include <dpp/cluster.h>
+ * #include <dpp/coro.h>
+ * #include <dpp/guild.h>
+ * #include <dpp/appcommand.h>
+ */
+
+#include <pch.hpp>
+
+struct MemberResolverStats {
+	uint64_t hits{ 0 }; // Served from the LRU or the interaction
+	uint64_t interaction_hits{ 0 }; // Of `hits`, answered by the interaction's own member data
+	uint64_t rest_fetches{ 0 };
+	uint64_t failures{ 0 };
+	std::chrono::microseconds rest_latency{ 0 }; // Total over `rest_fetches`
+};
+
+// What `co_lookup` found
+struct MemberLookup {
+	std::optional<dpp::guild_member> member;
+	bool not_a_member{ false }; // Discord answered that the user isn't in the guild, as opposed to the call failing
+};
+
+/*
+ * @brief Looks up guild members from memory first, and over REST only when that fails
+ *
+ * Members come from a bounded LRU fed by interactions, member events and member chunks
+ * Entries older than `member_ttl` are not served. Entries past half of it are refreshed in the
+ * background with a gateway member request (op 8), which answers with a member chunk
+ * Without the members intent, the events and chunks rarely come, so interactions are what mostly feeds it:
+ * the issuer and every member Discord resolved for the command's user options
+ */
+class MemberResolver {
+public:
+	using clock = std::chrono::steady_clock;
+
+	void attach(dpp::cluster& bot);
+
+	// Nothing if the user isn't a member of the guild or the REST call failed
+	dpp::task<std::optional<dpp::guild_member>> co_resolve(dpp::cluster& bot, const uint64_t guild_id, const uint64_t user_id);
+
+	// `co_resolve`, telling a user who isn't a member apart from a failed call
+	dpp::task<MemberLookup> co_lookup(dpp::cluster& bot, const uint64_t guild_id, const uint64_t user_id);
+
+	/*
+	 * @brief Answers from the member data Discord sent with the interaction, the issuer or a resolved user option
+	 * A resolved user without member data isn't in the guild
+	 * @return Nothing if the interaction doesn't mention the user, `co_lookup` has to find them then
+	 */
+	std::optional<MemberLookup> from_interaction(const dpp::interaction& command, const uint64_t user_id);
+
+	void store(const dpp::guild_member& member);
+	// Drops a member whose data is known to have changed (ex. after the bot edited their roles)
+	void forget(const uint64_t guild_id, const uint64_t user_id);
+
+	MemberResolverStats get_stats() const;
+
+private:
+	struct Key {
+		uint64_t guild_id{ 0 };
+		uint64_t user_id{ 0 };
+		bool operator==(const Key&) const = default;
+	};
+
+	struct KeyHash {
+		std::size_t operator()(const Key& key) const noexcept { return std::hash<uint64_t>{}(key.guild_id * 0x9E3779B97F4A7C15ull ^ key.user_id); }
+	};
+
+	struct Entry {
+		Key key;
+		dpp::guild_member member;
+		clock::time_point stored_at;
+	};
+
+	// Each shard is an LRU of its own, the most recently used entry at the front
+	struct Shard {
+		std::mutex mtx;
+		std::list<Entry> lru;
+		std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+	};
+
+	static constexpr std::size_t shard_count{ 16 };
+	std::array<Shard, shard_count> shards;
+
+	// Members to refresh with the next gateway request, per guild
+	std::mutex prefetch_mtx;
+	std::unordered_map<uint64_t, std::unordered_set<uint64_t>> prefetch;
+
+	std::atomic<uint64_t> hits{ 0 };
+	std::atomic<uint64_t> interaction_hits{ 0 };
+	std::atomic<uint64_t> rest_fetches{ 0 };
+	std::atomic<uint64_t> failures{ 0 };
+	std::atomic<int64_t> rest_latency_us{ 0 };
+
+	Shard& shard_of(const Key& key) { return shards[KeyHash{}(key) % shard_count]; }
+
+	std::optional<dpp::guild_member> lookup(const Key& key);
+	void queue_prefetch(const Key& key);
+	void flush_prefetch(dpp::cluster& bot);
+	// Stores the issuer and the members resolved for the command's options
+	void store_interaction(const dpp::interaction& command);
+};
+
+extern MemberResolver member_resolver;
+
+#endif // MEMBER_RESOLVER_HPP
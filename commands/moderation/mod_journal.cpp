@@ -0,0 +1,350 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <string>
+ * #include <string_view>
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <filesystem>
+ * #include <shared_mutex>
+ * #include <mutex>
+ * #include <chrono>
+ * #include <algorithm>
+ * #include <exception>
+ * #include <cstdio>
+ * #include <cstring>
+ * #include <cstdint>
+ * #include <mapped_file/mapped_file.hpp>
+ * #include <durable_file/durable_file.hpp>
+ * #include <moderation/mod_journal.hpp>
+ * #include <shutdown/shutdown.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+ModJournal mod_journal;
+
+/*
+ * File layout, all integers in the host's byte order:
+ *   Header: "ISHMJRNL", u32 version, u32 reserved
+ *   Record: u32 payload length, u32 CRC-32 of the payload, payload
+ *   Payload: i64 timestamp, u64 guild, u64 target, u64 moderator, u8 command type,
+ *            u16 title length, u16 reason length, title, reason
+ */
+static constexpr std::string_view journal_magic{ "ISHMJRNL" };
+static constexpr uint32_t journal_version{ 1 };
+static constexpr std::size_t header_size{ 16 };
+static constexpr std::size_t record_prefix_size{ 8 };
+static constexpr std::size_t payload_fixed_size{ 8 + 8 + 8 + 8 + 1 + 2 + 2 };
+// Anything longer is cut, a page of history has to fit in an embed anyway
+static constexpr std::size_t max_text_length{ 1024 };
+
+template <typename T>
+static void write_value(std::string& out, const T value) {
+	char bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	out.append(bytes, sizeof(T));
+}
+
+template <typename T>
+static T read_value(const uint8_t* in) {
+	T value{};
+	std::memcpy(&value, in, sizeof(T));
+	return value;
+}
+
+static std::string encode_record(const JournalEntry& entry) {
+	const std::string_view title{ utf8_prefix(entry.title, max_text_length) };
+	const std::string_view reason{ utf8_prefix(entry.reason, max_text_length) };
+
+	std::string payload{};
+	payload.reserve(payload_fixed_size + title.size() + reason.size());
+	write_value<int64_t>(payload, entry.timestamp);
+	write_value<uint64_t>(payload, entry.guild_id);
+	write_value<uint64_t>(payload, entry.target_id);
+	write_value<uint64_t>(payload, entry.moderator_id);
+	write_value<uint8_t>(payload, static_cast<uint8_t>(entry.command_type));
+	write_value<uint16_t>(payload, static_cast<uint16_t>(title.size()));
+	write_value<uint16_t>(payload, static_cast<uint16_t>(reason.size()));
+	payload.append(title);
+	payload.append(reason);
+
+	std::string record{};
+	record.reserve(record_prefix_size + payload.size());
+	write_value<uint32_t>(record, static_cast<uint32_t>(payload.size()));
+	write_value<uint32_t>(record, crc32(reinterpret_cast<const uint8_t*>(payload.data()), payload.size()));
+	record.append(payload);
+	return record;
+}
+
+// Returns the size of the record at `data`, or 0 if it is truncated or fails its checksum
+static std::size_t decode_record(const uint8_t* data, const std::size_t available, JournalEntry& out) {
+	if (available < record_prefix_size) return 0;
+
+	const uint32_t payload_size{ read_value<uint32_t>(data) };
+	if (payload_size < payload_fixed_size || payload_size > payload_fixed_size + 2 * max_text_length || available - record_prefix_size < payload_size) return 0;
+
+	const uint8_t* payload{ data + record_prefix_size };
+	if (crc32(payload, payload_size) != read_value<uint32_t>(data + 4)) return 0;
+
+	const uint16_t title_size{ read_value<uint16_t>(payload + 33) };
+	const uint16_t reason_size{ read_value<uint16_t>(payload + 35) };
+	if (payload_fixed_size + title_size + reason_size != payload_size) return 0;
+
+	out.timestamp = read_value<int64_t>(payload);
+	out.guild_id = read_value<uint64_t>(payload + 8);
+	out.target_id = read_value<uint64_t>(payload + 16);
+	out.moderator_id = read_value<uint64_t>(payload + 24);
+	out.command_type = static_cast<CommandType>(payload[32]);
+	out.title.assign(reinterpret_cast<const char*>(payload + payload_fixed_size), title_size);
+	out.reason.assign(reinterpret_cast<const char*>(payload + payload_fixed_size + title_size), reason_size);
+
+	return record_prefix_size + payload_size;
+}
+
+static bool write_header(const std::filesystem::path& file_path) {
+	std::FILE* file{ std::fopen(file_path.string().c_str(), "wb") };
+	if (!file) return false;
+
+	std::string header{ journal_magic };
+	write_value<uint32_t>(header, journal_version);
+	write_value<uint32_t>(header, 0);
+	const bool written{ std::fwrite(header.data(), 1, header.size(), file) == header.size() };
+	return std::fclose(file) == 0 && written;
+}
+
+ModJournal::~ModJournal() {
+	close();
+}
+
+void ModJournal::open(const std::filesystem::path& journal_path) {
+	std::unique_lock lock{ mtx };
+	path = journal_path;
+	load();
+}
+
+void ModJournal::close() {
+	std::unique_lock lock{ mtx };
+	if (writer) std::fclose(writer);
+	writer = nullptr;
+	mapped.unmap();
+	clear_indexes();
+}
+
+void ModJournal::append(const JournalEntry& entry) {
+	const auto in_flight{ pending_writes.track() };
+	const std::string record{ encode_record(entry) };
+
+	std::unique_lock lock{ mtx };
+	if (!writer) return;
+
+	if (std::fwrite(record.data(), 1, record.size(), writer) != record.size() || std::fflush(writer) != 0) {
+		Logger::error(false, "Failed to append to the moderation journal {}", path.string());
+
+		// Cut what made it to disk, so the next record doesn't land after a torn one
+		std::fclose(writer);
+		std::error_code ec{};
+		std::filesystem::resize_file(path, end_offset, ec);
+		writer = std::fopen(path.string().c_str(), "ab");
+		return;
+	}
+
+	index(end_offset, entry);
+	end_offset += record.size();
+}
+
+JournalPage ModJournal::query(const uint64_t guild_id, const JournalFilter filter, const uint64_t filter_id, const std::size_t page, const std::size_t page_size) {
+	{
+		// Appends since the last query aren't mapped yet
+		std::unique_lock lock{ mtx };
+		if (mapped.size() < end_offset) remap();
+	}
+
+	std::shared_lock lock{ mtx };
+	const Offsets* offsets{ nullptr };
+	switch (filter) {
+	case JournalFilter::Guild:
+		if (const auto it{ by_guild.find(guild_id) }; it != by_guild.end()) offsets = &it->second;
+		break;
+	case JournalFilter::Target:
+		if (const auto it{ by_target.find({ guild_id, filter_id }) }; it != by_target.end()) offsets = &it->second;
+		break;
+	case JournalFilter::Moderator:
+		if (const auto it{ by_moderator.find({ guild_id, filter_id }) }; it != by_moderator.end()) offsets = &it->second;
+		break;
+	}
+
+	JournalPage result{};
+	if (!offsets || !mapped.data()) return result;
+
+	// Records appended after the mapping was made wait for the next query
+	const std::size_t visible{ static_cast<std::size_t>(std::lower_bound(offsets->begin(), offsets->end(), static_cast<uint64_t>(mapped.size())) - offsets->begin()) };
+	result.total = visible;
+
+	const std::size_t skipped{ page * page_size };
+	if (skipped >= visible) return result;
+
+	const std::size_t newest{ visible - skipped }; // One past the newest record of the page
+	const std::size_t oldest{ newest > page_size ? newest - page_size : 0 };
+	result.entries.reserve(newest - oldest);
+
+	for (std::size_t i{ newest }; i > oldest; --i) {
+		const uint64_t offset{ (*offsets)[i - 1] };
+		JournalEntry entry{};
+		if (decode_record(mapped.data() + offset, mapped.size() - offset, entry) == 0) continue;
+		result.entries.push_back(std::move(entry));
+	}
+
+	return result;
+}
+
+std::size_t ModJournal::compact(const std::chrono::seconds retention) {
+	const auto in_flight{ pending_writes.track() };
+	std::unique_lock lock{ mtx };
+	if (all_records.empty() || !writer) return 0;
+	if (mapped.size() < end_offset && !remap()) return 0;
+
+	const int64_t cutoff{ std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch() - retention).count() };
+
+	// Records are appended in time order, so the expired ones are a prefix of the file
+	const std::size_t expired{ static_cast<std::size_t>(std::partition_point(all_records.begin(), all_records.end(), [this, cutoff](const uint64_t offset) {
+		return read_value<int64_t>(mapped.data() + offset + record_prefix_size) < cutoff;
+	}) - all_records.begin()) };
+
+	if (expired == 0 || expired * 10 < all_records.size()) return 0;
+
+	const uint64_t keep_from{ expired == all_records.size() ? end_offset : all_records[expired] };
+	std::filesystem::path temp_path{ path };
+	temp_path += ".compact";
+
+	try {
+		// The kept records are copied as they are, their checksums stay valid
+		if (!write_header(temp_path)) throw std::runtime_error("Couldn't write " + temp_path.string());
+		{
+			std::FILE* file{ std::fopen(temp_path.string().c_str(), "ab") };
+			if (!file) throw std::runtime_error("Couldn't open " + temp_path.string());
+			const std::size_t length{ static_cast<std::size_t>(end_offset - keep_from) };
+			const bool written{ std::fwrite(mapped.data() + keep_from, 1, length, file) == length };
+			if (std::fclose(file) != 0 || !written) throw std::runtime_error("Couldn't write " + temp_path.string());
+		}
+
+		// Windows won't replace a file that is still open or mapped
+		std::fclose(writer);
+		writer = nullptr;
+		mapped.unmap();
+
+		std::filesystem::rename(temp_path, path);
+	}
+	catch (const std::exception& e) {
+		Logger::exception(true, "Failed to compact the moderation journal: {}", std::string{ e.what() });
+		std::error_code ec{};
+		std::filesystem::remove(temp_path, ec);
+		if (!writer) load();
+		return 0;
+	}
+
+	load();
+	Logger::info(true, "Compacted the moderation journal, dropped {} entries older than {} days", expired, retention.count() / 86400);
+	return expired;
+}
+
+std::size_t ModJournal::size() const {
+	std::shared_lock lock{ mtx };
+	return all_records.size();
+}
+
+void ModJournal::load() {
+	if (writer) std::fclose(writer);
+	writer = nullptr;
+	mapped.unmap();
+	clear_indexes();
+
+	std::error_code ec{};
+	if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+
+	if (!std::filesystem::exists(path, ec) || std::filesystem::file_size(path, ec) < header_size) {
+		if (!write_header(path)) {
+			Logger::error(true, "Couldn't create the moderation journal {}", path.string());
+			return;
+		}
+	}
+
+	if (!remap() || std::string_view{ reinterpret_cast<const char*>(mapped.data()), journal_magic.size() } != journal_magic) {
+		// Not ours, keep it aside rather than overwrite it
+		mapped.unmap();
+		std::filesystem::path aside{ path };
+		aside += ".corrupt";
+		std::filesystem::rename(path, aside, ec);
+		Logger::error(true, "{} isn't a moderation journal, moved it to {} and started a new one", path.string(), aside.string());
+		if (!write_header(path) || !remap()) return;
+	}
+	else if (const uint32_t version{ read_value<uint32_t>(mapped.data() + journal_magic.size()) }; version != journal_version) {
+		// Records of another version would be misread, and appending ours would mix the two
+		mapped.unmap();
+		std::filesystem::path aside{ path };
+		aside += ".v" + std::to_string(version);
+		std::filesystem::rename(path, aside, ec);
+		Logger::error(true, "{} is a version {} moderation journal, this build reads version {}. Moved it to {} and started a new one",
+			path.string(), version, journal_version, aside.string());
+		if (!write_header(path) || !remap()) return;
+	}
+
+	uint64_t offset{ header_size };
+	JournalEntry entry{};
+	while (offset < mapped.size()) {
+		const std::size_t record_size{ decode_record(mapped.data() + offset, mapped.size() - offset, entry) };
+		if (record_size == 0) break;
+		index(offset, entry);
+		offset += record_size;
+	}
+
+	// Whatever follows the last valid record is a torn append
+	if (offset < mapped.size()) {
+		Logger::warn(true, "Cut {} bytes of a torn or corrupt tail off the moderation journal", mapped.size() - offset);
+		mapped.unmap();
+		std::filesystem::resize_file(path, offset, ec);
+		remap();
+	}
+
+	end_offset = offset;
+	writer = std::fopen(path.string().c_str(), "ab");
+	if (!writer) Logger::error(true, "Couldn't open the moderation journal {} for appending", path.string());
+
+	Logger::info(true, "Moderation journal loaded, {} entries", all_records.size());
+}
+
+void ModJournal::index(const uint64_t offset, const JournalEntry& entry) {
+	all_records.push_back(offset);
+	by_guild[entry.guild_id].push_back(offset);
+	by_target[{ entry.guild_id, entry.target_id }].push_back(offset);
+	by_moderator[{ entry.guild_id, entry.moderator_id }].push_back(offset);
+}
+
+void ModJournal::clear_indexes() {
+	all_records.clear();
+	by_guild.clear();
+	by_target.clear();
+	by_moderator.clear();
+	end_offset = 0;
+}
+
+bool ModJournal::remap() {
+	return mapped.map(path);
+}
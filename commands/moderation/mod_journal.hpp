@@ -0,0 +1,130 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOD_JOURNAL_HPP
+#define MOD_JOURNAL_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <string>
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <utility>
+ * #include <filesystem>
+ * #include <shared_mutex>
+ * #include <chrono>
+ * #include <cstdio>
+ * #include <cstdint>
+ * #include <mapped_file/mapped_file.hpp>
+ * #include <utilities/other_utils/other_utils.hpp>
+ */
+
+#include <pch.hpp>
+
+// Entries older than this are dropped by `compact`
+constexpr std::chrono::seconds journal_retention{ std::chrono::hours{ 24 * 730 } };
+
+struct JournalEntry {
+	int64_t timestamp{ 0 }; // Unix seconds
+	uint64_t guild_id{ 0 };
+	uint64_t target_id{ 0 };
+	uint64_t moderator_id{ 0 };
+	CommandType command_type{ CommandType::Unknown };
+	std::string title{};
+	std::string reason{};
+};
+
+enum class JournalFilter : uint8_t {
+	Guild,
+	Target,
+	Moderator
+};
+
+struct JournalPage {
+	std::vector<JournalEntry> entries{}; // Newest first
+	std::size_t total{ 0 }; // Entries matching the filter, over all pages
+};
+
+/*
+ * @brief Append-only, checksummed log of moderation actions
+ *
+ * Records are appended to one file and read back through a memory mapping
+ * In-memory indexes by guild, by target and by moderator hold each record's offset, oldest first,
+ * so a page of history is a slice of one index
+ * On open, a torn or corrupt tail (ex. from a crash mid-append) is cut off at the last valid record
+ */
+class ModJournal {
+public:
+	ModJournal() = default;
+	ModJournal(const ModJournal&) = delete;
+	ModJournal& operator=(const ModJournal&) = delete;
+	~ModJournal();
+
+	// Opens or creates the journal, and rebuilds the indexes from it
+	void open(const std::filesystem::path& journal_path);
+	void close();
+
+	void append(const JournalEntry& entry);
+
+	/*
+	 * @brief Reads one page of a guild's history
+	 * @param filter_id The target or the moderator, ignored for `JournalFilter::Guild`
+	 * @param page Zero-based, counted from the newest entry
+	 */
+	JournalPage query(const uint64_t guild_id, const JournalFilter filter, const uint64_t filter_id, const std::size_t page, const std::size_t page_size);
+
+	/*
+	 * @brief Rewrites the journal without the entries older than `retention`
+	 * Only runs once they make up a tenth of the journal
+	 * @return The number of entries dropped
+	 */
+	std::size_t compact(const std::chrono::seconds retention);
+
+	std::size_t size() const;
+
+private:
+	struct PairHash {
+		std::size_t operator()(const std::pair<uint64_t, uint64_t>& key) const noexcept {
+			return static_cast<std::size_t>(key.first * 0x9E3779B97F4A7C15ull ^ key.second);
+		}
+	};
+
+	using Offsets = std::vector<uint64_t>;
+
+	mutable std::shared_mutex mtx;
+	std::filesystem::path path{};
+	std::FILE* writer{ nullptr };
+	MappedFile mapped{};
+	uint64_t end_offset{ 0 }; // Where the next record goes
+
+	Offsets all_records{};
+	std::unordered_map<uint64_t, Offsets> by_guild{};
+	std::unordered_map<std::pair<uint64_t, uint64_t>, Offsets, PairHash> by_target{};
+	std::unordered_map<std::pair<uint64_t, uint64_t>, Offsets, PairHash> by_moderator{};
+
+	// The following must be called with `mtx` held exclusively
+	void load();
+	void index(const uint64_t offset, const JournalEntry& entry);
+	void clear_indexes();
+	bool remap();
+};
+
+extern ModJournal mod_journal;
+
+#endif // MOD_JOURNAL_HPP
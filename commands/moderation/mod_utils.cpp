@@ -18,6 +18,11 @@
 /*
  * The following includes are performed:
  * #include <string>
+ * #include <vector>
+ * #include <span>
+ * #include <unordered_set>
+ * #include <mutex>
+ * #include <format>
  * #include <exception>
  * #include <variant>
  * #include <optional>
@@ -34,7 +39,14 @@
  * #include <dpp/guild.h>
  * #include <dpp/role.h>
  * #include <dpp/snowflake.h>
+ * #include <dpp/webhook.h>
  * #include <mod_utils.hpp>
+ * #include <moderation/permission_cache.hpp>
+ * #include <moderation/channel_permissions.hpp>
+ * #include <moderation/audit_batcher.hpp>
+ * #include <moderation/mod_journal.hpp>
+ * #include <utilities/rest_scheduler/rest_scheduler.hpp>
+ * #include <utilities/render/render.hpp>
  * #include <Ishmael.hpp>
  * #include <utilities/logger/logger.hpp>
  * #include <utilities/other_utils/other_utils.hpp>
@@ -43,38 +55,61 @@
 #include <pch.hpp>
 
 dpp::permission calculate_permissions(const dpp::guild_member& member) {
-	// Find the guild from cache
-	const dpp::guild* g{ dpp::find_guild(member.guild_id) };
-
-	// If guild isn't cached, we can't get @everyone role
-	// We have to fallback to this logic, even thought it may be inaccurate
-	if (!g) {
-		dpp::permission perms{};
-		for (const dpp::snowflake role_id : member.get_roles()) {
-			const dpp::role* r{ dpp::find_role(role_id) };
-			if (r) perms |= r->permissions;
-		}
-		return perms;
-	}
+	return permission_cache.get(member).permissions;
+}
 
-	// If the guild is cached, we start with the @everyone role's perms
-	const dpp::role* everyone_role{ dpp::find_role(g->id) };
-	// If the @everyone role is found, we start from its perms, else we start with 0
-	dpp::permission perms{ everyone_role ? everyone_role->permissions : dpp::permission{ 0 } };
+uint16_t get_highest_role_position(const dpp::guild_member& member) {
+	return permission_cache.get(member).highest_role.position;
+}
 
-	// Now we OR all other roles the member has, as
-	// member.get_roles() does not include the @everyone role.
-	for (const dpp::snowflake role_id : member.get_roles()) if (const dpp::role * r{ dpp::find_role(role_id) }) perms |= r->permissions;
-	return perms;
+// Whether `member`'s highest role is above `role`
+static bool outranks_role(const dpp::guild_member& member, const dpp::role& role) {
+	switch (permission_cache.can_manage_role(member, role.id)) {
+		case HierarchyCheck::Allowed: return true;
+		case HierarchyCheck::Denied: return false;
+		case HierarchyCheck::Unknown: break;
+	}
+
+	// The cache doesn't have the role yet (ex. its create event is still queued), the caller's copy has its position
+	if (member.is_guild_owner()) return true;
+	return RoleRank{ .position = role.position, .id = role.id } < permission_cache.get(member).highest_role;
 }
 
-uint16_t get_highest_role_position(const dpp::guild_member& member) {
-	uint16_t highest_pos{ 0 };
-	for (const auto& role_id : member.get_roles()) {
-		const dpp::role* r{ dpp::find_role(role_id) };
-		if (r && r->position > highest_pos) highest_pos = r->position;
+std::optional<std::string> check_role_assignment(dpp::cluster& bot, const dpp::guild& g, const dpp::role& role, const dpp::guild_member& issuer_member) {
+	const dpp::permission issuer_perms{ calculate_permissions(issuer_member) };
+
+	if (!(issuer_member.is_guild_owner() || issuer_perms & dpp::p_administrator || issuer_perms & dpp::p_moderate_members))
+		return "You don't have permission to use this command.";
+
+	if (role.is_managed()) return "Error: This role is managed by an integration and cannot be assigned manually.";
+
+	if (role.has_administrator()) return "For security reasons, roles with `Administrator` permission can't be assigned with this command.";
+
+	if (role.id == g.id) return "Error: Everyone inherently possesses the `@everyone` role. It can't be added.";
+
+	const dpp::guild_member bot_member{ dpp::find_guild_member(g.id, bot.me.id) };
+	const dpp::permission bot_perms{ calculate_permissions(bot_member) };
+
+	// Check whether the bot has all the permissions of the role to be assigned
+	if (!(bot_perms & dpp::p_administrator)) {
+		// Bot is not admin, so check if it has all perms of the role
+		if ((bot_perms & role.permissions) != role.permissions) return "I can't assign this role as I lack some of its permissions.";
 	}
-	return highest_pos;
+
+	// Check the bot's role heirarchy
+	if (!outranks_role(bot_member, role)) return "I can't assign this role as it is higher than or equal to my own highest role.";
+
+	// The server owner bypasses role heirarchy and permission checks
+	if (!issuer_member.is_guild_owner()) {
+		// User's highest role must be higher than the role to be added
+		if (!outranks_role(issuer_member, role)) return "You can't assign a role that is higher than or equal to your own highest role.";
+
+		if (!(issuer_perms & dpp::p_administrator)) {
+			if ((issuer_perms & role.permissions) != role.permissions) return "You can't assign a role that has permissions you don't possess.";
+		}
+	}
+
+	return std::nullopt;
 }
 
 std::string get_reason_from_event(const dpp::slashcommand_t& event) {
@@ -83,23 +118,142 @@ std::string get_reason_from_event(const dpp::slashcommand_t& event) {
 	return "No reason provided.";
 }
 
+std::vector<uint64_t> parse_user_ids(const std::string& users) {
+	std::vector<uint64_t> ids{};
+	std::unordered_set<uint64_t> seen{};
+
+	std::size_t i{ 0 };
+	while (i < users.size()) {
+		if (users[i] < '0' || users[i] > '9') {
+			++i;
+			continue;
+		}
+
+		std::size_t end{ i };
+		while (end < users.size() && users[end] >= '0' && users[end] <= '9') ++end;
+
+		// Snowflakes are 17 to 20 digits long
+		if (end - i >= 17 && end - i <= 20) {
+			try {
+				const uint64_t id{ std::stoull(users.substr(i, end - i)) };
+				if (seen.insert(id).second) ids.push_back(id);
+			}
+			catch (const std::out_of_range&) {}
+		}
+		i = end;
+	}
+
+	return ids;
+}
+
+// Log channels a webhook is being created in, so commands running at once don't create one each
+static std::mutex creating_webhooks_mutex;
+static std::unordered_set<uint64_t> creating_webhooks{};
+
+void ensure_log_webhook(dpp::cluster& bot, const uint64_t guild_id, const uint64_t channel_id) {
+	if (get_log_webhook(guild_id, channel_id).has_value()) return;
+	{
+		std::scoped_lock lock{ creating_webhooks_mutex };
+		if (!creating_webhooks.insert(channel_id).second) return;
+	}
+
+	// A webhook from before a restart has no token anymore. It's deleted rather than fetched,
+	// so a token an older build wrote to disk stops working
+	if (const auto stale_id{ get_log_webhook_id(guild_id, channel_id) }) {
+		rest_scheduler.submit(RestLane::Background, rest_route("webhook", *stale_id),
+			[&bot, webhook_id = *stale_id](dpp::command_completion_event_t callback) { bot.delete_webhook(webhook_id, std::move(callback)); },
+			[channel_id, webhook_id = *stale_id](const dpp::confirmation_callback_t& deleted) {
+				if (deleted.is_error() && deleted.http_info.status != 404) {
+					Logger::warn(false, "Couldn't delete the old audit log webhook {} in channel {}: {}", webhook_id, channel_id, deleted.get_error().message);
+				}
+			});
+		// Forgotten right away, so a create that fails below isn't retried by every audit log sent to the channel
+		forget_log_webhook(guild_id, channel_id);
+	}
+
+	dpp::webhook webhook{};
+	webhook.guild_id = guild_id;
+	webhook.channel_id = channel_id;
+	webhook.name = "Ishmael Audit Log";
+
+	rest_scheduler.submit(RestLane::Background, rest_route("channel_webhooks", channel_id),
+		[&bot, webhook = std::move(webhook)](dpp::command_completion_event_t callback) { bot.create_webhook(webhook, std::move(callback)); },
+		[guild_id, channel_id](const dpp::confirmation_callback_t& created) {
+			if (created.is_error()) Logger::warn(false, "Couldn't create an audit log webhook in channel {}, bot messages are used instead: {}", channel_id, created.get_error().message);
+			else {
+				const dpp::webhook webhook{ created.get<dpp::webhook>() };
+				save_log_webhook(guild_id, channel_id, LogWebhook{ .id = webhook.id, .token = webhook.token });
+				Logger::info(false, "Audit logs of channel {} now go through webhook {}", channel_id, static_cast<uint64_t>(webhook.id));
+			}
+
+			std::scoped_lock lock{ creating_webhooks_mutex };
+			creating_webhooks.erase(channel_id);
+		});
+}
+
+void send_audit_embed(dpp::cluster& bot, const uint64_t guild_id, const CommandType command_type, const dpp::embed& log_embed) {
+	const auto log_channel_id_opt{ get_log_channel(guild_id, command_type) };
+
+	if (!log_channel_id_opt.has_value()) return;
+
+	const dpp::snowflake log_channel_id{ log_channel_id_opt.value() };
+
+	// Check up front that the bot can post there, rather than finding out from a 403
+	constexpr uint64_t required_permissions{ dpp::p_view_channel | dpp::p_send_messages | dpp::p_embed_links };
+	bool can_post{ true };
+	try {
+		can_post = channel_permissions.has(dpp::find_guild_member(guild_id, bot.me.id), log_channel_id, required_permissions);
+	}
+	catch (const dpp::cache_exception&) {} // The bot's member isn't cached, the REST call will tell
+
+	if (!can_post) {
+		Logger::warn(false, "Skipped an audit log, the bot can't post embeds in channel {} of guild {}", static_cast<uint64_t>(log_channel_id), guild_id);
+		return;
+	}
+
+	// A webhook from before a restart has no token, it's replaced so the channel doesn't stay on bot messages
+	// Until the new one exists, this embed and the ones after it go out as bot messages
+	if (!get_log_webhook(guild_id, log_channel_id).has_value() && get_log_webhook_id(guild_id, log_channel_id).has_value())
+		ensure_log_webhook(bot, guild_id, log_channel_id);
+
+	// Packed with the channel's other recent embeds, up to 10 per message
+	audit_batcher.enqueue(guild_id, log_channel_id, log_embed);
+}
+
+// The fields and footer every audit log embed ends with
+static void add_audit_details(dpp::embed& log_embed, const dpp::slashcommand_t& event, const AuditLogTarget& target_obj, const std::string& reason) {
+	// We visit the target_obj variant and the lambda handles the type
+	std::visit([&log_embed](auto&& arg) {
+		// gett the type of the object inside the variant
+		using T = std::decay_t<decltype(arg)>;
+		if constexpr (std::is_same_v<T, const dpp::role*>) log_embed.add_field("Role", arg->get_mention(), false);
+		else if constexpr (std::is_same_v<T, BulkOutcome>) {
+			log_embed.add_field("Succeeded", std::to_string(arg.succeeded), true)
+				.add_field("Failed", std::to_string(arg.failed), true)
+				.add_field("Skipped", std::to_string(arg.skipped), true);
+			if (arg.per_second > 0.0) log_embed.add_field("Throughput", std::format("{:.1f}/s", arg.per_second), true);
+		}
+		else if constexpr (std::is_same_v<T, std::monostate>) {} // It's monostate, we add no field
+		}, target_obj);
+
+	// Now we add other fields
+	log_embed.add_field("Reason", reason, false)
+		.set_footer(dpp::embed_footer()
+			.set_text(event.command.get_issuing_user().username)
+			.set_icon(event.command.get_issuing_user().get_avatar_url()))
+		.set_timestamp(time(0));
+}
+
 void send_audit_log(dpp::cluster& bot, const dpp::slashcommand_t& event, CommandType command_type, uint64_t colour,
 	const std::string& title, const dpp::guild_member& target_user, const dpp::guild_member& issuer_member,
 	AuditLogTarget target_obj, const std::string& reason) {
 	try {
-		const auto log_channel_id_opt{ get_log_channel(event.command.guild_id, command_type) };
+		// The journal keeps the history whether or not the guild logs this action anywhere
+		mod_journal.append(JournalEntry{ .timestamp = static_cast<int64_t>(time(0)), .guild_id = event.command.guild_id,
+			.target_id = target_user.user_id, .moderator_id = issuer_member.user_id, .command_type = command_type, .title = title, .reason = reason });
 
-		if (!log_channel_id_opt.has_value()) return;
-
-		const dpp::snowflake log_channel_id{ log_channel_id_opt.value() };
-
-		const std::string event_type{ [command_type]() -> std::string {
-			switch (command_type) {
-			case CommandType::RoleEdit: return "Role";
-			case CommandType::BanEdit: return "Ban";
-			default: return "Unknown";
-			}
-		}() };
+		// Nothing to build if the guild has no log channel for this
+		if (!get_log_channel(event.command.guild_id, command_type).has_value()) return;
 
 		const std::string thumbnail_url{ [&target_user]() -> std::string {
 			const std::string guild_avatar_url{ target_user.get_avatar_url(128, dpp::i_png, true) };
@@ -122,22 +276,62 @@ void send_audit_log(dpp::cluster& bot, const dpp::slashcommand_t& event, Command
 			.add_field("Target User", target_user.get_mention(), true)
 			.add_field("Moderator", issuer_member.get_mention(), true) };
 
-		// We visit the target_obj variant and the lambda handles the type
-		std::visit([&log_embed](auto&& arg) {
-			// gett the type of the object inside the variant
-			using T = std::decay_t<decltype(arg)>;
-			if constexpr (std::is_same_v<T, const dpp::role*>) log_embed.add_field("Role", arg->get_mention(), false);
-			else if constexpr (std::is_same_v<T, std::monostate>) {} // It's monostate, we add no field
-			}, target_obj);
-
-		// Now we add other fields
-		log_embed.add_field("Reason", reason, false)
-			.set_footer(dpp::embed_footer()
-				.set_text(event.command.get_issuing_user().username)
-				.set_icon(event.command.get_issuing_user().get_avatar_url()))
-			.set_timestamp(time(0));
-
-		bot.message_create(dpp::message(log_channel_id, log_embed));
+		add_audit_details(log_embed, event, target_obj, reason);
+
+		send_audit_embed(bot, event.command.guild_id, command_type, log_embed);
+	}
+	catch (const dpp::exception& e) {
+		Logger::exception(false, "D++ exception thrown while trying to send audit log embed: {}", std::string{ e.what() });
+	}
+	catch (const std::exception& e) {
+		Logger::exception(false, "Standard exception thrown while trying to send audit log embed: {}", std::string{ e.what() });
+	}
+	catch (...) {
+		Logger::exception(false, "Unknown exception thrown while trying to send audit log embed");
+	}
+}
+
+void send_audit_log(dpp::cluster& bot, const dpp::slashcommand_t& event, CommandType command_type, uint64_t colour,
+	const std::string& title, std::span<const dpp::snowflake> target_ids, const dpp::guild_member& issuer_member,
+	AuditLogTarget target_obj, const std::string& reason) {
+	try {
+		const int64_t now{ static_cast<int64_t>(time(0)) };
+		for (const dpp::snowflake target_id : target_ids) {
+			mod_journal.append(JournalEntry{ .timestamp = now, .guild_id = event.command.guild_id,
+				.target_id = target_id, .moderator_id = issuer_member.user_id, .command_type = command_type, .title = title, .reason = reason });
+		}
+
+		if (!get_log_channel(event.command.guild_id, command_type).has_value()) return;
+
+		constexpr render::Template<1> mention{ "<@{}> " };
+		constexpr render::Template<1> more{ "and {} more" };
+		constexpr render::Template<1> target_users{ "Target Users ({})" };
+
+		// The list is built in the arena, embed field values are capped at 1024 characters
+		render::Arena arena{};
+		std::pmr::string mentions{ arena.string() };
+		std::size_t listed{ 0 };
+		for (const dpp::snowflake target_id : target_ids) {
+			const std::size_t before{ mentions.size() };
+			mention.append_to(mentions, target_id);
+			if (mentions.size() > 1000) {
+				mentions.resize(before);
+				break;
+			}
+			++listed;
+		}
+		if (listed < target_ids.size()) more.append_to(mentions, target_ids.size() - listed);
+		if (mentions.empty()) mentions = "None";
+
+		dpp::embed log_embed{ dpp::embed()
+			.set_color(colour)
+			.set_title(title)
+			.add_field(target_users(target_ids.size()), render::to_string(mentions), false)
+			.add_field("Moderator", issuer_member.get_mention(), true) };
+
+		add_audit_details(log_embed, event, target_obj, reason);
+
+		send_audit_embed(bot, event.command.guild_id, command_type, log_embed);
 	}
 	catch (const dpp::exception& e) {
 		Logger::exception(false, "D++ exception thrown while trying to send audit log embed: {}", std::string{ e.what() });
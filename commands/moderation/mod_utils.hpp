@@ -23,8 +23,19 @@
 /*
  * The following includes are performed:
  * #include <string>
+ * #include <vector>
+ * #include <span>
+ * #include <optional>
  * #include <variant>
+ * #include <type_traits>
+ * #include <unordered_map>
+ * #include <functional>
+ * #include <memory>
+ * #include <mutex>
+ * #include <chrono>
+ * #include <stdexcept>
  * #include <cstdint>
+ * #include <dpp/coro.h>
  * #include <dpp/cluster.h>
  * #include <dpp/dispatcher.h>
  * #include <dpp/guild.h>
@@ -36,14 +47,162 @@
 #include <pch.hpp>
 
 // Utility functions
+// Both are answered by `permission_cache`
 dpp::permission calculate_permissions(const dpp::guild_member& member);
 uint16_t get_highest_role_position(const dpp::guild_member& member);
 std::string get_reason_from_event(const dpp::slashcommand_t& event);
 
+// Picks the user IDs out of a list of IDs and mentions, in order and without duplicates
+std::vector<uint64_t> parse_user_ids(const std::string& users);
+
+/*
+ * @brief The checks a moderator and the bot must pass before a role is assigned
+ * Covers the issuer's permissions, the role itself (managed, administrator, @everyone) and both role hierarchies
+ * @return The message to reply with if the role can't be assigned
+ */
+std::optional<std::string> check_role_assignment(dpp::cluster& bot, const dpp::guild& g, const dpp::role& role, const dpp::guild_member& issuer_member);
+
+// Older D++ releases pass event payloads (ex. `guild_role_update_t::updated`) by pointer, newer ones by value
+// Either way, this returns a pointer to the payload, null if D++ had none
+template <typename T>
+const auto* event_object(const T& field) {
+	if constexpr (std::is_pointer_v<T>) return static_cast<const std::remove_pointer_t<T>*>(field);
+	else return &field;
+}
+
+// Add the other actions as their commands start coalescing
+enum class ModerationAction : uint8_t {
+	RoleAdd
+};
+
+// Identifies a moderation request: who it's on, what it does and to what (ex. the role being added)
+struct ModerationKey {
+	uint64_t guild_id{ 0 };
+	uint64_t target_id{ 0 };
+	ModerationAction action{ ModerationAction::RoleAdd };
+	uint64_t object_id{ 0 };
+
+	bool operator==(const ModerationKey&) const = default;
+};
+
+struct ModerationKeyHash {
+	std::size_t operator()(const ModerationKey& key) const noexcept {
+		uint64_t h{ key.guild_id * 0x9E3779B97F4A7C15ull };
+		h ^= key.target_id + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+		h ^= key.object_id + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+		h ^= static_cast<uint64_t>(key.action) + (h << 6) + (h >> 2);
+		return static_cast<std::size_t>(h);
+	}
+};
+
+/*
+ * @brief Coalesces identical moderation requests that overlap in time
+ *
+ * The first request for a key runs the operation, the ones arriving while it runs wait for it
+ * and get the same result, rather than repeating its REST calls and audit log
+ * A result is also handed to identical requests arriving within `remember_for` after it, ex. a second click
+ * If the operation throws, the waiting requests throw too, and nothing is remembered
+ */
+template <typename Result>
+class SingleFlight {
+public:
+	using clock = std::chrono::steady_clock;
+
+	explicit SingleFlight(const clock::duration remember_for = clock::duration::zero()) : remember_for{ remember_for } {}
+
+	template <typename Operation>
+	dpp::task<Result> run(const ModerationKey key, Operation operation) {
+		std::optional<dpp::async<std::shared_ptr<const Result>>> shared{};
+		std::shared_ptr<const Result> remembered{};
+		{
+			std::scoped_lock lock{ mtx };
+			// Expired entries are swept by `complete`
+			if (const auto finished{ recent.find(key) }; finished != recent.end() && clock::now() - finished->second.finished_at < remember_for)
+				remembered = finished->second.result;
+			else if (auto it{ in_flight.find(key) }; it != in_flight.end()) {
+				// Registered under the lock, so the running operation can't finish in between
+				shared.emplace([&it](auto&& callback) { it->second.emplace_back(std::forward<decltype(callback)>(callback)); });
+			}
+			else in_flight.try_emplace(key);
+		}
+
+		if (remembered) co_return *remembered;
+
+		if (shared.has_value()) {
+			const std::shared_ptr<const Result> result{ co_await std::move(shared.value()) };
+			if (!result) throw std::runtime_error("The request this one was coalesced into failed");
+			co_return *result;
+		}
+
+		std::shared_ptr<const Result> result{};
+		try {
+			result = std::make_shared<const Result>(co_await operation());
+		}
+		catch (...) {
+			complete(key, nullptr);
+			throw;
+		}
+		complete(key, result);
+		co_return *result;
+	}
+
+private:
+	using Waiter = std::function<void(std::shared_ptr<const Result>)>;
+
+	struct Finished {
+		std::shared_ptr<const Result> result;
+		clock::time_point finished_at;
+	};
+
+	const clock::duration remember_for;
+
+	std::mutex mtx;
+	std::unordered_map<ModerationKey, std::vector<Waiter>, ModerationKeyHash> in_flight;
+	std::unordered_map<ModerationKey, Finished, ModerationKeyHash> recent;
+
+	void complete(const ModerationKey& key, const std::shared_ptr<const Result>& result) {
+		std::vector<Waiter> waiters{};
+		{
+			std::scoped_lock lock{ mtx };
+			auto node{ in_flight.extract(key) };
+			if (!node.empty()) waiters = std::move(node.mapped());
+
+			if (result && remember_for > clock::duration::zero()) {
+				// Swept here, so results nobody asks for again don't pile up
+				const clock::time_point now{ clock::now() };
+				std::erase_if(recent, [this, now](const auto& entry) { return now - entry.second.finished_at >= remember_for; });
+				recent.insert_or_assign(key, Finished{ .result = result, .finished_at = now });
+			}
+		}
+		for (Waiter& waiter : waiters) waiter(result);
+	}
+};
+
 // For the audit log embeds
-using AuditLogTarget = std::variant<std::monostate, const dpp::role*>; // TODO: Add other datatypes here
+// Creates the webhook audit logs of `channel_id` are delivered through, unless it has one with a known token
+// Tokens aren't stored, so a webhook from before a restart is deleted and replaced, by `send_audit_embed` when the channel is next logged to
+// Without the `Manage Webhooks` permission, the channel keeps getting bot messages
+void ensure_log_webhook(dpp::cluster& bot, const uint64_t guild_id, const uint64_t channel_id);
+
+// Posts a ready-made embed to the guild's log channel of `command_type`, if it has one the bot can post in
+void send_audit_embed(dpp::cluster& bot, const uint64_t guild_id, const CommandType command_type, const dpp::embed& log_embed);
+
+// The outcome of an action on many members at once
+struct BulkOutcome {
+	uint64_t succeeded{ 0 };
+	uint64_t failed{ 0 };
+	uint64_t skipped{ 0 };
+	double per_second{ 0.0 };
+};
+
+using AuditLogTarget = std::variant<std::monostate, const dpp::role*, BulkOutcome>; // TODO: Add other datatypes here
 void send_audit_log(dpp::cluster& bot, const dpp::slashcommand_t& event, const CommandType command_type, const uint64_t colour,
 	const std::string& title, const dpp::guild_member& target_user, const dpp::guild_member& issuer_member,
 	const AuditLogTarget target_obj, const std::string& reason);
 
+// One entry for many targets, mentioned for as long as they fit in the embed field
+void send_audit_log(dpp::cluster& bot, const dpp::slashcommand_t& event, const CommandType command_type, const uint64_t colour,
+	const std::string& title, std::span<const dpp::snowflake> target_ids, const dpp::guild_member& issuer_member,
+	const AuditLogTarget target_obj, const std::string& reason);
+
 #endif // MOD_UTILS_HPP
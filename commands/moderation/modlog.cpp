@@ -0,0 +1,142 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <string>
+ * #include <string_view>
+ * #include <memory_resource>
+ * #include <vector>
+ * #include <format>
+ * #include <chrono>
+ * #include <algorithm>
+ * #include <exception>
+ * #include <variant>
+ * #include <cstdint>
+ * #include <dpp/appcommand.h>
+ * #include <dpp/cluster.h>
+ * #include <dpp/message.h>
+ * #include <dpp/dispatcher.h>
+ * #include <dpp/permissions.h>
+ * #include <dpp/exception.h>
+ * #include <dpp/snowflake.h>
+ * #include <commands/command_table.hpp>
+ * #include <commands/moderation/mod_utils.hpp>
+ * #include <commands/moderation/mod_journal.hpp>
+ * #include <utilities/other_utils/other_utils.hpp>
+ * #include <commands/ICommands.hpp>
+ * #include <utilities/render/render.hpp>
+ * #include <utilities/logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+static constexpr std::size_t modlog_page_size{ 10 };
+
+static constexpr render::Template<5> history_line{ "<t:{}:f> **{}** <@{}> by <@{}>\n> {}" };
+
+static void handle_modlog(dpp::cluster& bot, const dpp::slashcommand_t& event) {
+	try {
+		const dpp::guild_member& issuer_member{ event.command.member };
+		const dpp::permission issuer_perms{ calculate_permissions(issuer_member) };
+		if (!(issuer_member.is_guild_owner() || issuer_perms & dpp::p_administrator || issuer_perms & dpp::p_moderate_members)) {
+			event.reply(dpp::message{ "You don't have permission to use this command." }.set_flags(dpp::m_ephemeral));
+			return;
+		}
+
+		const auto user_param{ event.get_parameter("user") };
+		const auto moderator_param{ event.get_parameter("moderator") };
+		const auto page_param{ event.get_parameter("page") };
+
+		if (std::holds_alternative<dpp::snowflake>(user_param) && std::holds_alternative<dpp::snowflake>(moderator_param)) {
+			event.reply(dpp::message{ "Error: Filter by `user` or by `moderator`, not both." }.set_flags(dpp::m_ephemeral));
+			return;
+		}
+
+		JournalFilter filter{ JournalFilter::Guild };
+		uint64_t filter_id{ 0 };
+		if (std::holds_alternative<dpp::snowflake>(user_param)) {
+			filter = JournalFilter::Target;
+			filter_id = std::get<dpp::snowflake>(user_param);
+		}
+		else if (std::holds_alternative<dpp::snowflake>(moderator_param)) {
+			filter = JournalFilter::Moderator;
+			filter_id = std::get<dpp::snowflake>(moderator_param);
+		}
+
+		const std::size_t page{ std::holds_alternative<int64_t>(page_param) ? static_cast<std::size_t>(std::max<int64_t>(std::get<int64_t>(page_param), 1)) : 1 };
+
+		// Served from the journal's indexes and its memory mapping, no REST call involved
+		const auto started{ std::chrono::steady_clock::now() };
+		const JournalPage history{ mod_journal.query(event.command.guild_id, filter, filter_id, page - 1, modlog_page_size) };
+		const auto took{ std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started) };
+
+		const std::size_t page_count{ std::max<std::size_t>((history.total + modlog_page_size - 1) / modlog_page_size, 1) };
+		if (history.entries.empty()) {
+			event.reply(dpp::message{ history.total == 0 ? "No moderation history found." : std::format("There are only {} pages.", page_count) }.set_flags(dpp::m_ephemeral));
+			return;
+		}
+
+		render::ReplyMeter meter{ "modlog" };
+		render::Arena arena{};
+
+		std::pmr::string lines{ arena.string() };
+		for (const JournalEntry& entry : history.entries) {
+			const std::string_view reason{ entry.reason };
+			const std::string_view shown{ utf8_prefix(reason, 117) };
+			history_line.append_to(lines, entry.timestamp, entry.title, entry.target_id, entry.moderator_id, shown);
+			lines += shown.size() < reason.size() ? "...\n" : "\n";
+		}
+
+		const std::string subject{ filter == JournalFilter::Target ? std::format(" of <@{}>", filter_id)
+			: filter == JournalFilter::Moderator ? std::format(" by <@{}>", filter_id) : std::string{} };
+
+		dpp::embed embed{ dpp::embed()
+			.set_colour(10298559) // Hex: #9D24BF
+			.set_title("Moderation History")
+			.set_description(std::format("History{}\n\n{}", subject, std::string_view{ lines }))
+			.set_footer(dpp::embed_footer().set_text(std::format("Page {} / {} | {} entries | {} µs", page, page_count, history.total, took.count()))) };
+
+		event.reply(dpp::message{}.add_embed(embed).set_flags(dpp::m_ephemeral));
+	}
+	catch (const dpp::exception& e) {
+		Logger::exception(false, "D++ exception thrown in `/modlog`: {}", std::string(e.what()));
+		event.reply(render::exception_reply());
+	}
+	catch (const std::exception& e) {
+		Logger::exception(false, "Standard exception thrown in `/modlog`: {}", std::string(e.what()));
+		event.reply(render::exception_reply());
+	}
+	catch (...) {
+		Logger::exception(false, "Unknown exception thrown in `/modlog`");
+		event.reply(render::exception_reply());
+	}
+}
+
+void register_modlog_command() {
+	commands[command_table::index_of("modlog")] = {
+		.function = handle_modlog,
+		.description = "Shows the moderation history of this server, a user or a moderator.",
+		.permissions = dpp::p_moderate_members, // Base permission
+		.is_restricted_to_owners = false, // Not restricted to dev guild
+		.options = {
+			dpp::command_option(dpp::co_user, "user", "Only the actions taken on this user", false),
+			dpp::command_option(dpp::co_user, "moderator", "Only the actions taken by this moderator", false),
+			dpp::command_option(dpp::co_integer, "page", "The page to show, newest first (defaults to 1)", false).set_min_value(1)
+		}
+	};
+}
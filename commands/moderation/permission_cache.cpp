@@ -0,0 +1,461 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <span>
+ * #include <optional>
+ * #include <limits>
+ * #include <shared_mutex>
+ * #include <mutex>
+ * #include <algorithm>
+ * #include <cstdint>
+ * #include <dpp/cache.h>
+ * #include <dpp/cluster.h>
+ * #include <dpp/dispatcher.h>
+ * #include <dpp/guild.h>
+ * #include <dpp/permissions.h>
+ * #include <dpp/role.h>
+ * #include <moderation/permission_cache.hpp>
+ * #include <moderation/mod_utils.hpp>
+ * #include <moderation/bulk_permissions.hpp>
+ */
+
+#include <pch.hpp>
+
+PermissionCache permission_cache;
+
+// Order independent, Discord doesn't guarantee the order of a member's roles
+uint64_t roles_fingerprint(const std::vector<dpp::snowflake>& roles) {
+	uint64_t fingerprint{ roles.size() };
+	for (const dpp::snowflake role_id : roles) {
+		// splitmix64 finalizer, so nearby snowflakes don't cancel out
+		uint64_t x{ static_cast<uint64_t>(role_id) + 0x9E3779B97F4A7C15ull };
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		fingerprint += x ^ (x >> 31);
+	}
+	return fingerprint;
+}
+
+static std::vector<uint64_t> to_role_ids(const std::vector<dpp::snowflake>& roles) {
+	std::vector<uint64_t> ids{};
+	ids.reserve(roles.size());
+	for (const dpp::snowflake role_id : roles) ids.push_back(role_id);
+	return ids;
+}
+
+// Lowest first, see `RoleRank`
+static bool rank_less(const RoleIndex::Role& a, const RoleIndex::Role& b) {
+	return RoleRank{ .position = a.position, .id = a.id } < RoleRank{ .position = b.position, .id = b.id };
+}
+
+void RoleIndex::assign(std::vector<Role> roles) {
+	// A role listed twice keeps its last copy
+	std::stable_sort(roles.begin(), roles.end(), [](const Role& a, const Role& b) { return a.id < b.id; });
+	const auto last_copies{ std::unique(roles.rbegin(), roles.rend(), [](const Role& a, const Role& b) { return a.id == b.id; }) };
+	roles.erase(roles.begin(), last_copies.base());
+	std::sort(roles.begin(), roles.end(), rank_less);
+
+	ids.clear();
+	permissions.clear();
+	positions.clear();
+	ids.reserve(roles.size());
+	permissions.reserve(roles.size());
+	positions.reserve(roles.size());
+
+	for (const Role& role : roles) {
+		ids.push_back(role.id);
+		permissions.push_back(role.permissions);
+		positions.push_back(role.position);
+	}
+	reindex();
+}
+
+void RoleIndex::upsert(const Role role) {
+	if (const auto i{ find(role.id) }) {
+		// Only a move in the hierarchy changes the slots
+		permissions[i.value()] = role.permissions;
+		if (positions[i.value()] == role.position) return;
+		erase(role.id);
+	}
+
+	const RoleRank rank{ .position = role.position, .id = role.id };
+	std::size_t i{ 0 };
+	while (i < ids.size() && rank_at(i) < rank) ++i;
+
+	ids.insert(ids.begin() + i, role.id);
+	permissions.insert(permissions.begin() + i, role.permissions);
+	positions.insert(positions.begin() + i, role.position);
+	reindex();
+}
+
+void RoleIndex::erase(const uint64_t role_id) {
+	const std::optional<std::size_t> i{ find(role_id) };
+	if (!i.has_value()) return;
+
+	ids.erase(ids.begin() + i.value());
+	permissions.erase(permissions.begin() + i.value());
+	positions.erase(positions.begin() + i.value());
+	reindex();
+}
+
+std::optional<std::size_t> RoleIndex::find(const uint64_t role_id) const {
+	const auto it{ std::lower_bound(by_id.begin(), by_id.end(), role_id, [this](const uint32_t slot, const uint64_t id) { return ids[slot] < id; }) };
+	if (it == by_id.end() || ids[*it] != role_id) return std::nullopt;
+	return static_cast<std::size_t>(*it);
+}
+
+void RoleIndex::reindex() {
+	// A guild has at most 250 roles, and roles change far less often than they are looked up
+	by_id.resize(ids.size());
+	for (std::size_t i{ 0 }; i < by_id.size(); ++i) by_id[i] = static_cast<uint32_t>(i);
+	std::sort(by_id.begin(), by_id.end(), [this](const uint32_t a, const uint32_t b) { return ids[a] < ids[b]; });
+}
+
+MemberPermissions PermissionCache::resolve(const GuildEntry& guild, const uint64_t guild_id, const std::vector<uint64_t>& roles) {
+	MemberPermissions resolved{};
+	uint64_t permissions{ 0 };
+
+	// A member's role list does not include the @everyone role
+	if (const auto everyone{ guild.roles.find(guild_id) }) permissions = guild.roles.permissions_at(everyone.value());
+
+	for (const uint64_t role_id : roles) {
+		const auto i{ guild.roles.find(role_id) };
+		if (!i.has_value()) continue;
+		permissions |= guild.roles.permissions_at(i.value());
+		resolved.highest_role = std::max(resolved.highest_role, guild.roles.rank_at(i.value()));
+	}
+	resolved.permissions = dpp::permission{ permissions };
+	return resolved;
+}
+
+HierarchyCheck PermissionCache::compare(const GuildEntry& guild, const uint64_t actor_id, const RoleRank actor_rank, const uint64_t target_id) {
+	if (target_id == guild.owner_id) return HierarchyCheck::Denied;
+	if (actor_id == guild.owner_id) return HierarchyCheck::Allowed;
+
+	const auto target{ guild.members.find(target_id) };
+	if (target == guild.members.end()) return HierarchyCheck::Unknown;
+	return target->second.resolved.highest_role < actor_rank ? HierarchyCheck::Allowed : HierarchyCheck::Denied;
+}
+
+PermissionCache::GuildEntry PermissionCache::load_guild(const dpp::guild& g) {
+	GuildEntry guild{ .owner_id = g.owner_id, .roles = {}, .members = {} };
+
+	// The only place that goes through D++'s cache, once per guild
+	std::vector<RoleIndex::Role> roles{};
+	roles.reserve(g.roles.size());
+	for (const dpp::snowflake role_id : g.roles)
+		if (const dpp::role* r{ dpp::find_role(role_id) }) roles.push_back(RoleIndex::Role{ .id = role_id, .permissions = r->permissions, .position = r->position });
+	guild.roles.assign(std::move(roles));
+
+	guild.members.reserve(g.members.size());
+	for (const auto& [user_id, member] : g.members) {
+		MemberEntry entry{ .fingerprint = roles_fingerprint(member.get_roles()), .roles = to_role_ids(member.get_roles()), .resolved = {} };
+		entry.resolved = resolve(guild, g.id, entry.roles);
+		guild.members.emplace(user_id, std::move(entry));
+	}
+	return guild;
+}
+
+MemberPermissions PermissionCache::get(const dpp::guild_member& member) {
+	const uint64_t guild_id{ member.guild_id };
+	const uint64_t fingerprint{ roles_fingerprint(member.get_roles()) };
+	Stripe& stripe{ stripe_of(guild_id) };
+
+	{
+		std::shared_lock lock{ stripe.mtx };
+		if (const auto guild{ stripe.guilds.find(guild_id) }; guild != stripe.guilds.end()) {
+			const auto entry{ guild->second.members.find(member.user_id) };
+			if (entry != guild->second.members.end() && entry->second.fingerprint == fingerprint) {
+				hits.fetch_add(1, std::memory_order_relaxed);
+				return entry->second.resolved;
+			}
+		}
+	}
+
+	misses.fetch_add(1, std::memory_order_relaxed);
+
+	// First lookup in a guild whose create event came before the cache was attached
+	bool has_guild{ false };
+	{
+		std::shared_lock lock{ stripe.mtx };
+		has_guild = stripe.guilds.contains(guild_id);
+	}
+	if (!has_guild) {
+		const dpp::guild* g{ dpp::find_guild(guild_id) };
+		if (!g || !load_on_demand(*g)) return resolve_uncached(member);
+	}
+
+	MemberEntry entry{ .fingerprint = fingerprint, .roles = to_role_ids(member.get_roles()), .resolved = {} };
+
+	std::unique_lock lock{ stripe.mtx };
+	// The guild may have been deleted since, a lookup never brings it back
+	const auto guild{ stripe.guilds.find(guild_id) };
+	if (guild == stripe.guilds.end()) {
+		lock.unlock();
+		return resolve_uncached(member);
+	}
+
+	entry.resolved = resolve(guild->second, guild_id, entry.roles);
+	const MemberPermissions resolved{ entry.resolved };
+	guild->second.members.insert_or_assign(member.user_id, std::move(entry));
+	return resolved;
+}
+
+// For guilds that aren't tracked: goes through D++'s role cache directly and keeps nothing
+MemberPermissions PermissionCache::resolve_uncached(const dpp::guild_member& member) {
+	MemberPermissions resolved{};
+	for (const dpp::snowflake role_id : member.get_roles()) {
+		if (const dpp::role* r{ dpp::find_role(role_id) }) {
+			resolved.permissions |= r->permissions;
+			resolved.highest_role = std::max(resolved.highest_role, RoleRank{ .position = r->position, .id = role_id });
+		}
+	}
+	return resolved;
+}
+
+std::optional<uint64_t> PermissionCache::get_owner_id(const uint64_t guild_id) {
+	Stripe& stripe{ stripe_of(guild_id) };
+	std::shared_lock lock{ stripe.mtx };
+	const auto guild{ stripe.guilds.find(guild_id) };
+	if (guild == stripe.guilds.end()) return std::nullopt;
+	return guild->second.owner_id;
+}
+
+std::optional<uint16_t> PermissionCache::get_role_position(const uint64_t guild_id, const uint64_t role_id) {
+	Stripe& stripe{ stripe_of(guild_id) };
+	std::shared_lock lock{ stripe.mtx };
+	const auto guild{ stripe.guilds.find(guild_id) };
+	if (guild == stripe.guilds.end()) return std::nullopt;
+
+	const auto i{ guild->second.roles.find(role_id) };
+	if (!i.has_value()) return std::nullopt;
+	return guild->second.roles.position_at(i.value());
+}
+
+HierarchyCheck PermissionCache::can_manage_role(const dpp::guild_member& actor, const uint64_t role_id) {
+	// Also loads the guild if it isn't cached yet
+	const MemberPermissions actor_permissions{ get(actor) };
+
+	Stripe& stripe{ stripe_of(actor.guild_id) };
+	std::shared_lock lock{ stripe.mtx };
+	const auto guild{ stripe.guilds.find(actor.guild_id) };
+	if (guild == stripe.guilds.end()) return HierarchyCheck::Unknown;
+	if (static_cast<uint64_t>(actor.user_id) == guild->second.owner_id) return HierarchyCheck::Allowed;
+
+	const auto i{ guild->second.roles.find(role_id) };
+	if (!i.has_value()) return HierarchyCheck::Unknown;
+	return guild->second.roles.rank_at(i.value()) < actor_permissions.highest_role ? HierarchyCheck::Allowed : HierarchyCheck::Denied;
+}
+
+HierarchyCheck PermissionCache::can_act_on(const dpp::guild_member& actor, const uint64_t target_id) {
+	const dpp::snowflake target{ target_id };
+	return can_act_on(actor, std::span<const dpp::snowflake>{ &target, 1 }).front();
+}
+
+std::vector<HierarchyCheck> PermissionCache::can_act_on(const dpp::guild_member& actor, std::span<const dpp::snowflake> target_ids) {
+	const MemberPermissions actor_permissions{ get(actor) };
+	std::vector<HierarchyCheck> results(target_ids.size(), HierarchyCheck::Unknown);
+
+	Stripe& stripe{ stripe_of(actor.guild_id) };
+	std::shared_lock lock{ stripe.mtx };
+	const auto guild{ stripe.guilds.find(actor.guild_id) };
+	if (guild == stripe.guilds.end()) return results;
+
+	for (std::size_t i{ 0 }; i < target_ids.size(); ++i)
+		results[i] = compare(guild->second, actor.user_id, actor_permissions.highest_role, target_ids[i]);
+	return results;
+}
+
+HierarchyCheck PermissionCache::can_act_on(const dpp::guild_member& actor, const dpp::guild_member& target) {
+	// Also loads the guild if it isn't cached yet, and caches the target
+	const RoleRank actor_rank{ get(actor).highest_role };
+	const RoleRank target_rank{ get(target).highest_role };
+
+	const std::optional<uint64_t> owner_id{ get_owner_id(actor.guild_id) };
+	if (!owner_id.has_value()) return HierarchyCheck::Unknown;
+	if (static_cast<uint64_t>(target.user_id) == owner_id.value()) return HierarchyCheck::Denied;
+	if (static_cast<uint64_t>(actor.user_id) == owner_id.value()) return HierarchyCheck::Allowed;
+	return target_rank < actor_rank ? HierarchyCheck::Allowed : HierarchyCheck::Denied;
+}
+
+std::optional<PermissionTable> PermissionCache::snapshot(const uint64_t guild_id) {
+	std::vector<uint64_t> role_masks{}, member_ids{};
+	std::vector<uint32_t> offsets{}, slots{};
+	uint64_t everyone{ 0 }, owner_id{ 0 };
+
+	{
+		Stripe& stripe{ stripe_of(guild_id) };
+		std::shared_lock lock{ stripe.mtx };
+		const auto it{ stripe.guilds.find(guild_id) };
+		if (it == stripe.guilds.end()) return std::nullopt;
+		const GuildEntry& guild{ it->second };
+
+		// Slot `i + 1` is the role at `i` in the index
+		role_masks.reserve(guild.roles.size() + 1);
+		role_masks.push_back(0);
+		for (std::size_t i{ 0 }; i < guild.roles.size(); ++i) role_masks.push_back(guild.roles.permissions_at(i));
+		if (const auto everyone_index{ guild.roles.find(guild_id) }) everyone = guild.roles.permissions_at(everyone_index.value());
+		owner_id = guild.owner_id;
+
+		member_ids.reserve(guild.members.size());
+		offsets.reserve(guild.members.size() + 1);
+		offsets.push_back(0);
+		for (const auto& [user_id, entry] : guild.members) {
+			member_ids.push_back(user_id);
+			for (const uint64_t role_id : entry.roles)
+				if (const auto i{ guild.roles.find(role_id) }) slots.push_back(static_cast<uint32_t>(i.value() + 1));
+			offsets.push_back(static_cast<uint32_t>(slots.size()));
+		}
+	}
+
+	// The column layout is built after the lock is released
+	return make_permission_table(everyone, owner_id, std::move(role_masks), std::move(member_ids), offsets, slots);
+}
+
+void PermissionCache::on_role_changed(const uint64_t guild_id, const dpp::role& r) {
+	Stripe& stripe{ stripe_of(guild_id) };
+	std::unique_lock lock{ stripe.mtx };
+	const auto it{ stripe.guilds.find(guild_id) };
+	if (it == stripe.guilds.end()) return; // Loaded on first use
+	GuildEntry& guild{ it->second };
+
+	guild.roles.upsert(RoleIndex::Role{ .id = r.id, .permissions = r.permissions, .position = r.position });
+
+	// Only the members holding the role change, except for @everyone which everyone holds
+	const bool is_everyone{ static_cast<uint64_t>(r.id) == guild_id };
+	for (auto& [user_id, entry] : guild.members)
+		if (is_everyone || std::find(entry.roles.begin(), entry.roles.end(), static_cast<uint64_t>(r.id)) != entry.roles.end())
+			entry.resolved = resolve(guild, guild_id, entry.roles);
+}
+
+void PermissionCache::on_role_deleted(const uint64_t guild_id, const uint64_t role_id) {
+	Stripe& stripe{ stripe_of(guild_id) };
+	std::unique_lock lock{ stripe.mtx };
+	const auto it{ stripe.guilds.find(guild_id) };
+	if (it == stripe.guilds.end()) return;
+	GuildEntry& guild{ it->second };
+
+	guild.roles.erase(role_id);
+
+	// The member's role list from the next interaction won't have the role, so the fingerprint is dropped as well
+	for (auto& [user_id, entry] : guild.members) {
+		if (std::erase(entry.roles, role_id) == 0) continue;
+		entry.fingerprint = 0;
+		entry.resolved = resolve(guild, guild_id, entry.roles);
+	}
+}
+
+void PermissionCache::on_member_changed(const dpp::guild_member& member) {
+	const uint64_t guild_id{ member.guild_id };
+	Stripe& stripe{ stripe_of(guild_id) };
+	std::unique_lock lock{ stripe.mtx };
+	const auto it{ stripe.guilds.find(guild_id) };
+	if (it == stripe.guilds.end()) return;
+
+	MemberEntry entry{ .fingerprint = roles_fingerprint(member.get_roles()), .roles = to_role_ids(member.get_roles()), .resolved = {} };
+	entry.resolved = resolve(it->second, guild_id, entry.roles);
+	it->second.members.insert_or_assign(member.user_id, std::move(entry));
+}
+
+void PermissionCache::on_member_removed(const uint64_t guild_id, const uint64_t user_id) {
+	Stripe& stripe{ stripe_of(guild_id) };
+	std::unique_lock lock{ stripe.mtx };
+	if (const auto it{ stripe.guilds.find(guild_id) }; it != stripe.guilds.end()) it->second.members.erase(user_id);
+}
+
+void PermissionCache::on_guild_loaded(const dpp::guild& g) {
+	// Built outside the stripe lock, `load_guild` takes D++'s cache lock
+	GuildEntry guild{ load_guild(g) };
+
+	Stripe& stripe{ stripe_of(g.id) };
+	std::unique_lock lock{ stripe.mtx };
+	stripe.guilds.insert_or_assign(g.id, std::move(guild));
+}
+
+bool PermissionCache::load_on_demand(const dpp::guild& g) {
+	GuildEntry guild{ load_guild(g) };
+
+	Stripe& stripe{ stripe_of(g.id) };
+	std::unique_lock lock{ stripe.mtx };
+
+	// D++ drops a guild from its cache before the delete event reaches `on_guild_removed`, which waits for this lock
+	// Checking under the lock means a guild deleted meanwhile is either skipped here or erased right after
+	if (!dpp::find_guild(g.id)) return false;
+
+	// A guild create that got here first has the newer copy
+	stripe.guilds.try_emplace(g.id, std::move(guild));
+	return true;
+}
+
+void PermissionCache::on_owner_changed(const uint64_t guild_id, const uint64_t owner_id) {
+	Stripe& stripe{ stripe_of(guild_id) };
+	std::unique_lock lock{ stripe.mtx };
+	if (const auto it{ stripe.guilds.find(guild_id) }; it != stripe.guilds.end()) it->second.owner_id = owner_id;
+}
+
+void PermissionCache::on_guild_removed(const uint64_t guild_id) {
+	Stripe& stripe{ stripe_of(guild_id) };
+	std::unique_lock lock{ stripe.mtx };
+	stripe.guilds.erase(guild_id);
+}
+
+void PermissionCache::attach(dpp::cluster& bot) {
+	bot.on_guild_create([this](const dpp::guild_create_t& event) {
+		if (const dpp::guild* g{ event_object(event.created) }) on_guild_loaded(*g);
+	});
+
+	// Ownership transfers come as guild updates
+	bot.on_guild_update([this](const dpp::guild_update_t& event) {
+		if (const dpp::guild* g{ event_object(event.updated) }) on_owner_changed(g->id, g->owner_id);
+	});
+
+	bot.on_guild_delete([this](const dpp::guild_delete_t& event) {
+		if (const dpp::guild* g{ event_object(event.deleted) }) on_guild_removed(g->id);
+	});
+
+	bot.on_guild_role_create([this](const dpp::guild_role_create_t& event) {
+		const dpp::guild* g{ event_object(event.creating_guild) };
+		const dpp::role* r{ event_object(event.created) };
+		if (g && r) on_role_changed(g->id, *r);
+	});
+
+	bot.on_guild_role_update([this](const dpp::guild_role_update_t& event) {
+		const dpp::guild* g{ event_object(event.updating_guild) };
+		const dpp::role* r{ event_object(event.updated) };
+		if (g && r) on_role_changed(g->id, *r);
+	});
+
+	bot.on_guild_role_delete([this](const dpp::guild_role_delete_t& event) {
+		if (const dpp::guild* g{ event_object(event.deleting_guild) }) on_role_deleted(g->id, event.role_id);
+	});
+
+	bot.on_guild_member_add([this](const dpp::guild_member_add_t& event) {
+		on_member_changed(event.added);
+	});
+
+	bot.on_guild_member_update([this](const dpp::guild_member_update_t& event) {
+		on_member_changed(event.updated);
+	});
+
+	bot.on_guild_member_remove([this](const dpp::guild_member_remove_t& event) {
+		on_member_removed(event.guild_id, event.removed.id);
+	});
+}
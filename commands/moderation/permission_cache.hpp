@@ -0,0 +1,195 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef PERMISSION_CACHE_HPP
+#define PERMISSION_CACHE_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <array>
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <span>
+ * #include <optional>
+ * #include <limits>
+ * #include <shared_mutex>
+ * #include <atomic>
+ * #include <cstdint>
+ * #include <dpp/cluster.h>
+ * #include <dpp/guild.h>
+ * #include <dpp/permissions.h>
+ * #include <dpp/role.h>
+ * #include <moderation/bulk_permissions.hpp>
+ */
+
+#include <pch.hpp>
+
+/*
+ * @brief A role's place in the hierarchy
+ *
+ * Roles sharing a position are ordered by ID, the older (lower ID) role being the higher one, as Discord lists them
+ * The default rank, for a member without roles, is below every role
+ */
+struct RoleRank {
+	uint16_t position{ 0 };
+	uint64_t id{ std::numeric_limits<uint64_t>::max() };
+
+	friend constexpr bool operator<(const RoleRank& a, const RoleRank& b) noexcept {
+		return a.position != b.position ? a.position < b.position : a.id > b.id;
+	}
+};
+
+// A member's permissions from their roles (channel overwrites not included) and their highest role
+struct MemberPermissions {
+	dpp::permission permissions{};
+	RoleRank highest_role{};
+};
+
+// Identifies a member's set of roles regardless of their order
+uint64_t roles_fingerprint(const std::vector<dpp::snowflake>& roles);
+
+enum class HierarchyCheck : uint8_t {
+	Allowed,
+	Denied,
+	Unknown // The target isn't cached
+};
+
+/*
+ * @brief A guild's roles in hierarchy order, lowest first, in parallel arrays
+ *
+ * A role's slot is its rank, so comparing two slots compares the roles' places in the hierarchy
+ * `by_id` holds the slots sorted by role ID, a lookup is a binary search over it that only touches the other arrays for the match
+ */
+class RoleIndex {
+public:
+	struct Role {
+		uint64_t id{ 0 };
+		uint64_t permissions{ 0 };
+		uint16_t position{ 0 };
+	};
+
+	// Replaces the whole index, sorting once
+	void assign(std::vector<Role> roles);
+	void upsert(const Role role);
+	void erase(const uint64_t role_id);
+
+	std::optional<std::size_t> find(const uint64_t role_id) const;
+	uint64_t permissions_at(const std::size_t i) const { return permissions[i]; }
+	uint16_t position_at(const std::size_t i) const { return positions[i]; }
+	RoleRank rank_at(const std::size_t i) const { return RoleRank{ .position = positions[i], .id = ids[i] }; }
+	std::size_t size() const { return ids.size(); }
+
+private:
+	std::vector<uint64_t> ids;
+	std::vector<uint64_t> permissions;
+	std::vector<uint16_t> positions;
+	std::vector<uint32_t> by_id;
+
+	// Rebuilds `by_id` after the slots moved
+	void reindex();
+};
+
+/*
+ * @brief Per-guild cache of every member's effective permissions
+ *
+ * The cache keeps its own copy of each guild's roles, so a lookup never takes D++'s cache lock
+ * Role and member events update the affected entries as they arrive
+ * A member whose roles differ from the cached ones (ex. an update missed without the members intent)
+ * is resolved again from the cached roles
+ */
+class PermissionCache {
+public:
+	// Registers the role, member and guild event handlers that keep the cache up to date
+	void attach(dpp::cluster& bot);
+
+	MemberPermissions get(const dpp::guild_member& member);
+
+	std::optional<uint64_t> get_owner_id(const uint64_t guild_id);
+
+	// Position of a role, if its guild and the role are cached
+	std::optional<uint16_t> get_role_position(const uint64_t guild_id, const uint64_t role_id);
+
+	// Whether `actor`'s highest role is above the role. The guild owner can manage every role. Unknown if the guild or the role isn't cached
+	HierarchyCheck can_manage_role(const dpp::guild_member& actor, const uint64_t role_id);
+
+	// Whether `actor`'s highest role is above `target`'s. Nobody can act on the guild owner, and the owner can act on everyone else
+	HierarchyCheck can_act_on(const dpp::guild_member& actor, const uint64_t target_id);
+
+	/*
+	 * @brief `can_act_on` for many targets at once, under a single lock
+	 * @return One result per target, in the same order
+	 */
+	std::vector<HierarchyCheck> can_act_on(const dpp::guild_member& actor, std::span<const dpp::snowflake> target_ids);
+
+	// `can_act_on` for a target the caller already has (ex. fetched over REST), cached or not. Unknown only if the guild isn't cached
+	HierarchyCheck can_act_on(const dpp::guild_member& actor, const dpp::guild_member& target);
+
+	// Copies a guild's cached roles and members into a table for `evaluate_permissions`
+	std::optional<PermissionTable> snapshot(const uint64_t guild_id);
+
+	uint64_t get_hits() const { return hits.load(std::memory_order_relaxed); }
+	uint64_t get_misses() const { return misses.load(std::memory_order_relaxed); }
+
+private:
+	struct MemberEntry {
+		uint64_t fingerprint{ 0 };
+		std::vector<uint64_t> roles;
+		MemberPermissions resolved;
+	};
+
+	struct GuildEntry {
+		uint64_t owner_id{ 0 };
+		RoleIndex roles; // Includes @everyone, whose ID is the guild ID
+		std::unordered_map<uint64_t, MemberEntry> members;
+	};
+
+	// Guilds are spread over stripes, so events of one guild don't block lookups in another
+	struct Stripe {
+		std::shared_mutex mtx;
+		std::unordered_map<uint64_t, GuildEntry> guilds;
+	};
+
+	static constexpr std::size_t stripe_count{ 16 };
+	std::array<Stripe, stripe_count> stripes;
+
+	std::atomic<uint64_t> hits{ 0 };
+	std::atomic<uint64_t> misses{ 0 };
+
+	Stripe& stripe_of(const uint64_t guild_id) { return stripes[(guild_id >> 22) % stripe_count]; }
+
+	static HierarchyCheck compare(const GuildEntry& guild, const uint64_t actor_id, const RoleRank actor_rank, const uint64_t target_id);
+	static MemberPermissions resolve(const GuildEntry& guild, const uint64_t guild_id, const std::vector<uint64_t>& roles);
+	static GuildEntry load_guild(const dpp::guild& g);
+	static MemberPermissions resolve_uncached(const dpp::guild_member& member);
+
+	// Starts tracking a guild on its first lookup, unless D++ no longer has it. Returns whether it is tracked
+	bool load_on_demand(const dpp::guild& g);
+
+	void on_role_changed(const uint64_t guild_id, const dpp::role& r);
+	void on_role_deleted(const uint64_t guild_id, const uint64_t role_id);
+	void on_member_changed(const dpp::guild_member& member);
+	void on_member_removed(const uint64_t guild_id, const uint64_t user_id);
+	void on_guild_loaded(const dpp::guild& g);
+	void on_owner_changed(const uint64_t guild_id, const uint64_t owner_id);
+	void on_guild_removed(const uint64_t guild_id);
+};
+
+extern PermissionCache permission_cache;
+
+#endif // PERMISSION_CACHE_HPP
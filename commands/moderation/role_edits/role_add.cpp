@@ -20,6 +20,7 @@
  * #include <vector>
  * #include <string>
  * #include <algorithm>
+ * #include <chrono>
  * #include <exception>
  * #include <variant>
  * #include <cstdint>
@@ -35,15 +36,29 @@
  * #include <dpp/role.h>
  * #include <dpp/channel.h>
  * #include <dpp/snowflake.h>
+ * #include <dpp/coro.h>
  * #include <Ishmael.hpp>
- * #include <utilities/secrets/secrets.hpp>
+ * #include <commands/command_table.hpp>
+ * #include <utilities/render/render.hpp>
  * #include <commands/moderation/mod_utils.hpp>
+ * #include <commands/moderation/permission_cache.hpp>
+ * #include <commands/moderation/member_resolver.hpp>
  * #include <commands/ICommands.hpp>
  * #include <utilities/console_utils/console_utils.hpp>
+ * #include <utilities/rest_scheduler/rest_scheduler.hpp>
  */
 
 #include <pch.hpp>
 
+// A second click on the same `/role_add` usually comes a moment after the first one finished
+static SingleFlight<std::string> role_add_flights{ std::chrono::milliseconds{ 500 } };
+
+static constexpr render::Template<1> log_channel_set{ "Log channel set to <#{}>. Please run your command again." };
+static constexpr render::Template<1> selection_failed{ "An error occurred while saving your selection. Please inform {} of this." };
+static constexpr render::Template<2> already_has_role{ "User <@{}> already has the role <@&{}>." };
+static constexpr render::Template<1> role_add_failed{ "An error occured while trying to add the role. Please inform {} of this." };
+static constexpr render::Template<2> role_added{ "Successfully added the <@&{}> role to <@{}>!" };
+
 static void handle_role_log_select(dpp::cluster& bot, const dpp::select_click_t& event) {
 	event.co_thinking(true);
 
@@ -51,7 +66,9 @@ static void handle_role_log_select(dpp::cluster& bot, const dpp::select_click_t&
 	const uint64_t guild_id{ event.command.guild_id };
 	try {
 		save_log_channel(guild_id, channel_id, CommandType::RoleEdit);
-		event.co_edit_original_response(dpp::message{ "Log channel set to <#" + std::to_string(channel_id) + ">. Please run your command again." }.set_flags(dpp::m_ephemeral));
+		// Keeps the role logs off the bot's own rate limits
+		ensure_log_webhook(bot, guild_id, channel_id);
+		event.co_edit_original_response(dpp::message{ log_channel_set(channel_id) }.set_flags(dpp::m_ephemeral));
 	}
 	catch (const dpp::exception& e) {
 		const std::string error_msg{ "Failed to save log channel to JSON: " + std::string{ e.what() } };
@@ -63,25 +80,27 @@ static void handle_role_log_select(dpp::cluster& bot, const dpp::select_click_t&
 			std::cerr << ConsoleColour::Red << "Failed to get the logger: " + std::string{ log_e.what() } << ConsoleColour::Reset << std::endl;
 
 		}
-		event.co_edit_original_response(dpp::message{ "An error occurred while saving your selection. Please inform <@" + secrets.at("OWNER_ID") + "> of this." }.set_flags(dpp::m_ephemeral));
+		event.co_edit_original_response(dpp::message{ selection_failed(render::owner_mention()) }.set_flags(dpp::m_ephemeral));
 	}
 }
 
-static void handle_role_add(dpp::cluster& bot, const dpp::slashcommand_t& event) {
+static dpp::task<void> handle_role_add(dpp::cluster& bot, const dpp::slashcommand_t& event) {
 	try {
-		event.co_thinking(true);
+		// `event` lives in the coroutine frame that awaits this task, so it stays valid across every `co_await` below
+		co_await event.co_thinking(true);
+		release_command_strand(event);
 
 		const dpp::guild* g{ dpp::find_guild(event.command.get_guild().id) };
 		if (!g) {
 			event.co_edit_original_response(dpp::message{ "Error: Couldn't retrieve the server information." }.set_flags(dpp::m_ephemeral));
-			return;
+			co_return;
 		}
 
 		// Find the role from the guild's cache using its ID
 		const dpp::role* role_to_add{ dpp::find_role(std::get<dpp::snowflake>(event.get_parameter("role"))) };
 		if (!role_to_add) {
 			event.co_edit_original_response(dpp::message("Error: Specific role couldn't be found on this server.").set_flags(dpp::m_ephemeral));
-			return;
+			co_return;
 		}
 
 		// Get the snowflake (ID) of the user from the command parameter
@@ -91,154 +110,104 @@ static void handle_role_add(dpp::cluster& bot, const dpp::slashcommand_t& event)
 			if (std::holds_alternative<dpp::snowflake>(user_param)) return std::get<dpp::snowflake>(user_param);
 			else return event.command.get_issuing_user().id;
 		}()};
-		
-		bot.guild_get_member(g->id, target_by_id,
-			[&bot, event, g, role_to_add, target_by_id](const dpp::confirmation_callback_t& target_callback) {
-				if (target_callback.is_error()) {
-					event.co_edit_original_response(dpp::message{ "Error: The user is not a member of this server." }.set_flags(dpp::m_ephemeral));
-					return;
-				}
 
-				const dpp::guild_member target_user{ target_callback.get<dpp::guild_member>() };
-				const dpp::guild_member issuer_member{ event.command.member };
+		const dpp::guild_member& issuer_member{ event.command.member };
 
-				if (issuer_member.user_id == 0) {
-					event.co_edit_original_response(dpp::message("Error: Could not retrieve your member information.").set_flags(dpp::m_ephemeral));
-					return;
-				}
+		if (issuer_member.user_id == 0) {
+			event.co_edit_original_response(dpp::message("Error: Could not retrieve your member information.").set_flags(dpp::m_ephemeral));
+			co_return;
+		}
 
-				const dpp::permission issuer_perms{ calculate_permissions(issuer_member) };
+		// Shared with `/role_add_bulk`
+		if (const auto refusal{ check_role_assignment(bot, *g, *role_to_add, issuer_member) }) {
+			event.co_edit_original_response(dpp::message{ refusal.value() }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
 
-				if (!(issuer_member.is_guild_owner() || issuer_perms & dpp::p_administrator || issuer_perms & dpp::p_moderate_members)) {
-					event.co_edit_original_response(dpp::message{ "You don't have permission to use this command." }.set_flags(dpp::m_ephemeral));
-					return;
-				}
+		const dpp::permission issuer_perms{ calculate_permissions(issuer_member) };
 
-				if (role_to_add->is_managed()) {
-					event.co_edit_original_response(dpp::message{ "Error: This role is managed by an integration and cannot be assigned manually." }.set_flags(dpp::m_ephemeral));
-					return;
-				}
+		// Before the role is added, check the existence of the logging channel
+		const auto log_channel_id_opt{ get_log_channel(g->id, CommandType::RoleEdit) };
 
-				if (role_to_add->has_administrator()) {
-					event.co_edit_original_response(dpp::message{ "For security reasons, roles with `Administrator` permission can't be assigned with this command." }
-						.set_flags(dpp::m_ephemeral));
-					return;
-				}
+		if (!log_channel_id_opt.has_value()) {
+			// Logging channel isn't set. We stop and prompt the user
+			if (!(issuer_member.is_guild_owner() || issuer_perms & dpp::p_administrator || issuer_perms & dpp::p_manage_guild)) {
+				event.co_edit_original_response(dpp::message{ "Error: You cannot add this role as a role edits logging channel isn't set up. Please ask an administrator to set one." }
+					.set_flags(dpp::m_ephemeral));
+				co_return;
+			}
 
-				if (role_to_add->id == g->id) {
-					event.co_edit_original_response(dpp::message{ "Error: Everyone inherently possesses the `@everyone` role. It can't be added." }.set_flags(dpp::m_ephemeral));
-					return;
-				}
+			dpp::message msg{ "Before you can add this role, a logging channel must be set up." };
+			msg.set_flags(dpp::m_ephemeral);
 
-				const dpp::guild_member bot_member{ dpp::find_guild_member(g->id, bot.me.id) };
-				const dpp::permission bot_perms{ calculate_permissions(bot_member) };
+			// Create the select menu
+			dpp::component select_menu{ dpp::component()
+				.set_type(dpp::cot_channel_selectmenu)
+				.set_placeholder("Select a channel for role logs")
+				.set_id("setup_role_log_channel") };
 
-				// Check whether the bot has all the permissions of the role to be assigned
-				if (!(bot_perms & dpp::p_administrator)) {
-					// Bot is not admin, so check if it has all perms of the role
-					if ((bot_perms & role_to_add->permissions) != role_to_add->permissions) {
-						event.co_edit_original_response(dpp::message{ "I can't assign this role as I lack some of its permissions." }.set_flags(dpp::m_ephemeral));
-						return;
-					}
-				}
+			// Add a filter to only show text channels
+			select_menu.add_channel_type(dpp::channel_type::CHANNEL_TEXT);
 
-				// Check the bot's role heirarchy
-				if (get_highest_role_position(bot_member) <= role_to_add->position) {
-					event.co_edit_original_response(dpp::message{ "I can't assign this role as it is higher than or equal to my own highest role." }
-						.set_flags(dpp::m_ephemeral));
-					return;
-				}
+			msg.add_component_v2(dpp::component().add_component_v2(select_menu));
+			event.co_edit_original_response(msg);
+			co_return;
+		}
 
-				// The server owner bypasses role heirarchy and permission checks
-				if (!issuer_member.is_guild_owner()) {
-					// User's highest role must be higher than the role to be added
-					if (get_highest_role_position(issuer_member) <= role_to_add->position) {
-						event.co_edit_original_response(dpp::message{ "You can't assign a role that is higher than or equal to your own highest role." }
-							.set_flags(dpp::m_ephemeral));
-						return;
-					}
-
-					if (!(issuer_perms & dpp::p_administrator)) {
-						if ((issuer_perms & role_to_add->permissions) != role_to_add->permissions) {
-							event.co_edit_original_response(dpp::message{ "You can't assign a role that has permissions you don't possess." }.set_flags(dpp::m_ephemeral));
-							return;
-						}
-					}
-				}
+		// The checks above depend on who asked, so they run for every request
+		// Moderators adding the same role to the same user at once share what follows, including the audit log
+		const dpp::snowflake guild_id{ g->id };
+		const dpp::snowflake role_id{ role_to_add->id };
+		const std::string reply{ co_await role_add_flights.run(ModerationKey{ .guild_id = guild_id, .target_id = target_by_id, .action = ModerationAction::RoleAdd, .object_id = role_id },
+			[&bot, &event, &issuer_member, role_to_add, guild_id, role_id, target_by_id]() -> dpp::task<std::string> {
+				// Discord sends the target's member data with the `user` option, REST is only the fallback
+				std::optional<MemberLookup> lookup{ member_resolver.from_interaction(event.command, target_by_id) };
+				if (!lookup.has_value()) lookup = co_await member_resolver.co_lookup(bot, guild_id, target_by_id);
+				const std::optional<dpp::guild_member>& target{ lookup->member };
+				if (!target.has_value()) co_return "Error: The user is not a member of this server.";
+
+				const dpp::guild_member& target_user{ target.value() };
 
 				// Check if the target already has the role
 				const auto& target_roles{ target_user.get_roles() };
-				if (std::find(target_roles.begin(), target_roles.end(), role_to_add->id) != target_roles.end()) {
-					event.co_edit_original_response(dpp::message{ "User <@" + std::to_string(target_by_id) + "> already has the role <@&" + std::to_string(role_to_add->id) + ">." }
-						.set_flags(dpp::m_ephemeral));
-					return;
-				}
-
-				// Before the role is added, check the existence of the logging channel
-				const auto log_channel_id_opt{ get_log_channel(g->id, CommandType::RoleEdit) };
-
-				if (!log_channel_id_opt.has_value()) {
-					// Logging channel isn't set. We stop and prompt the user
-					if (!(issuer_member.is_guild_owner() || issuer_perms & dpp::p_administrator || issuer_perms & dpp::p_manage_guild)) {
-						event.co_edit_original_response(dpp::message{ "Error: You cannot add this role as a role edits logging channel isn't set up. Please ask an administrator to set one." }
-							.set_flags(dpp::m_ephemeral));
-						return;
-					}
+				if (std::find(target_roles.begin(), target_roles.end(), role_id) != target_roles.end())
+					co_return already_has_role(target_by_id, role_id);
 
-					dpp::message msg{ "Before you can add this role, a logging channel must be set up." };
-					msg.set_flags(dpp::m_ephemeral);
+				// Add the role
+				const dpp::confirmation_callback_t add_role_callback{ co_await rest_scheduler.co_submit(RestLane::Interaction, rest_route("guild_member_role", guild_id),
+					[&bot, guild_id, target_by_id, role_id](dpp::command_completion_event_t callback) { bot.guild_member_add_role(guild_id, target_by_id, role_id, std::move(callback)); }) };
+				if (add_role_callback.is_error()) {
+					Logger::error(false, "Failed to add role: {}", add_role_callback.get_error().message);
+					co_return role_add_failed(render::owner_mention());
+				}
 
-					// Create the select menu
-					dpp::component select_menu{ dpp::component()
-						.set_type(dpp::cot_channel_selectmenu)
-						.set_placeholder("Select a channel for role logs")
-						.set_id("setup_role_log_channel") };
+				// The cached copy doesn't have the role yet
+				member_resolver.forget(guild_id, target_by_id);
 
-					// Add a filter to only show text channels
-					select_menu.add_channel_type(dpp::channel_type::CHANNEL_TEXT);
+				send_audit_log(bot, event, CommandType::RoleEdit, 3265892, "Role Added", target_user, issuer_member, role_to_add, get_reason_from_event(event)); // 3265892 = Hex: #31D564
 
-					msg.add_component_v2(dpp::component().add_component_v2(select_menu));
-					event.co_edit_original_response(msg);
-					return;
-				}
+				co_return role_added(role_id, target_by_id);
+			}) };
 
-				// Add the role
-				bot.guild_member_add_role(g->id, target_by_id, role_to_add->id,
-					[&bot, event, role_to_add, target_by_id, target_user, issuer_member](const dpp::confirmation_callback_t& add_role_callback) {
-						if (add_role_callback.is_error()) {
-							Logger::error(false, "Failed to add role: {}", add_role_callback.get_error().message);
-							event.co_edit_original_response(dpp::message{ "An error occured while trying to add the role. Please inform <@" + std::string{secrets.at("OWNER_ID")} + "> of this." });
-							return;
-						}
-
-						event.co_edit_original_response(dpp::message{ "Successfully added the <@&" + std::to_string(role_to_add->id) + "> role to <@" + std::to_string(target_by_id) + ">!" }
-							.set_flags(dpp::m_ephemeral));
-
-						send_audit_log(bot, event, CommandType::RoleEdit, 3265892, "Role Added", target_user, issuer_member, role_to_add, get_reason_from_event(event)); // 3265892 = Hex: #31D564
-					}
-				);
-			});
+		event.co_edit_original_response(dpp::message{ reply }.set_flags(dpp::m_ephemeral));
 	}
 	catch (const dpp::exception& e) {
 		Logger::exception(false, "D++ exception thrown in `/role_add`: {}", std::string(e.what()));
-		event.co_edit_original_response(dpp::message("An exception was thrown while processing this command. Please inform <@" + std::string(secrets.at("OWNER_ID")) + "> of this.")
-			.set_flags(dpp::m_ephemeral));
+		event.co_edit_original_response(render::exception_reply());
 	}
 	catch (const std::exception& e) {
 		Logger::exception(false, "Standard exception thrown in `/role_add`: {}", std::string(e.what()));
-		event.co_edit_original_response(dpp::message("An exception was thrown while processing this command. Please inform <@" + std::string(secrets.at("OWNER_ID")) + "> of this.")
-			.set_flags(dpp::m_ephemeral));
+		event.co_edit_original_response(render::exception_reply());
 	}
 	catch (...) {
 		Logger::exception(false, "Unknown exception thrown in `/role_add`");
-		event.co_edit_original_response(dpp::message("An exception was thrown while processing this command. Please inform <@" + std::string(secrets.at("OWNER_ID")) + "> of this.")
-			.set_flags(dpp::m_ephemeral));
+		event.co_edit_original_response(render::exception_reply());
 	}
 }
 
 void register_role_add_command() {
-	commands["role_add"] = {
-		.function = handle_role_add,
+	commands[command_table::index_of("role_add")] = {
+		.coroutine = handle_role_add,
 		.description = "Adds a role to a user.",
 		.permissions = dpp::p_moderate_members, // Base permission
 		.is_restricted_to_owners = false, // Not restricted to dev guild
@@ -248,7 +217,9 @@ void register_role_add_command() {
 			dpp::command_option(dpp::co_string, "reason", "The reason", false)
 		}
 	};
+}
 
+void register_role_add_select_handlers() {
 	select_handlers["setup_role_log_channel"] = {
 		.function = handle_role_log_select,
 		.required_permissions = dpp::p_manage_guild
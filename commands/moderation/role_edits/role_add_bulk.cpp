@@ -0,0 +1,528 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <vector>
+ * #include <deque>
+ * #include <string>
+ * #include <memory_resource>
+ * #include <unordered_set>
+ * #include <memory>
+ * #include <mutex>
+ * #include <chrono>
+ * #include <format>
+ * #include <exception>
+ * #include <variant>
+ * #include <cstdint>
+ * #include <dpp/appcommand.h>
+ * #include <dpp/cache.h>
+ * #include <dpp/cluster.h>
+ * #include <dpp/message.h>
+ * #include <dpp/dispatcher.h>
+ * #include <dpp/exception.h>
+ * #include <dpp/guild.h>
+ * #include <dpp/restresults.h>
+ * #include <dpp/role.h>
+ * #include <dpp/snowflake.h>
+ * #include <dpp/timer.h>
+ * #include <dpp/coro.h>
+ * #include <dpp/nlohmann/json.hpp>
+ * #include <commands/command_table.hpp>
+ * #include <commands/moderation/mod_utils.hpp>
+ * #include <commands/moderation/member_resolver.hpp>
+ * #include <commands/ICommands.hpp>
+ * #include <utilities/jobs/jobs.hpp>
+ * #include <utilities/rest_scheduler/rest_scheduler.hpp>
+ * #include <utilities/render/render.hpp>
+ * #include <utilities/logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+using json = nlohmann::json;
+
+static const std::string role_add_bulk_job_type{ "role_add_bulk" };
+
+// Role additions kept in flight at once, the REST scheduler spaces them out to the route's rate limit
+static constexpr std::size_t pipeline_depth{ 5 };
+// Completed additions between two checkpoints
+static constexpr std::size_t checkpoint_interval{ 25 };
+static constexpr auto progress_interval{ std::chrono::seconds{ 5 } };
+// The most `guild_get_members` returns per call
+static constexpr uint16_t members_page_size{ 1000 };
+// How long to back off after a 429, or after the scheduler shed a call
+static constexpr uint64_t retry_delay_seconds{ 2 };
+static constexpr std::size_t max_listed_users{ 10000 };
+
+// Answers a call that came up after its job paused, in place of issuing it
+static dpp::confirmation_callback_t make_cancelled_result() {
+	dpp::confirmation_callback_t result{};
+	// Any error status makes it an error, but not 429, the scheduler would hold the route back for it
+	result.http_info.status = 503;
+	result.http_info.body = R"({"message":"Cancelled, the job was paused","code":0})";
+	return result;
+}
+
+static int64_t unix_now() {
+	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Collects the members holding `from_role` (unless the users were listed up front),
+ * then adds `role` to each of them, `pipeline_depth` at a time
+ */
+class RoleAddBulkJob final : public Job {
+public:
+	RoleAddBulkJob(std::string id, const json& state) : Job{ std::move(id), role_add_bulk_job_type },
+		guild_id{ state.at("guild_id").get<uint64_t>() },
+		role_id{ state.at("role_id").get<uint64_t>() },
+		from_role_id{ state.value("from_role_id", uint64_t{ 0 }) },
+		issuer_id{ state.at("issuer_id").get<uint64_t>() },
+		channel_id{ state.value("channel_id", uint64_t{ 0 }) },
+		progress_message_id{ state.value("progress_message_id", uint64_t{ 0 }) },
+		reason{ state.value("reason", std::string{ "No reason provided" }) },
+		collecting{ state.value("collecting", false) },
+		after{ state.value("after", uint64_t{ 0 }) },
+		added{ state.value("added", uint64_t{ 0 }) },
+		skipped{ state.value("skipped", uint64_t{ 0 }) },
+		failed{ state.value("failed", uint64_t{ 0 }) },
+		started_at{ state.value("started_at", unix_now()) } {
+		for (const auto& user_id : state.value("pending", json::array())) pending.push_back(user_id.get<uint64_t>());
+	}
+
+	void run(dpp::cluster& cluster) override {
+		bool still_collecting{ false };
+		{
+			std::scoped_lock lock{ mtx };
+			bot = &cluster;
+			checkpoint();
+			still_collecting = collecting;
+		}
+
+		if (still_collecting) fetch_page();
+		else pump();
+	}
+
+protected:
+	json save() const override {
+		// Unconfirmed additions are redone on resume, adding a role twice is harmless
+		json pending_ids(json::array());
+		for (const uint64_t user_id : in_flight) pending_ids.push_back(user_id);
+		for (const uint64_t user_id : pending) pending_ids.push_back(user_id);
+
+		return json{
+			{ "guild_id", guild_id },
+			{ "role_id", role_id },
+			{ "from_role_id", from_role_id },
+			{ "issuer_id", issuer_id },
+			{ "channel_id", channel_id },
+			{ "progress_message_id", progress_message_id },
+			{ "reason", reason },
+			{ "collecting", collecting },
+			{ "after", after },
+			{ "pending", std::move(pending_ids) },
+			{ "added", added },
+			{ "skipped", skipped },
+			{ "failed", failed },
+			{ "started_at", started_at }
+		};
+	}
+
+private:
+	dpp::cluster* bot{ nullptr };
+
+	const uint64_t guild_id;
+	const uint64_t role_id;
+	const uint64_t from_role_id; // 0 when the users were listed
+	const uint64_t issuer_id;
+	const uint64_t channel_id;
+	const uint64_t progress_message_id; // 0 when the progress message couldn't be posted
+	const std::string reason;
+
+	bool collecting;
+	uint64_t after; // `guild_get_members` cursor
+	std::deque<uint64_t> pending{};
+	std::unordered_set<uint64_t> in_flight{};
+	uint64_t added;
+	uint64_t skipped; // Already had the role
+	uint64_t failed;
+	const int64_t started_at;
+
+	std::size_t since_checkpoint{ 0 };
+	bool retry_scheduled{ false };
+	std::chrono::steady_clock::time_point last_progress{};
+	std::string last_error{};
+
+	std::shared_ptr<RoleAddBulkJob> self() {
+		return std::static_pointer_cast<RoleAddBulkJob>(shared_from_this());
+	}
+
+	// Issues `call` on the job's cluster when the scheduler gets to it. Queued calls outlive a pause, so they don't hold a cluster of their own
+	RestScheduler::RestCall on_cluster(std::function<void(dpp::cluster&, dpp::command_completion_event_t)> call) {
+		return [job = self(), call = std::move(call)](dpp::command_completion_event_t callback) {
+			dpp::cluster* cluster{ nullptr };
+			{
+				std::scoped_lock lock{ job->mtx };
+				if (!job->paused) cluster = job->bot;
+			}
+
+			if (cluster) call(*cluster, std::move(callback));
+			else if (callback) callback(make_cancelled_result());
+		};
+	}
+
+	// Must be called without `mtx` held, a shed call completes before `submit` returns
+	void fetch_page() {
+		uint64_t cursor{ 0 };
+		{
+			std::scoped_lock lock{ mtx };
+			if (paused) return;
+			cursor = after;
+			call_queued();
+		}
+
+		rest_scheduler.submit(RestLane::Background, rest_route("guild_members", guild_id),
+			on_cluster([guild = guild_id, cursor](dpp::cluster& cluster, dpp::command_completion_event_t callback) { cluster.guild_get_members(guild, members_page_size, cursor, std::move(callback)); }),
+			[job = self()](const dpp::confirmation_callback_t& result) { job->on_page(result); });
+	}
+
+	void on_page(const dpp::confirmation_callback_t& result) {
+		bool more{ false };
+		{
+			std::scoped_lock lock{ mtx };
+			call_completed();
+			// The page is fetched again on resume, `after` hasn't moved
+			if (paused) return;
+
+			if (result.is_error()) {
+				if (result.http_info.status == 429) schedule_retry();
+				else complete("Couldn't list the server's members: " + result.get_error().message);
+				return;
+			}
+
+			const dpp::guild_member_map members{ result.get<dpp::guild_member_map>() };
+			for (const auto& [user_id, member] : members) {
+				after = std::max<uint64_t>(after, user_id);
+
+				const auto& roles{ member.get_roles() };
+				if (std::find(roles.begin(), roles.end(), from_role_id) == roles.end()) continue;
+
+				if (std::find(roles.begin(), roles.end(), role_id) != roles.end()) ++skipped;
+				else pending.push_back(user_id);
+			}
+
+			// A short page is the last one
+			if (members.size() < members_page_size) collecting = false;
+			more = collecting;
+
+			checkpoint();
+			report_progress(false);
+		}
+
+		if (more) fetch_page();
+		else pump();
+	}
+
+	// Must be called without `mtx` held
+	void pump() {
+		std::vector<uint64_t> batch{};
+		{
+			std::scoped_lock lock{ mtx };
+			if (paused || retry_scheduled) return;
+
+			while (in_flight.size() < pipeline_depth && !pending.empty()) {
+				batch.push_back(pending.front());
+				in_flight.insert(pending.front());
+				pending.pop_front();
+				call_queued();
+			}
+
+			if (batch.empty()) {
+				if (in_flight.empty() && !collecting) complete();
+				return;
+			}
+		}
+
+		const std::string route{ rest_route("guild_member_role", guild_id) };
+		for (const uint64_t user_id : batch) {
+			rest_scheduler.submit(RestLane::Background, route,
+				on_cluster([guild = guild_id, user_id, role = role_id](dpp::cluster& cluster, dpp::command_completion_event_t callback) { cluster.guild_member_add_role(guild, user_id, role, std::move(callback)); }),
+				[job = self(), user_id](const dpp::confirmation_callback_t& result) { job->on_assigned(user_id, result); });
+		}
+	}
+
+	void on_assigned(const uint64_t user_id, const dpp::confirmation_callback_t& result) {
+		{
+			std::scoped_lock lock{ mtx };
+			call_completed();
+			in_flight.erase(user_id);
+
+			// Recorded for the checkpoint `drain` writes, without queueing more work
+			if (paused) {
+				if (!result.is_error()) {
+					++added;
+					member_resolver.forget(guild_id, user_id);
+				}
+				else pending.push_back(user_id);
+				return;
+			}
+
+			if (!result.is_error()) {
+				++added;
+				// The cached copy doesn't have the role yet
+				member_resolver.forget(guild_id, user_id);
+			}
+			else if (result.http_info.status == 429) {
+				pending.push_back(user_id);
+				schedule_retry();
+			}
+			else {
+				++failed;
+				last_error = result.get_error().message;
+			}
+
+			if (++since_checkpoint >= checkpoint_interval) {
+				since_checkpoint = 0;
+				checkpoint();
+			}
+			report_progress(false);
+		}
+
+		pump();
+	}
+
+	// Must be called with `mtx` held
+	void schedule_retry() {
+		if (retry_scheduled) return;
+		retry_scheduled = true;
+
+		bot->start_timer([job = self()](const dpp::timer timer) {
+			bool still_collecting{ false };
+			{
+				std::scoped_lock lock{ job->mtx };
+				// The timer fires on the cluster that owns it, so `bot` is still valid here
+				job->bot->stop_timer(timer);
+				if (job->paused) return;
+				job->retry_scheduled = false;
+				still_collecting = job->collecting;
+			}
+
+			if (still_collecting) job->fetch_page();
+			else job->pump();
+		}, retry_delay_seconds);
+	}
+
+	// Must be called with `mtx` held
+	void report_progress(const bool force, const std::string& status = {}) {
+		if (progress_message_id == 0) return;
+
+		const auto now{ std::chrono::steady_clock::now() };
+		if (!force && now - last_progress < progress_interval) return;
+		last_progress = now;
+
+		std::string content{};
+		if (!status.empty()) content = status;
+		else if (collecting) content = std::format("Collecting the members with <@&{}>: {} found so far.", from_role_id, pending.size() + skipped);
+		else {
+			const uint64_t total{ added + failed + pending.size() + in_flight.size() };
+			const int64_t elapsed{ std::max<int64_t>(unix_now() - started_at, 1) };
+			content = std::format("Adding <@&{}>: {}/{} done ({} added, {} failed, {} already had it), {:.1f} members/s.",
+				role_id, added + failed, total, added, failed, skipped, static_cast<double>(added) / static_cast<double>(elapsed));
+		}
+
+		dpp::message progress{ channel_id, content };
+		progress.id = progress_message_id;
+
+		// Progress is the first thing to go under load, the next edit covers it
+		rest_scheduler.submit(RestLane::Background, rest_route("message_edit", channel_id),
+			on_cluster([progress = std::move(progress)](dpp::cluster& cluster, dpp::command_completion_event_t callback) { cluster.message_edit(progress, std::move(callback)); }));
+	}
+
+	// Must be called with `mtx` held
+	void complete(const std::string& failure = {}) {
+		const int64_t elapsed{ std::max<int64_t>(unix_now() - started_at, 1) };
+		const std::string summary{ std::format("{} added, {} failed, {} already had it", added, failed, skipped) };
+
+		report_progress(true, failure.empty()
+			? std::format("Finished adding <@&{}>: {} in {} s.", role_id, summary, elapsed)
+			: std::format("Stopped adding <@&{}>: {}. {}.", role_id, failure, summary));
+
+		// One entry for the whole job, rather than one per member
+		dpp::embed log_embed{ dpp::embed()
+			.set_color(3265892) // Hex: #31D564
+			.set_title("Role Added (Bulk)")
+			.add_field("Role", std::format("<@&{}>", role_id), true)
+			.add_field("Moderator", std::format("<@{}>", issuer_id), true)
+			.add_field("Members", summary, false) };
+		if (from_role_id != 0) log_embed.add_field("Members With", std::format("<@&{}>", from_role_id), false);
+		if (!failure.empty()) log_embed.add_field("Stopped", failure, false);
+		else if (!last_error.empty()) log_embed.add_field("Last Error", last_error, false);
+		log_embed.add_field("Reason", reason, false).set_timestamp(time(0));
+
+		send_audit_embed(*bot, guild_id, CommandType::RoleEdit, log_embed);
+
+		Logger::info(false, "Job {} finished in {} s: {}", get_id(), elapsed, failure.empty() ? summary : failure);
+		finish();
+	}
+};
+
+static dpp::task<void> handle_role_add_bulk(dpp::cluster& bot, const dpp::slashcommand_t& event) {
+	try {
+		co_await event.co_thinking(true);
+		release_command_strand(event);
+
+		const dpp::guild* g{ dpp::find_guild(event.command.get_guild().id) };
+		if (!g) {
+			event.co_edit_original_response(dpp::message{ "Error: Couldn't retrieve the server information." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		const dpp::role* role_to_add{ dpp::find_role(std::get<dpp::snowflake>(event.get_parameter("role"))) };
+		if (!role_to_add) {
+			event.co_edit_original_response(dpp::message{ "Error: Specific role couldn't be found on this server." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		const dpp::guild_member& issuer_member{ event.command.member };
+		if (issuer_member.user_id == 0) {
+			event.co_edit_original_response(dpp::message{ "Error: Could not retrieve your member information." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		// The same checks as `/role_add`, the role and the issuer don't change per member
+		if (const auto refusal{ check_role_assignment(bot, *g, *role_to_add, issuer_member) }) {
+			event.co_edit_original_response(dpp::message{ refusal.value() }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		const auto from_role_param{ event.get_parameter("from_role") };
+		const uint64_t from_role_id{ std::holds_alternative<dpp::snowflake>(from_role_param) ? static_cast<uint64_t>(std::get<dpp::snowflake>(from_role_param)) : 0 };
+		const auto users_param{ event.get_parameter("users") };
+		const std::vector<uint64_t> user_ids{ std::holds_alternative<std::string>(users_param) ? parse_user_ids(std::get<std::string>(users_param)) : std::vector<uint64_t>{} };
+
+		if ((from_role_id == 0) == !std::holds_alternative<std::string>(users_param)) {
+			event.co_edit_original_response(dpp::message{ "Error: Give either `from_role` or `users`, but not both." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+		if (from_role_id == role_to_add->id) {
+			event.co_edit_original_response(dpp::message{ "Error: `from_role` is the role being added." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+		if (from_role_id == 0 && user_ids.empty()) {
+			event.co_edit_original_response(dpp::message{ "Error: No user IDs or mentions were found in `users`." }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+		if (user_ids.size() > max_listed_users) {
+			event.co_edit_original_response(dpp::message{ std::format("Error: At most {} users can be listed, use `from_role` for more.", max_listed_users) }.set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		const dpp::permission issuer_perms{ calculate_permissions(issuer_member) };
+
+		// Like `/role_add`, nothing is assigned until role edits are logged somewhere
+		if (!get_log_channel(g->id, CommandType::RoleEdit).has_value()) {
+			if (!(issuer_member.is_guild_owner() || issuer_perms & dpp::p_administrator || issuer_perms & dpp::p_manage_guild)) {
+				event.co_edit_original_response(dpp::message{ "Error: You cannot add this role as a role edits logging channel isn't set up. Please ask an administrator to set one." }
+					.set_flags(dpp::m_ephemeral));
+				co_return;
+			}
+
+			dpp::message msg{ "Before you can add this role, a logging channel must be set up." };
+			msg.set_flags(dpp::m_ephemeral);
+
+			dpp::component select_menu{ dpp::component()
+				.set_type(dpp::cot_channel_selectmenu)
+				.set_placeholder("Select a channel for role logs")
+				.set_id("setup_role_log_channel") };
+			select_menu.add_channel_type(dpp::channel_type::CHANNEL_TEXT);
+
+			msg.add_component_v2(dpp::component().add_component_v2(select_menu));
+			event.co_edit_original_response(msg);
+			co_return;
+		}
+
+		// The interaction token expires after 15 minutes, so progress goes to a message of its own
+		const uint64_t channel_id{ event.command.channel_id };
+		const dpp::confirmation_callback_t created{ co_await rest_scheduler.co_submit(RestLane::Interaction, rest_route("message_create", channel_id),
+			[&bot, channel_id, role_id = role_to_add->id](dpp::command_completion_event_t callback) {
+				bot.message_create(dpp::message{ channel_id, std::format("Preparing to add <@&{}>...", static_cast<uint64_t>(role_id)) }, std::move(callback));
+			}) };
+
+		uint64_t progress_message_id{ 0 };
+		if (!created.is_error()) progress_message_id = created.get<dpp::message>().id;
+		else Logger::warn(false, "Couldn't post the `/role_add_bulk` progress message: {}", created.get_error().message);
+
+		json pending_ids(json::array());
+		for (const uint64_t user_id : user_ids) pending_ids.push_back(user_id);
+
+		const std::string job_id{ job_engine.start(bot, role_add_bulk_job_type, json{
+			{ "guild_id", static_cast<uint64_t>(g->id) },
+			{ "role_id", static_cast<uint64_t>(role_to_add->id) },
+			{ "from_role_id", from_role_id },
+			{ "issuer_id", static_cast<uint64_t>(issuer_member.user_id) },
+			{ "channel_id", channel_id },
+			{ "progress_message_id", progress_message_id },
+			{ "reason", get_reason_from_event(event) },
+			{ "collecting", from_role_id != 0 },
+			{ "pending", std::move(pending_ids) },
+			{ "started_at", unix_now() }
+		}) };
+
+		render::ReplyMeter meter{ "role_add_bulk" };
+		render::Arena arena{};
+
+		std::pmr::string reply{ arena.format("Started adding <@&{}> to ", static_cast<uint64_t>(role_to_add->id)) };
+		if (from_role_id != 0) render::Arena::format_to(reply, "every member with <@&{}>", from_role_id);
+		else render::Arena::format_to(reply, "{} users", user_ids.size());
+		render::Arena::format_to(reply, " (job `{}`). {}", job_id,
+			progress_message_id != 0 ? "Progress is posted in this channel." : "A summary is posted in the log channel once it's done.");
+		event.co_edit_original_response(dpp::message{ render::to_string(reply) }.set_flags(dpp::m_ephemeral));
+	}
+	catch (const dpp::exception& e) {
+		Logger::exception(false, "D++ exception thrown in `/role_add_bulk`: {}", std::string(e.what()));
+		event.co_edit_original_response(render::exception_reply());
+	}
+	catch (const std::exception& e) {
+		Logger::exception(false, "Standard exception thrown in `/role_add_bulk`: {}", std::string(e.what()));
+		event.co_edit_original_response(render::exception_reply());
+	}
+	catch (...) {
+		Logger::exception(false, "Unknown exception thrown in `/role_add_bulk`");
+		event.co_edit_original_response(render::exception_reply());
+	}
+}
+
+void register_role_add_bulk_command() {
+	commands[command_table::index_of("role_add_bulk")] = {
+		.coroutine = handle_role_add_bulk,
+		.description = "Adds a role to many members, in the background.",
+		.permissions = dpp::p_moderate_members, // Base permission
+		.is_restricted_to_owners = false, // Not restricted to dev guild
+		.options = {
+			dpp::command_option(dpp::co_role, "role", "The role to add", true),
+			dpp::command_option(dpp::co_role, "from_role", "Add the role to every member with this role", false),
+			dpp::command_option(dpp::co_string, "users", "User IDs or mentions to add the role to", false),
+			dpp::command_option(dpp::co_string, "reason", "The reason", false)
+		}
+	};
+
+	// Checkpointed jobs are rebuilt through this once a cluster is ready
+	job_engine.register_type(role_add_bulk_job_type, [](std::string id, const json& state) -> std::shared_ptr<Job> {
+		return std::make_shared<RoleAddBulkJob>(std::move(id), state);
+	});
+}
@@ -0,0 +1,155 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <string>
+ * #include <string_view>
+ * #include <memory_resource>
+ * #include <array>
+ * #include <vector>
+ * #include <format>
+ * #include <chrono>
+ * #include <exception>
+ * #include <variant>
+ * #include <cstdint>
+ * #include <ctime>
+ * #include <dpp/coro.h>
+ * #include <dpp/cluster.h>
+ * #include <dpp/dispatcher.h>
+ * #include <dpp/message.h>
+ * #include <dpp/permissions.h>
+ * #include <dpp/exception.h>
+ * #include <Ishmael.hpp>
+ * #include <commands/command_table.hpp>
+ * #include <commands/moderation/mod_utils.hpp>
+ * #include <commands/moderation/permission_cache.hpp>
+ * #include <commands/moderation/bulk_permissions.hpp>
+ * #include <utilities/render/render.hpp>
+ * #include <utilities/secrets/secrets.hpp>
+ */
+
+#include <pch.hpp>
+
+struct AuditedPermission {
+	std::string_view name;
+	uint64_t mask;
+};
+
+static constexpr std::array<AuditedPermission, 6> audited_permissions{ {
+	{ "moderate_members", dpp::p_moderate_members },
+	{ "ban_members", dpp::p_ban_members },
+	{ "kick_members", dpp::p_kick_members },
+	{ "manage_roles", dpp::p_manage_roles },
+	{ "manage_guild", dpp::p_manage_guild },
+	{ "administrator", dpp::p_administrator }
+} };
+
+// How many of the allowed members are mentioned in the reply
+static constexpr std::size_t listed_members{ 15 };
+
+static constexpr render::Template<1> member_mention{ "<@{}> " };
+static constexpr render::Template<1> and_more{ "and {} more" };
+
+static dpp::task<void> handle_perm_audit(dpp::cluster& bot, const dpp::slashcommand_t& event) {
+	try {
+		// The evaluation below can take longer than Discord waits for a first response on large servers
+		co_await event.co_thinking(true);
+		release_command_strand(event);
+
+		const std::string permission_name{ std::get<std::string>(event.get_parameter("permission")) };
+		uint64_t required{ 0 };
+		for (const AuditedPermission& p : audited_permissions) if (p.name == permission_name) required = p.mask;
+		if (required == 0) {
+			event.co_edit_original_response(dpp::message("Unknown permission.").set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		// Defaults to the server the command is used in
+		const auto guild_param{ event.get_parameter("guild_id") };
+		const uint64_t guild_id{ std::holds_alternative<std::string>(guild_param) ? std::stoull(std::get<std::string>(guild_param)) : static_cast<uint64_t>(event.command.guild_id) };
+
+		std::optional<PermissionTable> table{ permission_cache.snapshot(guild_id) };
+		if (!table.has_value()) {
+			event.co_edit_original_response(dpp::message("That server isn't cached.").set_flags(dpp::m_ephemeral));
+			co_return;
+		}
+
+		const std::size_t n{ table->size() };
+		std::vector<uint64_t> effective(n);
+		std::vector<uint8_t> allowed(n);
+
+		const auto bulk_start{ std::chrono::steady_clock::now() };
+		evaluate_permissions(table.value(), effective);
+		const std::size_t allowed_count{ evaluate_allowed(table.value(), effective, required, allowed) };
+		const auto bulk_time{ std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - bulk_start) };
+
+		// Only the rendering is metered, not the evaluation above
+		render::ReplyMeter meter{ "perm_audit" };
+		render::Arena arena{};
+
+		std::pmr::string members_str{ arena.string() };
+		std::size_t listed{ 0 };
+		for (std::size_t i{ 0 }; i < n && listed < listed_members; ++i) {
+			if (!allowed[i]) continue;
+			member_mention.append_to(members_str, table->member_ids[i]);
+			++listed;
+		}
+		if (allowed_count > listed) and_more.append_to(members_str, allowed_count - listed);
+		if (members_str.empty()) members_str = "None";
+
+		dpp::embed embed{ dpp::embed()
+			.set_colour(10298559) // Hex: #9D24BF
+			.set_title(std::format("Who has `{}`", permission_name))
+			.add_field("Members", std::format("`{}` of `{}` cached", allowed_count, n), true)
+			.add_field("Bulk Evaluation", std::format("`{} µs` ({})", bulk_time.count(), bulk_permissions_use_simd() ? "AVX2" : "scalar"), true)
+			.add_field("Allowed", render::to_string(members_str), false)
+			.set_footer(dpp::embed_footer()
+				.set_text(event.command.get_issuing_user().username)
+				.set_icon(event.command.get_issuing_user().get_avatar_url()))
+			.set_timestamp(time(0)) };
+		event.co_edit_original_response(dpp::message(event.command.channel_id, embed).set_flags(dpp::m_ephemeral));
+	}
+	catch (const dpp::exception& e) {
+		Logger::exception(false, "D++ exception thrown in `/perm_audit`: {}", std::string{ e.what() });
+		event.co_edit_original_response(render::exception_reply());
+	}
+	catch (const std::exception& e) {
+		Logger::exception(false, "Standard exception thrown in `/perm_audit`: {}", std::string{ e.what() });
+		event.co_edit_original_response(render::exception_reply());
+	}
+	catch (...) {
+		Logger::exception(false, "Unknown exception thrown in `/perm_audit`");
+		event.co_edit_original_response(render::exception_reply());
+	}
+}
+
+void register_perm_audit_command() {
+	dpp::command_option permission_option{ dpp::co_string, "permission", "The permission to audit", true };
+	for (const AuditedPermission& p : audited_permissions) permission_option.add_choice(dpp::command_option_choice{ std::string{ p.name }, std::string{ p.name } });
+
+	commands[command_table::index_of("perm_audit")] = {
+		.coroutine = handle_perm_audit,
+		.description = "Lists the members of a server that have a permission",
+		.permissions = dpp::p_manage_guild,
+		.is_restricted_to_owners = true,
+		.options = {
+			permission_option,
+			dpp::command_option(dpp::co_string, "guild_id", "The server to audit (defaults to this one)", false)
+		}
+	};
+}
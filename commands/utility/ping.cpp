@@ -30,48 +30,50 @@
  * #include <dpp/permissions.h>
  * #include <dpp/exception.h>
  * #include <Ishmael.hpp>
- * #include <utilities/secrets/secrets.hpp>
+ * #include <commands/command_table.hpp>
+ * #include <utilities/render/render.hpp>
  */
 
 #include <pch.hpp>
 
+static const render::EmbedTemplate ping_embed{ dpp::embed()
+	.set_colour(232700) // Hex: #038CFC
+	.set_title("Pong! :ping_pong:")
+	.add_field("Gateway Latency", "", true)
+	.add_field("API Latency", "", true) };
+
+static constexpr render::Template<1> latency_ms{ "`{} ms`" };
+
 static void handle_ping(dpp::cluster& bot, const dpp::slashcommand_t& event) {
 	try {
-		const dpp::discord_client* shard{ bot.get_shard((event.command.guild_id >> 22) % bot.numshards) };
+		render::ReplyMeter meter{ "ping" };
 
-		std::string gateway_latency_str{ "N/A" };
-		if (shard) gateway_latency_str = std::format("`{} ms`", std::to_string(static_cast<int>(shard->websocket_ping * 1000)));
+		const dpp::discord_client* shard{ bot.get_shard((event.command.guild_id >> 22) % bot.numshards) };
 
-		dpp::embed embed{ dpp::embed()
-			.set_colour(232700) // Hex: #038CFC
-			.set_title("Pong! :ping_pong:")
-			.add_field("Gateway Latency", gateway_latency_str, true)
-			.add_field("API Latency", std::format("`{} ms`", std::to_string(static_cast<int>(bot.rest_ping * 1000))), true)
-			.set_footer(dpp::embed_footer()
+		dpp::embed embed{ ping_embed(shard ? latency_ms(static_cast<int>(shard->websocket_ping * 1000)) : std::string{ "N/A" },
+			latency_ms(static_cast<int>(bot.rest_ping * 1000))) };
+		embed.set_footer(dpp::embed_footer()
 				.set_text(event.command.get_issuing_user().username)
 				.set_icon(event.command.get_issuing_user().get_avatar_url()))
-			.set_timestamp(time(0)) };
+			.set_timestamp(time(0));
 		event.reply(dpp::message(event.command.channel_id, embed).set_flags(dpp::m_ephemeral));
 	}
 	catch (const dpp::exception& e) {
 		Logger::exception(false, "D++ exception thrown in `/ping`: {}", std::string{ e.what() });
-		event.reply(dpp::message("An exception was thrown while processing this command. Please inform <@" + std::string{ secrets.at("OWNER_ID") } + "> of this.")
-			.set_flags(dpp::m_ephemeral));
+		event.reply(render::exception_reply());
 	}
 	catch (const std::exception& e) {
-		Logger::exception(false, "Standard exception thrown in `/ping`: {}", std::string{ e.what() });
-		event.reply(dpp::message("An exception was thrown while processing this command. Please inform <@" + std::string(secrets.at("OWNER_ID")) + "> of this.")
-			.set_flags(dpp::m_ephemeral));
+		Logger::exception(false, "Standard exception thrown in `/ping`: {}", std::string(e.what()));
+		event.reply(render::exception_reply());
 	}
 	catch (...) {
 		Logger::exception(false, "Unknown exception thrown in `/ping`");
-		event.reply(dpp::message("An exception was thrown while processing this command. Please inform <@" + std::string(secrets.at("OWNER_ID")) + "> of this.")
-			.set_flags(dpp::m_ephemeral));
+		event.reply(render::exception_reply());
 	}
 }
 
 void register_ping_command() {
-	commands["ping"] = {
+	commands[command_table::index_of("ping")] = {
 		.function = handle_ping,
 		.description = "Pong!",
 		.permissions = dpp::p_moderate_members,
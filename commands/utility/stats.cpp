@@ -18,6 +18,7 @@
 /*
  * The following includes are performed:
  * #include <string>
+ * #include <memory_resource>
  * #include <format>
  * #include <chrono>
  * #include <exception>
@@ -30,30 +31,111 @@
  * #include <dpp/exception.h>
  * #include <dpp/version.h>
  * #include <Ishmael.hpp>
+ * #include <commands/command_table.hpp>
  * #include <utilities/other_utils/other_utils.hpp>
+ * #include <utilities/executor/executor.hpp>
+ * #include <utilities/rest_scheduler/rest_scheduler.hpp>
+ * #include <commands/moderation/member_resolver.hpp>
+ * #include <commands/moderation/audit_batcher.hpp>
+ * #include <utilities/render/render.hpp>
  */
 
 #include <pch.hpp>
 
 extern std::chrono::steady_clock::time_point session_start_time;
 
+// Values that don't change while the bot runs are filled in here, once
+static const render::EmbedTemplate stats_embed{ dpp::embed()
+	.set_colour(10298559) // Hex: #9D24BF
+	.set_title("Bot Stats")
+	.add_field("Uptime", "", true)
+	.add_field("Servers", "", true)
+	.add_field("Users", "", true)
+	.add_field("API Latency", "", true)
+	.add_field("Shard", "", true)
+	.add_field("Handler Queue", "", false)
+	.add_field("REST Lanes", "", false)
+	.add_field("Member Cache", "", false)
+	.add_field("Audit Logs", "", false)
+	.add_field("Reply Allocations", "", false)
+	.add_field("Bot Version", "1.2.0", true)
+	.add_field("D++ Version", DPP_VERSION_TEXT, true) };
+
+static constexpr render::Template<1> latency_ms{ "`{} ms`" };
+static constexpr render::Template<2> shard_of{ "{} / {}" };
+
 static void handle_stats(dpp::cluster& bot, const dpp::slashcommand_t& event) {
 	try {
-		dpp::embed embed{ dpp::embed()
-			.set_colour(10298559) // Hex: #9D24BF
-			.set_title("Bot Stats")
-			.set_thumbnail(bot.me.get_avatar_url())
-			.add_field("Uptime", convert_time((std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - session_start_time)).count()), true)
-			.add_field("Servers", std::to_string(dpp::get_guild_count()), true)
-			.add_field("Users", std::to_string(dpp::get_user_count()), true)
-			.add_field("API Latency", std::format("`{} ms`", static_cast<int>(bot.rest_ping * 1000)), true)
-			.add_field("Shard", std::format("{} / {}", (event.command.guild_id >> 22) % bot.numshards, bot.numshards), true)
-			.add_field("Bot Version", "1.2.0", true)
-			.add_field("D++ Version", DPP_VERSION_TEXT, true)
+		render::ReplyMeter meter{ "stats" };
+		render::Arena arena{};
+
+		const uint32_t shard_id{ static_cast<uint32_t>((event.command.guild_id >> 22) % std::max<uint32_t>(bot.numshards, 1)) };
+
+		// Handler queue of this shard: depth / average wait / missed acknowledgement deadlines
+		std::string queue_str{ "N/A" };
+		for (const ShardQueueStats& stats : command_executor.get_shard_stats()) {
+			if (stats.shard_id != shard_id || stats.executed == 0) continue;
+			queue_str = std::format("`{}` queued, `{} ms` avg wait, `{}` / `{}` late", stats.queue_depth,
+				stats.total_wait.count() / 1000 / static_cast<int64_t>(stats.executed), stats.missed_deadlines, stats.executed);
+		}
+
+		// Outbound REST lanes: average queue latency and calls shed under pressure
+		std::pmr::string lanes_str{ arena.string() };
+		constexpr std::array<std::string_view, rest_lane_count> lane_names{ "Interaction", "Audit Log", "Background" };
+		const auto lane_stats{ rest_scheduler.get_lane_stats() };
+		for (std::size_t i{ 0 }; i < rest_lane_count; ++i) {
+			const int64_t avg_wait_ms{ lane_stats[i].dispatched == 0 ? 0 : lane_stats[i].total_wait.count() / 1000 / static_cast<int64_t>(lane_stats[i].dispatched) };
+			render::Arena::format_to(lanes_str, "{}: `{} ms` avg, `{}` shed\n", lane_names[i], avg_wait_ms, lane_stats[i].shed);
+		}
+
+		// Audit logs delivered through webhooks queue apart from the lanes above
+		const RestLaneStats webhook_stats{ webhook_scheduler.get_lane_stats()[static_cast<std::size_t>(RestLane::AuditLog)] };
+		if (webhook_stats.dispatched > 0) {
+			render::Arena::format_to(lanes_str, "Webhooks: `{} ms` avg, `{}` shed\n", webhook_stats.total_wait.count() / 1000 / static_cast<int64_t>(webhook_stats.dispatched), webhook_stats.shed);
+		}
+
+		// Member lookups served from memory, and the REST time that saved at the average REST latency
+		const MemberResolverStats member_stats{ member_resolver.get_stats() };
+		std::string members_str{ "N/A" };
+		if (member_stats.hits + member_stats.rest_fetches > 0) {
+			const int64_t avg_rest_us{ member_stats.rest_fetches == 0 ? 0 : member_stats.rest_latency.count() / static_cast<int64_t>(member_stats.rest_fetches) };
+			members_str = std::format("`{}%` hit rate (`{}` / `{}`, `{}` from interactions), ~`{} ms` saved", member_stats.hits * 100 / (member_stats.hits + member_stats.rest_fetches),
+				member_stats.hits, member_stats.hits + member_stats.rest_fetches, member_stats.interaction_hits, avg_rest_us * static_cast<int64_t>(member_stats.hits) / 1000);
+		}
+
+		// Audit log embeds per message sent, and the longest an embed waited to go out
+		const AuditBatcherStats audit_stats{ audit_batcher.get_stats() };
+		std::string audit_str{ "N/A" };
+		if (audit_stats.messages_sent > 0) {
+			audit_str = std::format("`{}` embeds in `{}` messages, `{} ms` worst delay", audit_stats.embeds_sent, audit_stats.messages_sent, audit_stats.max_delay.count());
+		}
+
+		// Heap allocations per reply, averaged per command
+		std::pmr::string replies_str{ arena.string() };
+		for (const render::ReplyStats& stats : render::get_reply_stats()) {
+			if (stats.replies == 0) continue;
+			render::Arena::format_to(replies_str, "`/{}`: `{:.1f}` per reply over `{}` replies\n", stats.command,
+				static_cast<double>(stats.allocations) / static_cast<double>(stats.replies), stats.replies);
+		}
+		if (!render::alloc_metrics_enabled) replies_str = "Not counted, build with `ISHMAEL_ALLOC_METRICS`";
+		else if (replies_str.empty()) replies_str = "N/A";
+
+		dpp::embed embed{ stats_embed(
+			convert_time((std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - session_start_time)).count()),
+			std::to_string(dpp::get_guild_count()),
+			std::to_string(dpp::get_user_count()),
+			latency_ms(static_cast<int>(bot.rest_ping * 1000)),
+			shard_of(shard_id, bot.numshards),
+			std::move(queue_str),
+			render::to_string(lanes_str),
+			std::move(members_str),
+			std::move(audit_str),
+			render::to_string(replies_str)) };
+		embed.set_thumbnail(bot.me.get_avatar_url())
 			.set_footer(dpp::embed_footer()
 				.set_text(event.command.get_issuing_user().username)
 				.set_icon(event.command.get_issuing_user().get_avatar_url()))
-			.set_timestamp(time(0)) };
+			.set_timestamp(time(0));
 		event.reply(dpp::message(event.command.channel_id, embed).set_flags(dpp::m_ephemeral));
 	}
 	catch (const dpp::exception& e) {
@@ -71,7 +153,7 @@ static void handle_stats(dpp::cluster& bot, const dpp::slashcommand_t& event) {
 }
 
 void register_stats_command() {
-	commands["stats"] = {
+	commands[command_table::index_of("stats")] = {
 		.function = handle_stats,
 		.description = "Display the current statistics of the bot",
 		.permissions = dpp::p_manage_guild,
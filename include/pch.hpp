@@ -28,9 +28,20 @@
 	#include <processenv.h>
 	#include <consoleapi.h>
 	#include <corecrt.h>
+	#include <io.h>
 #else
 	#include <termios.h>
 	#include <unistd.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/resource.h>
+	#include <sys/syscall.h>
+#endif
+
+// Only with `ISHMAEL_AVX2`, see `CMakeLists.txt`
+#if defined(__AVX2__)
+	#include <immintrin.h>
 #endif
 
 #include <iostream>
@@ -39,8 +50,16 @@
 #include <ios>
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <array>
+#include <deque>
+#include <list>
+#include <queue>
+#include <map>
 #include <unordered_map>
+#include <unordered_set>
+#include <functional>
 
 #include <algorithm>
 #include <exception>
@@ -49,22 +68,40 @@
 #include <variant>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
 #include <chrono>
 #include <thread>
 #include <atomic>
 #include <optional>
+#include <span>
+#include <bitset>
 #include <type_traits>
 #include <filesystem>
+#include <system_error>
 #include <format>
 #include <utility>
+#include <tuple>
+#include <bit>
+#include <random>
+#include <memory_resource>
+#include <charconv>
+#include <iterator>
+#include <limits>
 
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
 #include <cstdint>
 #include <ctime>
 
 #include <sodium/core.h>
 #include <sodium/crypto_secretstream_xchacha20poly1305.h>
 #include <sodium/utils.h>
+#include <sodium/crypto_generichash.h>
+
+#include <zstd.h>
 
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
 #include <spdlog/spdlog.h>
@@ -76,6 +113,7 @@
 #include <dpp/cache.h>
 #include <dpp/channel.h>
 #include <dpp/cluster.h>
+#include <dpp/coro.h>
 #include <dpp/discordclient.h>
 #include <dpp/dispatcher.h>
 #include <dpp/exception.h>
@@ -93,15 +131,35 @@
 #include <dpp/timer.h>
 #include <dpp/user.h>
 #include <dpp/version.h>
+#include <dpp/webhook.h>
 
 #include <secrets/secrets.hpp>
+#include <config/config.hpp>
 #include <other_utils/other_utils.hpp>
+#include <mapped_file/mapped_file.hpp>
+#include <guild_settings/guild_settings.hpp>
+#include <guild_settings/settings_state.hpp>
 #include <logger/logger.hpp>
 #include <exception/exception.hpp>
 #include <console_utils/console_utils.hpp>
+#include <executor/executor.hpp>
+#include <rest_scheduler/rest_scheduler.hpp>
+#include <shutdown/shutdown.hpp>
+#include <durable_file/durable_file.hpp>
+#include <backup/backup.hpp>
+#include <render/render.hpp>
+#include <jobs/jobs.hpp>
 
 #include <ICommands.hpp>
+#include <command_table.hpp>
+#include <command_registration.hpp>
 #include <moderation/mod_utils.hpp>
+#include <moderation/bulk_permissions.hpp>
+#include <moderation/permission_cache.hpp>
+#include <moderation/channel_permissions.hpp>
+#include <moderation/member_resolver.hpp>
+#include <moderation/audit_batcher.hpp>
+#include <moderation/mod_journal.hpp>
 
 #include <Ishmael.hpp>
 
@@ -0,0 +1,94 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * A settings log append that fails halfway must not take the next append down with it
+ * The failure is a real short write: the file size limit is lowered under the log for one append
+ * POSIX only, there is no file size limit to lower on Windows
+ *
+ * The following includes are performed:
+ * #include <iostream>
+ * #include <vector>
+ * #include <filesystem>
+ * #include <system_error>
+ * #include <csignal>
+ * #include <cstdint>
+ * #include <sys/resource.h> (POSIX only)
+ * #include <guild_settings/guild_settings.hpp>
+ */
+
+#include <pch.hpp>
+
+// CTest's `SKIP_RETURN_CODE`
+static constexpr int skipped{ 77 };
+
+static SettingsChange log_channel_change(const uint64_t guild_id) {
+	return SettingsChange{ .kind = SettingsChange::Kind::LogChannel, .guild_id = guild_id, .channel_id = guild_id + 1, .command_type = CommandType::RoleEdit };
+}
+
+static bool check(const bool condition, const std::string_view what) {
+	if (!condition) std::cerr << "FAILED: " << what << '\n';
+	return condition;
+}
+
+int main() {
+#ifdef _WIN32
+	std::cout << "Skipped, needs a file size limit\n";
+	return skipped;
+#else // ^^^ _WIN32 || !_WIN32 vvv
+	const std::filesystem::path dir{ std::filesystem::temp_directory_path() / "ishmael_settings_log_test" };
+	std::error_code ec{};
+	std::filesystem::remove_all(dir, ec);
+	std::filesystem::create_directories(dir);
+	const std::filesystem::path base{ dir / "guild_settings.wal" };
+
+	// Going over the limit fails the write with EFBIG instead of killing the process
+	std::signal(SIGXFSZ, SIG_IGN);
+	rlimit original{};
+	getrlimit(RLIMIT_FSIZE, &original);
+
+	bool passed{ true };
+	{
+		SettingsLog log{};
+		log.open(base);
+		passed &= check(log.append(log_channel_change(100)), "the first append succeeds");
+
+		// Room for the record prefix and a few bytes of the payload
+		rlimit limited{ original };
+		limited.rlim_cur = static_cast<rlim_t>(log.size() + 12);
+		setrlimit(RLIMIT_FSIZE, &limited);
+		passed &= check(!log.append(log_channel_change(200)), "the append over the limit fails");
+		setrlimit(RLIMIT_FSIZE, &original);
+
+		passed &= check(log.append(log_channel_change(300)), "the append after the failed one succeeds");
+		log.close();
+	}
+
+	// The failed record is gone, the one after it is replayed
+	{
+		SettingsLog log{};
+		const std::vector<SettingsChange> replayed{ log.open(base) };
+		passed &= check(replayed.size() == 2, "two changes are replayed");
+		passed &= check(replayed.size() == 2 && replayed[0].guild_id == 100 && replayed[1].guild_id == 300, "the replayed changes are the good ones, in order");
+		log.close();
+	}
+
+	std::filesystem::remove_all(dir, ec);
+	std::cout << (passed ? "Passed\n" : "Failed\n");
+	return passed ? 0 : 1;
+#endif // _WIN32
+}
@@ -0,0 +1,133 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Identical `/role_add`s running at the same time, or one right after the other, must add the role and post the audit log once
+ * The operation is shaped like `/role_add`'s coalesced stage: a role REST call, then the audit log
+ * Its REST call completes when the test says so, which keeps the requests overlapping
+ *
+ * The following includes are performed:
+ * #include <iostream>
+ * #include <string>
+ * #include <string_view>
+ * #include <vector>
+ * #include <functional>
+ * #include <stdexcept>
+ * #include <chrono>
+ * #include <thread>
+ * #include <dpp/coro.h>
+ * #include <moderation/mod_utils.hpp>
+ */
+
+#include <pch.hpp>
+
+static constexpr std::chrono::milliseconds remember_for{ 200 };
+
+// The callbacks of the role REST calls that haven't completed yet
+static std::vector<std::function<void(bool)>> pending_calls{};
+static int add_role_calls{ 0 };
+static int audit_embeds{ 0 };
+
+static void complete_pending_calls(const bool succeeded) {
+	std::vector<std::function<void(bool)>> calls{};
+	calls.swap(pending_calls);
+	for (const auto& call : calls) call(succeeded);
+}
+
+static dpp::task<std::string> add_role() {
+	++add_role_calls;
+	const bool succeeded{ co_await dpp::async<bool>{ [](std::function<void(bool)> callback) { pending_calls.push_back(std::move(callback)); } } };
+	if (!succeeded) throw std::runtime_error("The role couldn't be added");
+
+	++audit_embeds;
+	co_return std::string{ "Successfully added the role" };
+}
+
+// A request's outcome, read once its job is done
+struct Reply {
+	std::string text;
+	bool failed{ false };
+	bool done{ false };
+};
+
+// `dpp::job` takes its parameters by value, hence the pointers
+static dpp::job request(SingleFlight<std::string>* flights, const ModerationKey key, Reply* reply) {
+	try {
+		reply->text = co_await flights->run(key, [] { return add_role(); });
+	}
+	catch (const std::exception&) {
+		reply->failed = true;
+	}
+	reply->done = true;
+}
+
+static bool check(const bool condition, const std::string_view what) {
+	if (!condition) std::cerr << "FAILED: " << what << '\n';
+	return condition;
+}
+
+int main() {
+	SingleFlight<std::string> flights{ remember_for };
+	const ModerationKey key{ .guild_id = 1, .target_id = 2, .action = ModerationAction::RoleAdd, .object_id = 3 };
+	const ModerationKey other_role{ .guild_id = 1, .target_id = 2, .action = ModerationAction::RoleAdd, .object_id = 4 };
+
+	bool passed{ true };
+
+	// Two moderators at once, and a different role for the same member
+	Reply first{}, second{}, other{};
+	request(&flights, key, &first);
+	request(&flights, key, &second);
+	request(&flights, other_role, &other);
+	passed &= check(add_role_calls == 2, "the identical requests make one role call between them");
+	passed &= check(!first.done && !second.done, "both wait for the role call");
+
+	complete_pending_calls(true);
+	passed &= check(first.done && second.done && other.done, "all requests finish with their role call");
+	passed &= check(first.text == second.text && !first.text.empty(), "the identical requests get the same reply");
+	passed &= check(audit_embeds == 2, "one audit embed per distinct request");
+
+	// A second click right after the first finished
+	Reply repeated{};
+	request(&flights, key, &repeated);
+	passed &= check(repeated.done && repeated.text == first.text, "a request right after gets the finished result");
+	passed &= check(add_role_calls == 2 && audit_embeds == 2, "it makes no role call and posts no audit embed");
+
+	// Long after, it runs again
+	std::this_thread::sleep_for(remember_for * 2);
+	Reply later{};
+	request(&flights, key, &later);
+	passed &= check(add_role_calls == 3, "a request after the window makes its own role call");
+	complete_pending_calls(true);
+	passed &= check(later.done && audit_embeds == 3, "and posts its own audit embed");
+
+	// A failed call fails every request coalesced into it, and isn't remembered
+	const ModerationKey failing{ .guild_id = 1, .target_id = 5, .action = ModerationAction::RoleAdd, .object_id = 3 };
+	Reply failed_first{}, failed_second{};
+	request(&flights, failing, &failed_first);
+	request(&flights, failing, &failed_second);
+	complete_pending_calls(false);
+	passed &= check(failed_first.failed && failed_second.failed, "both requests fail with the role call");
+
+	Reply retried{};
+	request(&flights, failing, &retried);
+	passed &= check(add_role_calls == 5, "a retry after a failure makes a new role call");
+	complete_pending_calls(true);
+	passed &= check(retried.done && !retried.failed && audit_embeds == 4, "and succeeds");
+
+	std::cout << (passed ? "Passed\n" : "Failed\n");
+	return passed ? 0 : 1;
+}
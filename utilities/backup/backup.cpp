@@ -0,0 +1,566 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <Windows.h> (Windows only)
+ * #include <sys/resource.h> (Linux only)
+ * #include <sys/syscall.h> (Linux only)
+ * #include <unistd.h> (Linux only)
+ * #include <array>
+ * #include <vector>
+ * #include <string>
+ * #include <string_view>
+ * #include <span>
+ * #include <optional>
+ * #include <unordered_set>
+ * #include <algorithm>
+ * #include <fstream>
+ * #include <iterator>
+ * #include <filesystem>
+ * #include <system_error>
+ * #include <charconv>
+ * #include <chrono>
+ * #include <format>
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <thread>
+ * #include <exception>
+ * #include <cstdio>
+ * #include <cstring>
+ * #include <cstdlib>
+ * #include <cstdint>
+ * #include <sodium/crypto_generichash.h>
+ * #include <sodium/utils.h>
+ * #include <zstd.h>
+ * #include <Ishmael.hpp>
+ * #include <backup/backup.hpp>
+ * #include <guild_settings/guild_settings.hpp>
+ * #include <other_utils/other_utils.hpp>
+ * #include <durable_file/durable_file.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+BackupEngine backup_engine;
+
+static const std::filesystem::path backup_root{ "backups/store" };
+
+// A backup asked for after a checkpoint waits until this long after the previous one
+static constexpr std::chrono::minutes backup_min_spacing{ 5 };
+
+// Retention: every generation of the last day, then the newest of each UTC day for 30 days
+static constexpr int64_t keep_all_for{ static_cast<int64_t>(one_day) };
+static constexpr int64_t keep_daily_for{ static_cast<int64_t>(one_day) * 30 };
+
+// The engine runs in the background, so it can afford a slower, tighter level
+static constexpr int zstd_level{ 9 };
+
+// Content-defined chunking: a chunk ends where the rolling hash has its top 17 bits clear,
+// so an inserted guild only changes the chunks around it instead of shifting every later one
+static constexpr std::size_t min_chunk_size{ 32 * 1024 };
+static constexpr std::size_t max_chunk_size{ 512 * 1024 };
+static constexpr uint64_t chunk_cut_mask{ ((1ull << 17) - 1) << 47 }; // ~128 KiB on average past the minimum
+
+static constexpr std::array<uint64_t, 256> gear_table{ [] {
+	// SplitMix64 from a fixed seed, the cut points have to be the same on every run
+	std::array<uint64_t, 256> table{};
+	uint64_t state{ 0x4953484D41454C31ull };
+	for (uint64_t& value : table) {
+		uint64_t z{ state += 0x9E3779B97F4A7C15ull };
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		value = z ^ (z >> 31);
+	}
+	return table;
+}() };
+
+using ContentHash = std::array<uint8_t, 16>;
+
+struct ManifestHeader {
+	std::array<char, 8> magic{};
+	uint32_t version{ 0 };
+	uint32_t chunk_count{ 0 };
+	int64_t created{ 0 }; // Unix seconds, also the name of the generation
+	uint64_t size{ 0 };
+	ContentHash hash{}; // Of the whole snapshot
+};
+
+struct ManifestChunk {
+	ContentHash hash{};
+	uint32_t size{ 0 };
+	uint32_t reserved{ 0 };
+};
+
+static_assert(sizeof(ManifestHeader) == 48 && sizeof(ManifestChunk) == 24);
+
+// On disk: the header, the chunks in order, then the CRC-32 of both
+struct Manifest {
+	ManifestHeader header{};
+	std::vector<ManifestChunk> chunks{};
+};
+
+static constexpr std::array<char, 8> manifest_magic{ 'I', 'S', 'H', 'B', 'K', 'U', 'P', '\0' };
+static constexpr uint32_t manifest_version{ 1 };
+
+static int64_t unix_now() {
+	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// BLAKE2b-128
+static ContentHash hash_of(const std::span<const uint8_t> data) {
+	ContentHash hash{};
+	crypto_generichash(hash.data(), hash.size(), data.data(), data.size(), nullptr, 0);
+	return hash;
+}
+
+static std::string to_hex(const ContentHash& hash) {
+	std::array<char, sizeof(ContentHash) * 2 + 1> hex{};
+	sodium_bin2hex(hex.data(), hex.size(), hash.data(), hash.size());
+	return std::string{ hex.data() };
+}
+
+static std::filesystem::path chunk_path(const ContentHash& hash) {
+	return backup_root / "chunks" / (to_hex(hash) + ".zst");
+}
+
+static std::filesystem::path manifest_path(const int64_t created) {
+	return backup_root / "generations" / (std::to_string(created) + ".manifest");
+}
+
+// Offsets and lengths of the chunks of `data`
+static std::vector<std::pair<std::size_t, std::size_t>> split_chunks(const std::span<const uint8_t> data) {
+	std::vector<std::pair<std::size_t, std::size_t>> chunks{};
+	std::size_t start{ 0 };
+
+	while (start < data.size()) {
+		const std::size_t limit{ std::min(data.size() - start, max_chunk_size) };
+		std::size_t length{ limit };
+
+		// Gear hash, each byte shifts the older ones out after 64 steps
+		uint64_t h{ 0 };
+		for (std::size_t i{ min_chunk_size }; i < limit; ++i) {
+			h = (h << 1) + gear_table[data[start + i]];
+			if ((h & chunk_cut_mask) == 0) {
+				length = i + 1;
+				break;
+			}
+		}
+
+		chunks.emplace_back(start, length);
+		start += length;
+	}
+	return chunks;
+}
+
+static std::string read_whole_file(const std::filesystem::path& path) {
+	std::ifstream file{ path, std::ios::binary };
+	return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+static std::optional<Manifest> read_manifest(const std::filesystem::path& path) {
+	const std::string data{ read_whole_file(path) };
+	if (data.size() < sizeof(ManifestHeader) + sizeof(uint32_t)) return std::nullopt;
+
+	uint32_t checksum{ 0 };
+	std::memcpy(&checksum, data.data() + data.size() - sizeof(checksum), sizeof(checksum));
+	if (crc32(data.data(), data.size() - sizeof(checksum)) != checksum) return std::nullopt;
+
+	Manifest manifest{};
+	std::memcpy(&manifest.header, data.data(), sizeof(ManifestHeader));
+	if (manifest.header.magic != manifest_magic || manifest.header.version != manifest_version
+		|| data.size() != sizeof(ManifestHeader) + manifest.header.chunk_count * sizeof(ManifestChunk) + sizeof(checksum)) return std::nullopt;
+
+	manifest.chunks.resize(manifest.header.chunk_count);
+	std::memcpy(manifest.chunks.data(), data.data() + sizeof(ManifestHeader), manifest.chunks.size() * sizeof(ManifestChunk));
+	return manifest;
+}
+
+static bool write_manifest(const Manifest& manifest) {
+	std::string data(sizeof(ManifestHeader) + manifest.chunks.size() * sizeof(ManifestChunk), '\0');
+	std::memcpy(data.data(), &manifest.header, sizeof(ManifestHeader));
+	std::memcpy(data.data() + sizeof(ManifestHeader), manifest.chunks.data(), manifest.chunks.size() * sizeof(ManifestChunk));
+
+	const uint32_t checksum{ crc32(data.data(), data.size()) };
+	data.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+	return write_file_atomically(manifest_path(manifest.header.created), data);
+}
+
+// Every generation in the store by creation time and manifest path, newest first
+static std::vector<std::pair<int64_t, std::filesystem::path>> list_manifests() {
+	std::vector<std::pair<int64_t, std::filesystem::path>> manifests{};
+
+	std::error_code ec{};
+	for (const auto& file : std::filesystem::directory_iterator{ backup_root / "generations", ec }) {
+		if (file.path().extension() != ".manifest") continue;
+
+		const std::string stem{ file.path().stem().string() };
+		int64_t created{ 0 };
+		const auto [end, error] { std::from_chars(stem.data(), stem.data() + stem.size(), created) };
+		if (error == std::errc{} && end == stem.data() + stem.size()) manifests.emplace_back(created, file.path());
+	}
+
+	std::sort(manifests.begin(), manifests.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+	return manifests;
+}
+
+// Reads and decompresses a chunk. Returns nothing if it's missing or doesn't match its hash
+static std::optional<std::vector<uint8_t>> read_chunk(const ManifestChunk& chunk) {
+	std::error_code ec{};
+	const std::filesystem::path path{ chunk_path(chunk.hash) };
+	if (!std::filesystem::exists(path, ec)) return std::nullopt;
+
+	const std::string compressed{ read_whole_file(path) };
+	std::vector<uint8_t> data(chunk.size);
+	const std::size_t size{ ZSTD_decompress(data.data(), data.size(), compressed.data(), compressed.size()) };
+	if (ZSTD_isError(size) || size != data.size() || hash_of(data) != chunk.hash) return std::nullopt;
+	return data;
+}
+
+static void apply_retention(const int64_t now) {
+	std::unordered_set<std::string> referenced{};
+	std::optional<int64_t> last_kept_day{};
+	std::size_t removed_generations{ 0 };
+	bool newest{ true };
+	std::error_code ec{};
+
+	for (const auto& [created, path] : list_manifests()) {
+		const int64_t age{ now - created };
+		const int64_t day{ created / static_cast<int64_t>(one_day) };
+
+		// Newest first, so the first generation seen of a day is its newest
+		const bool keep{ newest || age < keep_all_for || (age < keep_daily_for && day != last_kept_day) };
+		newest = false;
+
+		if (!keep) {
+			std::filesystem::remove(path, ec);
+			++removed_generations;
+			continue;
+		}
+		last_kept_day = day;
+
+		const std::optional<Manifest> manifest{ read_manifest(path) };
+		if (!manifest) {
+			Logger::warn(true, "Backup generation {} has a damaged manifest", created);
+			continue;
+		}
+		for (const ManifestChunk& chunk : manifest->chunks) referenced.insert(to_hex(chunk.hash) + ".zst");
+	}
+
+	// Chunks of removed generations, and of backups that were cut short
+	std::vector<std::filesystem::path> unreferenced{};
+	for (const auto& file : std::filesystem::directory_iterator{ backup_root / "chunks", ec }) {
+		if (!referenced.contains(file.path().filename().string())) unreferenced.push_back(file.path());
+	}
+	for (const std::filesystem::path& path : unreferenced) std::filesystem::remove(path, ec);
+
+	if (removed_generations > 0 || !unreferenced.empty())
+		Logger::info(true, "Backup retention removed {} generations and {} chunks", removed_generations, unreferenced.size());
+}
+
+static void lower_thread_priority() {
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+	// The nice value is per thread on Linux, the rest of the process keeps its priority
+	setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif // _WIN32
+}
+
+BackupEngine::~BackupEngine() {
+	stop();
+}
+
+void BackupEngine::start() {
+	{
+		std::scoped_lock lock{ mtx };
+		if (running) return;
+		running = true;
+		// The first backup runs right away, so a fresh start is covered
+		requested = true;
+	}
+	stopping.store(false);
+	worker = std::thread{ [this] { run(); } };
+}
+
+void BackupEngine::stop() {
+	{
+		std::scoped_lock lock{ mtx };
+		if (!running) return;
+		running = false;
+	}
+	stopping.store(true);
+	cv.notify_all();
+	if (worker.joinable()) worker.join();
+}
+
+void BackupEngine::request() {
+	{
+		std::scoped_lock lock{ mtx };
+		if (!running) return;
+		requested = true;
+	}
+	cv.notify_one();
+}
+
+void BackupEngine::run() {
+	lower_thread_priority();
+
+	std::optional<std::chrono::steady_clock::time_point> last_backup{};
+	std::unique_lock lock{ mtx };
+
+	while (running) {
+		// Every hour on the hour, or when asked
+		const std::chrono::seconds to_next_hour{ static_cast<int64_t>(one_hour) - unix_now() % static_cast<int64_t>(one_hour) };
+		cv.wait_for(lock, to_next_hour, [this] { return !running || requested; });
+		if (!running) break;
+
+		// Requests are spaced out, busy guilds would otherwise cause a backup per checkpoint
+		if (requested && last_backup.has_value() && cv.wait_until(lock, last_backup.value() + backup_min_spacing, [this] { return !running; })) break;
+		requested = false;
+
+		lock.unlock();
+		try {
+			back_up();
+		}
+		catch (const std::exception& e) {
+			Logger::exception(true, "Exception during a settings backup: {}", e.what());
+		}
+		last_backup = std::chrono::steady_clock::now();
+		lock.lock();
+	}
+}
+
+void BackupEngine::back_up() {
+	// Read through the mapping, writers and readers aren't held up
+	const std::shared_ptr<const GuildSettingsSnapshot> snapshot{ checkpointed_guild_settings() };
+	const std::span<const uint8_t> data{ snapshot->bytes() };
+	if (data.empty()) return; // No settings were ever written
+
+	const auto started{ std::chrono::steady_clock::now() };
+	const ContentHash hash{ hash_of(data) };
+	int64_t created{ unix_now() };
+
+	const std::vector<std::pair<int64_t, std::filesystem::path>> manifests{ list_manifests() };
+	if (!manifests.empty()) {
+		const std::optional<Manifest> latest{ read_manifest(manifests.front().second) };
+		if (latest && latest->header.hash == hash) {
+			Logger::info(false, "Settings unchanged since backup generation {}, skipped", latest->header.created);
+			return;
+		}
+		created = std::max(created, manifests.front().first + 1);
+	}
+
+	Manifest manifest{ .header = ManifestHeader{ .magic = manifest_magic, .version = manifest_version, .created = created, .size = data.size(), .hash = hash } };
+	std::size_t new_chunks{ 0 }, new_bytes{ 0 };
+	std::vector<uint8_t> compressed{};
+	std::error_code ec{};
+
+	for (const auto& [offset, length] : split_chunks(data)) {
+		// What was stored so far is collected by the next retention pass
+		if (stopping.load()) return;
+
+		const std::span<const uint8_t> chunk{ data.subspan(offset, length) };
+		const ManifestChunk entry{ .hash = hash_of(chunk), .size = static_cast<uint32_t>(length) };
+		manifest.chunks.push_back(entry);
+
+		// Already stored by an earlier generation
+		const std::filesystem::path path{ chunk_path(entry.hash) };
+		if (std::filesystem::exists(path, ec)) continue;
+
+		compressed.resize(ZSTD_compressBound(chunk.size()));
+		const std::size_t compressed_size{ ZSTD_compress(compressed.data(), compressed.size(), chunk.data(), chunk.size(), zstd_level) };
+		if (ZSTD_isError(compressed_size)) {
+			Logger::error(true, "Couldn't compress a backup chunk: {}", ZSTD_getErrorName(compressed_size));
+			return;
+		}
+		if (!write_file_atomically(path, std::string_view{ reinterpret_cast<const char*>(compressed.data()), compressed_size })) return;
+
+		++new_chunks;
+		new_bytes += compressed_size;
+	}
+
+	manifest.header.chunk_count = static_cast<uint32_t>(manifest.chunks.size());
+	if (!write_manifest(manifest)) return;
+
+	Logger::info(true, "Backed up the settings as generation {} in {} ms: {} chunks, {} new ({} KiB compressed)", created,
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count(),
+		manifest.chunks.size(), new_chunks, new_bytes / 1024);
+
+	apply_retention(created);
+}
+
+static int list_backups() {
+	const std::vector<std::pair<int64_t, std::filesystem::path>> manifests{ list_manifests() };
+	if (manifests.empty()) Logger::info(true, "No backups in {}", backup_root.string());
+
+	for (const auto& [created, path] : manifests) {
+		const std::string when{ std::format("{:%Y-%m-%d %H:%M:%S}", std::chrono::sys_seconds{ std::chrono::seconds{ created } }) };
+		const std::optional<Manifest> manifest{ read_manifest(path) };
+		if (!manifest) Logger::error(true, "Generation {} ({} UTC): damaged manifest", created, when);
+		else Logger::info(true, "Generation {} ({} UTC): {} bytes in {} chunks", created, when, manifest->header.size, manifest->chunks.size());
+	}
+	return EXIT_SUCCESS;
+}
+
+static int verify_backups() {
+	const auto started{ std::chrono::steady_clock::now() };
+	const std::vector<std::pair<int64_t, std::filesystem::path>> manifests{ list_manifests() };
+
+	// Generations share most of their chunks, each one is only checked once
+	std::unordered_set<std::string> intact_chunks{}, damaged_chunks{};
+	std::size_t damaged_generations{ 0 };
+
+	for (const auto& [created, path] : manifests) {
+		const std::optional<Manifest> manifest{ read_manifest(path) };
+		if (!manifest) {
+			Logger::error(true, "Generation {}: the manifest is damaged", created);
+			++damaged_generations;
+			continue;
+		}
+
+		bool intact{ true };
+		uint64_t total_size{ 0 };
+		for (const ManifestChunk& chunk : manifest->chunks) {
+			total_size += chunk.size;
+			const std::string name{ to_hex(chunk.hash) };
+			if (intact_chunks.contains(name)) continue;
+
+			if (damaged_chunks.contains(name) || !read_chunk(chunk).has_value()) {
+				damaged_chunks.insert(name);
+				Logger::error(true, "Generation {}: chunk {} is missing or damaged", created, name);
+				intact = false;
+			}
+			else intact_chunks.insert(name);
+		}
+
+		if (intact && total_size != manifest->header.size) {
+			Logger::error(true, "Generation {}: its chunks add up to {} bytes, the snapshot had {}", created, total_size, manifest->header.size);
+			intact = false;
+		}
+		if (!intact) ++damaged_generations;
+	}
+
+	Logger::info(true, "Verified {} generations and {} chunks in {} ms, {} damaged", manifests.size(), intact_chunks.size() + damaged_chunks.size(),
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count(), damaged_generations);
+	return damaged_generations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int restore_backup(const std::optional<int64_t> generation, const std::filesystem::path& output) {
+	const std::vector<std::pair<int64_t, std::filesystem::path>> manifests{ list_manifests() };
+	const auto chosen{ std::find_if(manifests.begin(), manifests.end(), [&generation](const auto& entry) { return !generation.has_value() || entry.first == generation.value(); }) };
+	if (chosen == manifests.end()) {
+		Logger::error(true, "No backup generation {} in {}", generation.has_value() ? std::to_string(generation.value()) : std::string{ "at all" }, backup_root.string());
+		return EXIT_FAILURE;
+	}
+
+	const std::optional<Manifest> manifest{ read_manifest(chosen->second) };
+	if (!manifest) {
+		Logger::error(true, "Generation {}: the manifest is damaged", chosen->first);
+		return EXIT_FAILURE;
+	}
+
+	// A `.json` output gets a JSON export, restored from a temporary snapshot next to it
+	const bool to_json{ output.extension() == ".json" };
+	std::filesystem::path snapshot_output{ output };
+	if (to_json) snapshot_output += ".snapshot";
+
+	// Checked against the whole snapshot hash before it's renamed into place
+	const bool restored{ write_file_atomically(snapshot_output, [&manifest](std::FILE* out) {
+		crypto_generichash_state state{};
+		crypto_generichash_init(&state, nullptr, 0, sizeof(ContentHash));
+
+		for (const ManifestChunk& chunk : manifest->chunks) {
+			const std::optional<std::vector<uint8_t>> data{ read_chunk(chunk) };
+			if (!data) {
+				Logger::error(true, "Chunk {} is missing or damaged", to_hex(chunk.hash));
+				return false;
+			}
+			crypto_generichash_update(&state, data->data(), data->size());
+			if (std::fwrite(data->data(), 1, data->size(), out) != data->size()) return false;
+		}
+
+		ContentHash hash{};
+		crypto_generichash_final(&state, hash.data(), hash.size());
+		if (hash != manifest->header.hash) Logger::error(true, "The restored snapshot doesn't match its hash");
+		return hash == manifest->header.hash;
+	}) };
+	if (!restored) {
+		Logger::error(true, "Generation {} couldn't be restored", chosen->first);
+		return EXIT_FAILURE;
+	}
+
+	std::error_code ec{};
+	if (to_json) {
+		bool exported{ false };
+		{
+			GuildSettingsSnapshot snapshot{};
+			if (snapshot.open(snapshot_output)) {
+				GuildSettingsMap settings{};
+				snapshot.for_each([&settings](const uint64_t guild_id, const GuildSettingsRecord& record) { settings.get_or_insert(guild_id) = record.decode(); });
+				exported = write_file_atomically(output, guild_settings_to_json(settings).dump(4));
+			}
+			// A generation backed up before the current format
+			else if (const auto legacy{ GuildSettingsSnapshot::read_legacy(snapshot_output) }) exported = write_file_atomically(output, guild_settings_to_json(*legacy).dump(4));
+		}
+		std::filesystem::remove(snapshot_output, ec);
+
+		if (!exported) {
+			Logger::error(true, "Generation {} couldn't be exported to {}", chosen->first, output.string());
+			return EXIT_FAILURE;
+		}
+	}
+
+	// The log holds changes made after the generation, replaying them over it would mix the two
+	if (std::filesystem::equivalent(output, guild_settings_snapshot_path, ec)) {
+		SettingsLog log{};
+		log.discard(guild_settings_log_path);
+	}
+
+	Logger::success(std::format("Restored generation {} to {}", chosen->first, output.string()));
+	return EXIT_SUCCESS;
+}
+
+int run_backup_tool(const std::vector<std::string_view>& args) {
+	try {
+		if (!args.empty() && args[0] == "--list-backups") return list_backups();
+		if (!args.empty() && args[0] == "--verify-backups") return verify_backups();
+		if (!args.empty() && args[0] == "--restore-backup") {
+			std::optional<int64_t> generation{};
+			if (args.size() > 1 && args[1] != "latest") {
+				int64_t value{ 0 };
+				const auto [end, error] { std::from_chars(args[1].data(), args[1].data() + args[1].size(), value) };
+				if (error != std::errc{} || end != args[1].data() + args[1].size()) {
+					Logger::error(true, "`{}` isn't a backup generation", args[1]);
+					return EXIT_FAILURE;
+				}
+				generation = value;
+			}
+
+			const std::filesystem::path output{ args.size() > 2 ? std::filesystem::path{ args[2] } : std::filesystem::path{ guild_settings_snapshot_path } };
+			return restore_backup(generation, output);
+		}
+	}
+	catch (const std::exception& e) {
+		Logger::exception(true, "Exception in the backup tool: {}", e.what());
+		return EXIT_FAILURE;
+	}
+
+	Logger::error(true, "Unknown option `{}`, expected --list-backups, --verify-backups or --restore-backup [generation|latest] [output]", args.empty() ? std::string_view{} : args[0]);
+	return EXIT_FAILURE;
+}
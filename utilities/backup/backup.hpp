@@ -0,0 +1,84 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BACKUP_HPP
+#define BACKUP_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <vector>
+ * #include <string_view>
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <thread>
+ * #include <atomic>
+ */
+
+#include <pch.hpp>
+
+/*
+ * @brief Backs up the settings snapshot into a deduplicated, compressed store under `backups/store/`
+ *
+ * The snapshot is split into content-defined chunks, so a change only touches the chunks
+ * around it. Each chunk is stored once, zstd compressed and named by its BLAKE2b hash
+ * A generation is a manifest listing the chunks of one snapshot, a snapshot equal to the
+ * newest generation isn't stored again. Old generations are thinned out by a retention
+ * policy and chunks no generation refers to are deleted
+ *
+ * Backups run on a dedicated low priority thread: every hour, and after a checkpoint
+ * wrote a new snapshot (no more often than every few minutes). The snapshot is read
+ * through its mapping, no settings lock is held meanwhile
+ */
+class BackupEngine {
+public:
+	BackupEngine() = default;
+	BackupEngine(const BackupEngine&) = delete;
+	BackupEngine& operator=(const BackupEngine&) = delete;
+	~BackupEngine();
+
+	void start();
+	// A backup in progress is abandoned, the chunks it stored are collected later
+	void stop();
+
+	// Asks for a backup soon, requests made while one is pending are merged into it
+	void request();
+
+private:
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::thread worker;
+	bool running{ false };
+	bool requested{ false };
+	std::atomic_bool stopping{ false };
+
+	void run();
+	void back_up();
+};
+
+extern BackupEngine backup_engine;
+
+/*
+ * @brief Backup maintenance from the command line, run instead of the bot
+ *
+ * `--list-backups`, `--verify-backups` and `--restore-backup [generation] [output]`
+ * @return The process exit code
+ */
+int run_backup_tool(const std::vector<std::string_view>& args);
+
+#endif // BACKUP_HPP
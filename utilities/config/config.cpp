@@ -0,0 +1,66 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <fstream>
+ * #include <string>
+ * #include <string_view>
+ * #include <unordered_map>
+ * #include <charconv>
+ * #include <chrono>
+ * #include <cstdint>
+ * #include <config/config.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+const std::unordered_map<std::string, std::string> config{ []() -> std::unordered_map<std::string, std::string> {
+	std::unordered_map<std::string, std::string> values{};
+
+	std::ifstream file{ "config.txt" };
+	if (!file.is_open()) return values;
+
+	std::string line{};
+	while (std::getline(file, line)) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line.empty() || line.front() == '#') continue;
+
+		const std::size_t split{ line.find('=') };
+		if (split == std::string::npos) {
+			Logger::warn("Ignored a line without `=` in `config.txt`: " + line);
+			continue;
+		}
+		values.insert_or_assign(line.substr(0, split), line.substr(split + 1));
+	}
+	return values;
+}() };
+
+std::chrono::milliseconds config_milliseconds(const std::string_view key, const std::chrono::milliseconds fallback) {
+	const auto it{ config.find(std::string{ key }) };
+	if (it == config.end()) return fallback;
+
+	uint64_t value{ 0 };
+	const std::string& text{ it->second };
+	const auto [end, ec] { std::from_chars(text.data(), text.data() + text.size(), value) };
+	if (ec != std::errc{} || end != text.data() + text.size()) {
+		Logger::warn(true, "`{}` in `config.txt` isn't a number of milliseconds, using {} ms", key, fallback.count());
+		return fallback;
+	}
+	return std::chrono::milliseconds{ value };
+}
@@ -0,0 +1,44 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <string>
+ * #include <string_view>
+ * #include <unordered_map>
+ * #include <chrono>
+ */
+
+#include <pch.hpp>
+
+/*
+ * @brief Optional settings, read once from `config.txt` next to the executable
+ *
+ * Each line is `KEY=value`, like the decrypted secrets, lines starting with `#` are ignored
+ * Unlike the secrets the file is plain text and may be missing, every setting has a built-in default
+ */
+extern const std::unordered_map<std::string, std::string> config;
+
+// Reads a whole number of milliseconds, `fallback` if the key is missing or isn't a number
+std::chrono::milliseconds config_milliseconds(const std::string_view key, const std::chrono::milliseconds fallback);
+
+#endif // CONFIG_HPP
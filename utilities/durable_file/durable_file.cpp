@@ -0,0 +1,104 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <io.h>
+ * #include <fcntl.h>
+ * #include <unistd.h>
+ * #include <array>
+ * #include <string>
+ * #include <string_view>
+ * #include <functional>
+ * #include <filesystem>
+ * #include <system_error>
+ * #include <cstdio>
+ * #include <cstdint>
+ * #include <durable_file/durable_file.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+static constexpr std::array<uint32_t, 256> crc32_table{ [] {
+	std::array<uint32_t, 256> table{};
+	for (uint32_t i{ 0 }; i < 256; ++i) {
+		uint32_t c{ i };
+		for (int k{ 0 }; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		table[i] = c;
+	}
+	return table;
+}() };
+
+uint32_t crc32(const void* data, const std::size_t length) {
+	const uint8_t* bytes{ static_cast<const uint8_t*>(data) };
+	uint32_t c{ 0xFFFFFFFFu };
+	for (std::size_t i{ 0 }; i < length; ++i) c = crc32_table[(c ^ bytes[i]) & 0xFF] ^ (c >> 8);
+	return c ^ 0xFFFFFFFFu;
+}
+
+bool sync_file(std::FILE* file) {
+	if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool write_file_atomically(const std::filesystem::path& path, const std::string_view data) {
+	return write_file_atomically(path, [data](std::FILE* file) { return std::fwrite(data.data(), 1, data.size(), file) == data.size(); });
+}
+
+bool write_file_atomically(const std::filesystem::path& path, const std::function<bool(std::FILE*)>& write) {
+	std::error_code ec{};
+	if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+
+	std::filesystem::path temp_path{ path };
+	temp_path += ".tmp";
+
+	std::FILE* file{ std::fopen(temp_path.string().c_str(), "wb") };
+	if (!file) {
+		Logger::error(true, "Couldn't open {} for writing", temp_path.string());
+		return false;
+	}
+
+	const bool written{ write(file) && sync_file(file) };
+	std::fclose(file);
+	if (!written) {
+		Logger::error(true, "Couldn't write {}", temp_path.string());
+		std::filesystem::remove(temp_path, ec);
+		return false;
+	}
+
+	std::filesystem::rename(temp_path, path, ec);
+	if (ec) {
+		Logger::error(true, "Couldn't move {} into place: {}", temp_path.string(), ec.message());
+		return false;
+	}
+
+#ifndef _WIN32
+	// The rename itself is only durable once the directory is synced
+	const std::string directory{ path.has_parent_path() ? path.parent_path().string() : std::string{ "." } };
+	if (const int fd{ open(directory.c_str(), O_RDONLY) }; fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+#endif
+
+	return true;
+}
@@ -0,0 +1,49 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef DURABLE_FILE_HPP
+#define DURABLE_FILE_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <string_view>
+ * #include <functional>
+ * #include <filesystem>
+ * #include <cstdio>
+ * #include <cstdint>
+ */
+
+#include <pch.hpp>
+
+// CRC-32 (IEEE), used to tell a torn or corrupted record from a valid one
+uint32_t crc32(const void* data, const std::size_t length);
+
+// Flushes `file` and asks the OS to put it on the disk. Returns false if either step failed
+bool sync_file(std::FILE* file);
+
+/*
+ * @brief Replaces `path` with `data`, so a crash leaves either the old or the new content
+ *
+ * The data goes to `<path>.tmp` first, which is synced and then renamed over `path`
+ */
+bool write_file_atomically(const std::filesystem::path& path, const std::string_view data);
+// Same, with the content streamed by `write`, which returns false if it failed
+bool write_file_atomically(const std::filesystem::path& path, const std::function<bool(std::FILE*)>& write);
+
+#endif // DURABLE_FILE_HPP
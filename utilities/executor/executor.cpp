@@ -0,0 +1,339 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <array>
+ * #include <vector>
+ * #include <deque>
+ * #include <functional>
+ * #include <optional>
+ * #include <memory>
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <thread>
+ * #include <atomic>
+ * #include <chrono>
+ * #include <exception>
+ * #include <algorithm>
+ * #include <cstdint>
+ * #include <dpp/snowflake.h>
+ * #include <dpp/exception.h>
+ * #include <executor/executor.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+CommandExecutor command_executor;
+
+// Time left of the ack window when a job starts, for its handler to get the reply or deferral out
+static constexpr std::array<std::chrono::milliseconds, job_lane_count> lane_reply_budget{ std::chrono::milliseconds{ 1500 }, std::chrono::milliseconds{ 500 } };
+
+CommandExecutor::clock::time_point interaction_deadline(const dpp::snowflake interaction_id, const JobLane lane) {
+	using clock = CommandExecutor::clock;
+
+	// The interaction's own expiry, so one that sat in the gateway or behind a busy shard is already more urgent
+	const std::chrono::duration<double> created_at{ interaction_id.get_creation_time() };
+	const std::chrono::duration<double> now{ std::chrono::system_clock::now().time_since_epoch() };
+
+	// A skewed local clock can't move the expiry outside of the window
+	const clock::duration age{ std::clamp(std::chrono::duration_cast<clock::duration>(now - created_at), clock::duration::zero(), clock::duration{ interaction_ack_window }) };
+
+	return clock::now() + interaction_ack_window - age - lane_reply_budget[static_cast<std::size_t>(lane)];
+}
+
+CommandExecutor::~CommandExecutor() {
+	stop();
+}
+
+void CommandExecutor::start(const std::size_t worker_count) {
+	if (running.exchange(true)) return;
+
+	{
+		std::scoped_lock lock{ strands_mtx };
+		strands.clear();
+		held.clear();
+	}
+
+	generation.fetch_add(1);
+	workers.clear();
+	for (std::size_t i{ 0 }; i < std::max<std::size_t>(worker_count, 1); ++i) workers.push_back(std::make_unique<Worker>());
+	for (std::size_t i{ 0 }; i < workers.size(); ++i) workers[i]->thread = std::thread{ [this, i] { worker_loop(i); } };
+	accepting.store(true);
+
+	Logger::info(true, "Command executor started with {} workers", workers.size());
+}
+
+void CommandExecutor::close() {
+	accepting.store(false);
+}
+
+std::size_t CommandExecutor::stop() {
+	accepting.store(false);
+	if (!running.exchange(false)) return 0;
+
+	{
+		std::scoped_lock lock{ sleep_mtx };
+	}
+	sleep_cv.notify_all();
+
+	// The workers themselves are kept until the next `start()`, a late `submit()` may still reference them
+	for (const auto& worker : workers) {
+		if (worker->thread.joinable()) worker->thread.join();
+		std::scoped_lock lock{ worker->mtx };
+		worker->ready = {};
+	}
+
+	std::size_t dropped{ 0 };
+	{
+		std::scoped_lock lock{ strands_mtx };
+		for (const auto& [guild_id, jobs] : strands) dropped += jobs.size();
+		strands.clear();
+		held.clear();
+	}
+	idle_cv.notify_all();
+	{
+		std::scoped_lock lock{ stats_mtx };
+		for (auto& [shard_id, stats] : shard_stats) stats.queue_depth = 0;
+	}
+
+	if (dropped > 0) Logger::warn(true, "Command executor stopped, {} queued jobs were dropped", dropped);
+	return dropped;
+}
+
+bool CommandExecutor::submit(const uint64_t guild_id, const uint32_t shard_id, const clock::time_point deadline, std::function<void()> work, std::function<void()> expired) {
+	return submit_async(guild_id, shard_id, deadline, [work = std::move(work)](JobDone done) {
+		work();
+		done();
+	}, std::move(expired));
+}
+
+bool CommandExecutor::submit_async(const uint64_t guild_id, const uint32_t shard_id, const clock::time_point deadline, std::function<void(JobDone)> work, std::function<void()> expired) {
+	if (!running.load() || !accepting.load()) return false;
+
+	bool needs_scheduling{ false };
+	{
+		std::scoped_lock lock{ strands_mtx };
+		auto [it, inserted] { strands.try_emplace(guild_id) };
+		it->second.push_back(Job{ .work = std::move(work), .expired = std::move(expired), .deadline = deadline, .enqueued = clock::now(), .shard_id = shard_id });
+
+		// If the guild already has an entry, whoever runs its current job will queue the next one
+		needs_scheduling = inserted;
+	}
+
+	{
+		std::scoped_lock lock{ stats_mtx };
+		ShardQueueStats& stats{ shard_stats[shard_id] };
+		stats.shard_id = shard_id;
+		++stats.queue_depth;
+	}
+
+	if (needs_scheduling) push_ready(guild_id % workers.size(), ReadyGuild{ .deadline = deadline, .guild_id = guild_id });
+	return true;
+}
+
+bool CommandExecutor::wait_idle(const clock::time_point deadline) {
+	std::unique_lock lock{ strands_mtx };
+	return idle_cv.wait_until(lock, deadline, [this] { return strands.empty(); });
+}
+
+std::vector<ShardQueueStats> CommandExecutor::get_shard_stats() const {
+	std::scoped_lock lock{ stats_mtx };
+	std::vector<ShardQueueStats> result{};
+	result.reserve(shard_stats.size());
+	for (const auto& [shard_id, stats] : shard_stats) result.push_back(stats);
+	return result;
+}
+
+void CommandExecutor::push_ready(const std::size_t worker_index, const ReadyGuild ready) {
+	{
+		std::scoped_lock lock{ workers[worker_index]->mtx };
+		workers[worker_index]->ready.push(ready);
+	}
+	{
+		std::scoped_lock lock{ sleep_mtx };
+		ready_epoch.fetch_add(1);
+	}
+	sleep_cv.notify_one();
+}
+
+bool CommandExecutor::pop_ready(const std::size_t worker_index, ReadyGuild& out) {
+	// Own queue first
+	{
+		Worker& own{ *workers[worker_index] };
+		std::scoped_lock lock{ own.mtx };
+		if (!own.ready.empty()) {
+			out = own.ready.top();
+			own.ready.pop();
+			return true;
+		}
+	}
+
+	// Then steal the most urgent guild from another worker, skipping the queues that are busy at first
+	std::vector<Worker*> contended{};
+	for (std::size_t offset{ 1 }; offset < workers.size(); ++offset) {
+		Worker& victim{ *workers[(worker_index + offset) % workers.size()] };
+		std::unique_lock lock{ victim.mtx, std::try_to_lock };
+		if (!lock.owns_lock()) {
+			contended.push_back(&victim);
+			continue;
+		}
+		if (victim.ready.empty()) continue;
+
+		out = victim.ready.top();
+		victim.ready.pop();
+		return true;
+	}
+
+	// The busy ones are only held for a push or a pop, wait for them rather than reporting them empty
+	for (Worker* victim : contended) {
+		std::scoped_lock lock{ victim->mtx };
+		if (victim->ready.empty()) continue;
+
+		out = victim->ready.top();
+		victim->ready.pop();
+		return true;
+	}
+
+	return false;
+}
+
+void CommandExecutor::record_start(const Job& job, const clock::time_point started) {
+	const auto waited{ std::chrono::duration_cast<std::chrono::microseconds>(started - job.enqueued) };
+
+	std::scoped_lock lock{ stats_mtx };
+	ShardQueueStats& stats{ shard_stats[job.shard_id] };
+	if (stats.queue_depth > 0) --stats.queue_depth;
+	++stats.executed;
+	stats.total_wait += waited;
+	if (waited > stats.max_wait) stats.max_wait = waited;
+	if (started > job.deadline) ++stats.missed_deadlines;
+}
+
+void CommandExecutor::worker_loop(const std::size_t index) {
+	while (true) {
+		const std::optional<clock::time_point> next_release{ release_overdue() };
+
+		// Read before looking at the queues, a guild queued after that bumps it and wakes this worker
+		const uint64_t epoch{ ready_epoch.load() };
+
+		ReadyGuild ready{};
+		if (!pop_ready(index, ready)) {
+			const auto woken{ [this, epoch] { return !running.load() || ready_epoch.load() != epoch; } };
+			std::unique_lock lock{ sleep_mtx };
+			// A held guild only ever comes from a worker that is awake, which sees it before it sleeps
+			if (next_release.has_value()) sleep_cv.wait_until(lock, next_release.value(), woken);
+			else sleep_cv.wait(lock, woken);
+			if (!running.load()) return;
+			continue;
+		}
+
+		Job job{};
+		{
+			std::scoped_lock lock{ strands_mtx };
+			auto it{ strands.find(ready.guild_id) };
+			if (it == strands.end() || it->second.empty()) continue;
+			job = std::move(it->second.front());
+			it->second.pop_front();
+		}
+
+		const clock::time_point started{ clock::now() };
+		record_start(job, started);
+
+		// Only the first call counts, whether it comes from the job, the hold limit or the exception handlers below
+		const auto finished{ std::make_shared<std::atomic_bool>(false) };
+		const uint64_t job_generation{ generation.load() };
+		JobDone done{ [this, finished, guild_id = ready.guild_id, job_generation] {
+			if (!finished->exchange(true)) finish(guild_id, job_generation);
+		} };
+
+		try {
+			// Too late to be answered in time, the expiry handler tells the user rather than letting the interaction fail
+			if (job.expired && started > job.deadline) {
+				job.expired();
+				done();
+			}
+			else job.work(done);
+		}
+		catch (const dpp::exception& e) {
+			Logger::exception(false, "D++ exception escaped a command executor job: {}", std::string{ e.what() });
+			done();
+		}
+		catch (const std::exception& e) {
+			Logger::exception(false, "Standard exception escaped a command executor job: {}", std::string{ e.what() });
+			done();
+		}
+		catch (...) {
+			Logger::exception(false, "Unknown exception escaped a command executor job");
+			done();
+		}
+
+		// Still running, ex. a suspended coroutine. Its guild waits for it, but not past the hold limit
+		if (!finished->load()) {
+			std::scoped_lock lock{ strands_mtx };
+			held.push_back(HeldGuild{ .release_at = started + async_hold_limit, .guild_id = ready.guild_id, .job_generation = job_generation, .finished = finished });
+		}
+	}
+}
+
+std::optional<CommandExecutor::clock::time_point> CommandExecutor::release_overdue() {
+	std::vector<HeldGuild> overdue{};
+	std::optional<clock::time_point> next_release{};
+	{
+		std::scoped_lock lock{ strands_mtx };
+		const clock::time_point now{ clock::now() };
+		for (auto it{ held.begin() }; it != held.end();) {
+			if (it->finished->load()) it = held.erase(it);
+			else if (it->release_at <= now) {
+				overdue.push_back(*it);
+				it = held.erase(it);
+			}
+			else {
+				if (!next_release.has_value() || it->release_at < next_release.value()) next_release = it->release_at;
+				++it;
+			}
+		}
+	}
+
+	for (const HeldGuild& guild : overdue) {
+		if (guild.finished->exchange(true)) continue;
+		Logger::warn(false, "A command in guild {} hasn't finished after {} s, running the guild's next command", guild.guild_id, async_hold_limit.count());
+		finish(guild.guild_id, guild.job_generation);
+	}
+
+	return next_release;
+}
+
+void CommandExecutor::finish(const uint64_t guild_id, const uint64_t job_generation) {
+	if (job_generation != generation.load()) return;
+
+	// Queue the guild's next job, if any, or release the guild
+	std::optional<clock::time_point> next_deadline{};
+	{
+		std::scoped_lock lock{ strands_mtx };
+		auto it{ strands.find(guild_id) };
+		if (it != strands.end()) {
+			if (it->second.empty()) strands.erase(it);
+			else next_deadline = it->second.front().deadline;
+		}
+		if (strands.empty()) idle_cv.notify_all();
+	}
+
+	// An asynchronous job may finish on any thread, so the guild goes back to its home worker
+	if (next_deadline.has_value() && running.load()) push_ready(guild_id % workers.size(), ReadyGuild{ .deadline = next_deadline.value(), .guild_id = guild_id });
+}
@@ -0,0 +1,187 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <vector>
+ * #include <deque>
+ * #include <queue>
+ * #include <unordered_map>
+ * #include <map>
+ * #include <functional>
+ * #include <optional>
+ * #include <memory>
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <thread>
+ * #include <atomic>
+ * #include <chrono>
+ * #include <cstdint>
+ * #include <dpp/snowflake.h>
+ */
+
+#include <pch.hpp>
+
+// Discord invalidates an interaction that isn't acknowledged within 3 seconds
+constexpr std::chrono::seconds interaction_ack_window{ 3 };
+
+// An asynchronous job gives up its guild after this long even if it hasn't reported that it is done
+// By then its interaction can no longer be acknowledged, so the guild's next job shouldn't wait on it
+constexpr std::chrono::seconds async_hold_limit{ interaction_ack_window };
+
+// What kind of interaction a job answers, which decides how much of the ack window its handler needs
+enum class JobLane : uint8_t {
+	Command, // Slash commands, which run their checks before they reply or defer
+	Component, // Select menus and buttons, which answer right away
+};
+
+inline constexpr std::size_t job_lane_count{ 2 };
+
+struct ShardQueueStats {
+	uint32_t shard_id{ 0 };
+	uint64_t queue_depth{ 0 }; // Jobs submitted but not yet started
+	uint64_t executed{ 0 };
+	uint64_t missed_deadlines{ 0 }; // Jobs that reached a worker after their deadline, those with an expiry handler were turned away
+	std::chrono::microseconds total_wait{ 0 };
+	std::chrono::microseconds max_wait{ 0 };
+};
+
+/*
+ * @brief Runs command handlers off the gateway threads
+ *
+ * Jobs of one guild run one at a time, in the order they were submitted, and an asynchronous job
+ * holds its guild until it reports that it is done or `async_hold_limit` passes
+ * A job that reaches a worker after its deadline runs its expiry handler instead, if it has one
+ * Across guilds, the guild whose next job has the earliest deadline runs first
+ * Each worker owns a queue of ready guilds, and idle workers steal from the others
+ */
+class CommandExecutor {
+public:
+	using clock = std::chrono::steady_clock;
+
+	CommandExecutor() = default;
+	CommandExecutor(const CommandExecutor&) = delete;
+	CommandExecutor& operator=(const CommandExecutor&) = delete;
+	CommandExecutor(CommandExecutor&&) = delete;
+	CommandExecutor& operator=(CommandExecutor&&) = delete;
+	~CommandExecutor();
+
+	void start(const std::size_t worker_count);
+	// Stops accepting new jobs, the workers keep running what is already queued
+	void close();
+	// Stops the workers, dropping whatever is still queued. Returns the number of dropped jobs
+	std::size_t stop();
+
+	// Given to asynchronous jobs, the guild's next job starts once it is called
+	using JobDone = std::function<void()>;
+
+	/*
+	 * @brief Queues a job
+	 * @param guild_id Jobs with the same guild ID never run concurrently and keep their order
+	 * @param shard_id The shard the job came from, used for the stats only
+	 * @param deadline The time by which the job should have started
+	 * @param expired Runs instead of `work` if the job starts after `deadline`, ex. to ask the user to try again. Optional
+	 * @return false if the executor isn't running or was closed, in which case the job is not queued
+	 */
+	bool submit(const uint64_t guild_id, const uint32_t shard_id, const clock::time_point deadline, std::function<void()> work, std::function<void()> expired = {});
+
+	/*
+	 * @brief Queues a job that finishes after `work` returns, ex. a coroutine that suspends
+	 * The guild is held until `work` calls the `JobDone` it is given, from any thread, or for `async_hold_limit` at most
+	 * If `work` throws, the guild is released right away
+	 */
+	bool submit_async(const uint64_t guild_id, const uint32_t shard_id, const clock::time_point deadline, std::function<void(JobDone)> work, std::function<void()> expired = {});
+
+	// Waits until no job is queued or running. Returns false if `deadline` passed first
+	bool wait_idle(const clock::time_point deadline);
+
+	std::vector<ShardQueueStats> get_shard_stats() const;
+
+private:
+	struct Job {
+		std::function<void(JobDone)> work;
+		std::function<void()> expired;
+		clock::time_point deadline;
+		clock::time_point enqueued;
+		uint32_t shard_id{ 0 };
+	};
+
+	// A guild whose next job is waiting for a worker
+	struct ReadyGuild {
+		clock::time_point deadline;
+		uint64_t guild_id{ 0 };
+
+		bool operator>(const ReadyGuild& other) const { return deadline > other.deadline; }
+	};
+
+	struct Worker {
+		std::mutex mtx;
+		std::priority_queue<ReadyGuild, std::vector<ReadyGuild>, std::greater<>> ready;
+		std::thread thread;
+	};
+
+	// An asynchronous job that returned without reporting that it is done
+	struct HeldGuild {
+		clock::time_point release_at;
+		uint64_t guild_id{ 0 };
+		uint64_t job_generation{ 0 };
+		std::shared_ptr<std::atomic_bool> finished;
+	};
+
+	// A guild has an entry here while it is queued on a worker or one of its jobs is running
+	std::mutex strands_mtx;
+	std::unordered_map<uint64_t, std::deque<Job>> strands;
+	std::vector<HeldGuild> held; // Guarded by `strands_mtx`
+	std::condition_variable idle_cv; // Notified when `strands` becomes empty
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic_bool running{ false };
+	std::atomic<uint64_t> generation{ 0 }; // Bumped by `start()`, a job finishing after a restart must not release the new strands
+	std::atomic_bool accepting{ false };
+
+	std::mutex sleep_mtx;
+	std::condition_variable sleep_cv;
+	std::atomic<uint64_t> ready_epoch{ 0 }; // Bumped under `sleep_mtx` each time a guild is queued
+
+	mutable std::mutex stats_mtx;
+	std::map<uint32_t, ShardQueueStats> shard_stats;
+
+	void worker_loop(const std::size_t index);
+	void push_ready(const std::size_t worker_index, const ReadyGuild ready);
+	bool pop_ready(const std::size_t worker_index, ReadyGuild& out);
+	void record_start(const Job& job, const clock::time_point started);
+	void finish(const uint64_t guild_id, const uint64_t job_generation);
+	// Releases the guilds held past `async_hold_limit`. Returns when the next one is due, if any
+	std::optional<clock::time_point> release_overdue();
+};
+
+/*
+ * @brief The latest time a job answering an interaction can start and still be acknowledged in time
+ * @param interaction_id The interaction's snowflake, which holds the time Discord created it
+ * @param lane The kind of handler, commands are given more time to reply than components
+ */
+CommandExecutor::clock::time_point interaction_deadline(const dpp::snowflake interaction_id, const JobLane lane);
+
+// The executor all slash command and select menu handlers run on
+extern CommandExecutor command_executor;
+
+#endif // EXECUTOR_HPP
@@ -0,0 +1,550 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <array>
+ * #include <vector>
+ * #include <string>
+ * #include <string_view>
+ * #include <optional>
+ * #include <span>
+ * #include <type_traits>
+ * #include <exception>
+ * #include <utility>
+ * #include <algorithm>
+ * #include <fstream>
+ * #include <iterator>
+ * #include <filesystem>
+ * #include <system_error>
+ * #include <atomic>
+ * #include <cstdio>
+ * #include <cstring>
+ * #include <cstdint>
+ * #include <dpp/nlohmann/json.hpp>
+ * #include <guild_settings/guild_settings.hpp>
+ * #include <mapped_file/mapped_file.hpp>
+ * #include <other_utils/other_utils.hpp>
+ * #include <durable_file/durable_file.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+using json = nlohmann::json;
+
+// The key of each `CommandType` in the settings file
+static constexpr std::array<std::string_view, command_type_count> log_channel_keys{
+	"role_edit_logging_channel_id",
+	"ban_edit_logging_channel_id",
+	"general_logging_channel_id"
+};
+
+// Kept at or below half full, so probe runs stay short
+static constexpr std::size_t min_slot_count{ 64 };
+
+std::size_t GuildSettingsMap::slot_of(const uint64_t guild_id) const {
+	// Snowflakes share their high (timestamp) bits, mix them all into the low ones
+	uint64_t h{ guild_id * 0x9E3779B97F4A7C15ull };
+	h ^= h >> 32;
+	return static_cast<std::size_t>(h) & (slots.size() - 1);
+}
+
+const GuildSettings* GuildSettingsMap::find(const uint64_t guild_id) const {
+	if (slots.empty() || guild_id == 0) return nullptr;
+
+	for (std::size_t i{ slot_of(guild_id) };; i = (i + 1) & (slots.size() - 1)) {
+		if (slots[i].guild_id == guild_id) return &slots[i].settings;
+		if (slots[i].guild_id == 0) return nullptr;
+	}
+}
+
+GuildSettings* GuildSettingsMap::find(const uint64_t guild_id) {
+	return const_cast<GuildSettings*>(std::as_const(*this).find(guild_id));
+}
+
+GuildSettings& GuildSettingsMap::get_or_insert(const uint64_t guild_id) {
+	if ((count + 1) * 2 > slots.size()) grow();
+
+	std::size_t i{ slot_of(guild_id) };
+	while (slots[i].guild_id != 0 && slots[i].guild_id != guild_id) i = (i + 1) & (slots.size() - 1);
+
+	if (slots[i].guild_id == 0) {
+		slots[i].guild_id = guild_id;
+		++count;
+	}
+	return slots[i].settings;
+}
+
+std::size_t GuildSettingsMap::size() const {
+	return count;
+}
+
+void GuildSettingsMap::clear() {
+	slots.clear();
+	count = 0;
+}
+
+void GuildSettingsMap::grow() {
+	std::vector<Slot> old_slots{ std::move(slots) };
+	slots = std::vector<Slot>(std::max(min_slot_count, old_slots.size() * 2));
+
+	for (Slot& slot : old_slots) {
+		if (slot.guild_id == 0) continue;
+		std::size_t i{ slot_of(slot.guild_id) };
+		while (slots[i].guild_id != 0) i = (i + 1) & (slots.size() - 1);
+		slots[i] = std::move(slot);
+	}
+}
+
+struct SnapshotHeader {
+	std::array<char, 8> magic{};
+	uint32_t version{ 0 };
+	uint32_t byte_order{ 0 };
+	uint32_t record_size{ 0 };
+	uint32_t reserved{ 0 };
+	uint64_t count{ 0 };
+};
+
+static_assert(sizeof(SnapshotHeader) == 32);
+static_assert(std::is_trivially_copyable_v<GuildSettingsRecord> && sizeof(GuildSettingsRecord) % alignof(uint64_t) == 0);
+
+static constexpr std::array<char, 8> snapshot_magic{ 'I', 'S', 'H', 'G', 'S', 'E', 'T', '\0' };
+// Bumped whenever the header or `GuildSettingsRecord` changes
+static constexpr uint32_t snapshot_version{ 2 };
+// Written in host byte order, on a host of the other order it reads as a different value
+static constexpr uint32_t snapshot_byte_order{ 0x01020304 };
+
+// Version 1 records also held the webhook tokens in plain text, they're read once to be rewritten without them
+struct GuildSettingsRecordV1 {
+	std::array<uint64_t, command_type_count> log_channels{};
+	std::array<uint64_t, command_type_count> webhook_ids{};
+	std::array<std::array<char, 80>, command_type_count> webhook_tokens{};
+	uint64_t features{ 0 };
+};
+
+GuildSettings GuildSettingsRecord::decode() const {
+	return GuildSettings{ .log_channels = log_channels, .log_webhooks = webhook_ids, .features = std::bitset<guild_feature_count>{ features } };
+}
+
+GuildSettingsRecord GuildSettingsRecord::encode(const GuildSettings& settings) {
+	return GuildSettingsRecord{ .log_channels = settings.log_channels, .webhook_ids = settings.log_webhooks, .features = settings.features.to_ullong() };
+}
+
+std::vector<uint64_t> list_file_generations(const std::filesystem::path& base) {
+	std::vector<uint64_t> generations{};
+	const std::filesystem::path directory{ base.has_parent_path() ? base.parent_path() : std::filesystem::path{ "." } };
+	const std::string prefix{ base.filename().string() + "." };
+
+	std::error_code ec{};
+	for (const auto& file : std::filesystem::directory_iterator{ directory, ec }) {
+		const std::string name{ file.path().filename().string() };
+		if (!name.starts_with(prefix) || name.size() == prefix.size()) continue;
+
+		const std::string_view suffix{ std::string_view{ name }.substr(prefix.size()) };
+		if (!std::all_of(suffix.begin(), suffix.end(), [](const char c) { return c >= '0' && c <= '9'; })) continue;
+		generations.push_back(std::stoull(std::string{ suffix }));
+	}
+
+	std::sort(generations.begin(), generations.end());
+	return generations;
+}
+
+std::filesystem::path file_generation_path(const std::filesystem::path& base, const uint64_t number) {
+	std::filesystem::path path{ base };
+	path += "." + std::to_string(number);
+	return path;
+}
+
+GuildSettingsSnapshot::~GuildSettingsSnapshot() {
+	file.unmap();
+	if (!remove_on_release.load(std::memory_order_acquire) || path.empty()) return;
+
+	std::error_code ec{};
+	std::filesystem::remove(path, ec);
+	if (ec) Logger::warn(false, "Couldn't delete the replaced settings snapshot {}: {}", path.string(), ec.message());
+}
+
+void GuildSettingsSnapshot::remove_when_released() const {
+	remove_on_release.store(true, std::memory_order_release);
+}
+
+bool GuildSettingsSnapshot::open(const std::filesystem::path& snapshot_path) {
+	guild_ids = nullptr;
+	records = nullptr;
+	count = 0;
+	path.clear();
+	if (!file.map(snapshot_path)) return false;
+
+	SnapshotHeader header{};
+	if (file.size() >= sizeof(header)) std::memcpy(&header, file.data(), sizeof(header));
+
+	constexpr std::size_t entry_size{ sizeof(uint64_t) + sizeof(GuildSettingsRecord) };
+	const bool readable{ file.size() >= sizeof(header) && header.magic == snapshot_magic && header.version == snapshot_version
+		&& header.byte_order == snapshot_byte_order && header.record_size == sizeof(GuildSettingsRecord)
+		&& header.count == (file.size() - sizeof(header)) / entry_size && (file.size() - sizeof(header)) % entry_size == 0 };
+	if (!readable) {
+		file.unmap();
+		return false;
+	}
+
+	// The mapping is page aligned and the header is 32 bytes, both arrays are aligned for their types
+	count = static_cast<std::size_t>(header.count);
+	guild_ids = reinterpret_cast<const uint64_t*>(file.data() + sizeof(header));
+	records = reinterpret_cast<const GuildSettingsRecord*>(file.data() + sizeof(header) + count * sizeof(uint64_t));
+	path = snapshot_path;
+	return true;
+}
+
+std::optional<GuildSettingsMap> GuildSettingsSnapshot::read_legacy(const std::filesystem::path& path) {
+	MappedFile legacy{};
+	if (!legacy.map(path)) return std::nullopt;
+
+	SnapshotHeader header{};
+	if (legacy.size() >= sizeof(header)) std::memcpy(&header, legacy.data(), sizeof(header));
+
+	constexpr std::size_t entry_size{ sizeof(uint64_t) + sizeof(GuildSettingsRecordV1) };
+	const bool readable{ legacy.size() >= sizeof(header) && header.magic == snapshot_magic && header.version == 1
+		&& header.byte_order == snapshot_byte_order && header.record_size == sizeof(GuildSettingsRecordV1)
+		&& header.count == (legacy.size() - sizeof(header)) / entry_size && (legacy.size() - sizeof(header)) % entry_size == 0 };
+	if (!readable) return std::nullopt;
+
+	const std::size_t legacy_count{ static_cast<std::size_t>(header.count) };
+	const uint64_t* ids{ reinterpret_cast<const uint64_t*>(legacy.data() + sizeof(header)) };
+	const GuildSettingsRecordV1* legacy_records{ reinterpret_cast<const GuildSettingsRecordV1*>(legacy.data() + sizeof(header) + legacy_count * sizeof(uint64_t)) };
+
+	// The webhook IDs are kept, so the webhooks can be replaced. Their tokens are dropped
+	GuildSettingsMap settings{};
+	for (std::size_t i{ 0 }; i < legacy_count; ++i) {
+		settings.get_or_insert(ids[i]) = GuildSettings{ .log_channels = legacy_records[i].log_channels, .log_webhooks = legacy_records[i].webhook_ids,
+			.features = std::bitset<guild_feature_count>{ legacy_records[i].features } };
+	}
+	return settings;
+}
+
+const GuildSettingsRecord* GuildSettingsSnapshot::find(const uint64_t guild_id) const {
+	const uint64_t* end{ guild_ids + count };
+	const uint64_t* it{ std::lower_bound(guild_ids, end, guild_id) };
+	if (it == end || *it != guild_id) return nullptr;
+	return &records[it - guild_ids];
+}
+
+std::size_t GuildSettingsSnapshot::size() const {
+	return count;
+}
+
+std::span<const uint8_t> GuildSettingsSnapshot::bytes() const {
+	return { file.data(), file.size() };
+}
+
+bool GuildSettingsSnapshot::write(const std::filesystem::path& path, const GuildSettingsSnapshot& base, const GuildSettingsMap& changes) {
+	// Changed guilds in ID order, so they merge with the snapshot in one pass
+	std::vector<std::pair<uint64_t, const GuildSettings*>> changed{};
+	changed.reserve(changes.size());
+	changes.for_each([&changed](const uint64_t guild_id, const GuildSettings& settings) { changed.emplace_back(guild_id, &settings); });
+	std::sort(changed.begin(), changed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	// Visits every guild of the new snapshot in ID order, a changed guild replaces its old record
+	const auto merge{ [&base, &changed](auto&& visit) {
+		std::size_t i{ 0 }, j{ 0 };
+		while (i < base.count || j < changed.size()) {
+			if (j == changed.size() || (i < base.count && base.guild_ids[i] < changed[j].first)) {
+				visit(base.guild_ids[i], &base.records[i], nullptr);
+				++i;
+				continue;
+			}
+			if (i < base.count && base.guild_ids[i] == changed[j].first) ++i;
+			if (!changed[j].second->empty()) visit(changed[j].first, nullptr, changed[j].second);
+			++j;
+		}
+	} };
+
+	std::vector<uint64_t> ids{};
+	ids.reserve(base.count + changed.size());
+	merge([&ids](const uint64_t guild_id, const GuildSettingsRecord*, const GuildSettings*) { ids.push_back(guild_id); });
+
+	return write_file_atomically(path, [&](std::FILE* out) {
+		const SnapshotHeader header{ .magic = snapshot_magic, .version = snapshot_version, .byte_order = snapshot_byte_order,
+			.record_size = sizeof(GuildSettingsRecord), .count = ids.size() };
+
+		bool written{ std::fwrite(&header, sizeof(header), 1, out) == 1 && std::fwrite(ids.data(), sizeof(uint64_t), ids.size(), out) == ids.size() };
+		merge([&written, out](const uint64_t, const GuildSettingsRecord* kept, const GuildSettings* settings) {
+			if (!written) return;
+			if (kept) written = std::fwrite(kept, sizeof(GuildSettingsRecord), 1, out) == 1;
+			else {
+				const GuildSettingsRecord record{ GuildSettingsRecord::encode(*settings) };
+				written = std::fwrite(&record, sizeof(record), 1, out) == 1;
+			}
+		});
+		return written;
+	});
+}
+
+json guild_settings_to_json(const GuildSettingsMap& settings) {
+	json document(json::object());
+
+	settings.for_each([&document](const uint64_t guild_id, const GuildSettings& guild) {
+		json entry(json::object());
+		for (std::size_t i{ 0 }; i < command_type_count; ++i) {
+			if (guild.log_channels[i] == 0) continue;
+			entry[std::string{ log_channel_keys[i] }] = guild.log_channels[i];
+
+			// Only the ID, the token is a credential and exports end up in backups
+			if (guild.log_webhooks[i] != 0) entry["log_webhooks"][std::to_string(guild.log_channels[i])] = json{ { "id", guild.log_webhooks[i] } };
+		}
+		if (!entry.empty()) document[std::to_string(guild_id)] = std::move(entry);
+	});
+
+	return document;
+}
+
+GuildSettingsMap guild_settings_from_json(const json& document) {
+	GuildSettingsMap settings{};
+	if (!document.is_object()) return settings;
+
+	for (const auto& [guild_id_str, entry] : document.items()) {
+		try {
+			const uint64_t guild_id{ std::stoull(guild_id_str) };
+			if (guild_id == 0 || !entry.is_object()) continue;
+
+			GuildSettings& guild{ settings.get_or_insert(guild_id) };
+			for (std::size_t i{ 0 }; i < command_type_count; ++i) {
+				const auto channel{ entry.find(std::string{ log_channel_keys[i] }) };
+				if (channel != entry.end()) guild.log_channels[i] = channel->get<uint64_t>();
+			}
+
+			// Webhooks are only kept for channels that are still log channels
+			const auto webhooks{ entry.find("log_webhooks") };
+			if (webhooks == entry.end() || !webhooks->is_object()) continue;
+
+			for (std::size_t i{ 0 }; i < command_type_count; ++i) {
+				if (guild.log_channels[i] == 0) continue;
+				const auto webhook{ webhooks->find(std::to_string(guild.log_channels[i])) };
+				if (webhook == webhooks->end()) continue;
+
+				// A `token` in an older export is ignored, the webhook is replaced once it's needed
+				guild.log_webhooks[i] = webhook->value("id", uint64_t{ 0 });
+				if (guild.log_webhooks[i] != 0) guild.features.set(static_cast<std::size_t>(GuildFeature::LogWebhooks));
+			}
+		}
+		catch (const std::exception& e) {
+			Logger::warn(true, "Skipped the settings of guild `{}`, they couldn't be read: {}", guild_id_str, e.what());
+		}
+	}
+
+	return settings;
+}
+
+bool apply_settings_change(GuildSettingsMap& settings, const SettingsChange& change) {
+	switch (change.kind) {
+	case SettingsChange::Kind::LogChannel: {
+		GuildSettings& guild{ settings.get_or_insert(change.guild_id) };
+		const std::size_t index{ static_cast<std::size_t>(change.command_type) };
+		if (index >= command_type_count) return false;
+
+		// A webhook belongs to the channel it was created in
+		if (guild.log_channels[index] != change.channel_id) guild.log_webhooks[index] = 0;
+		guild.log_channels[index] = change.channel_id;
+		return true;
+	}
+	case SettingsChange::Kind::LogWebhook: {
+		GuildSettings* guild{ settings.find(change.guild_id) };
+		if (!guild) return false;
+
+		// One channel can log several command types, they all share its webhook
+		bool stored{ false };
+		for (std::size_t i{ 0 }; i < command_type_count; ++i) {
+			if (guild->log_channels[i] != change.channel_id) continue;
+			guild->log_webhooks[i] = change.webhook_id;
+			stored = true;
+		}
+		if (stored) guild->features.set(static_cast<std::size_t>(GuildFeature::LogWebhooks));
+		return stored;
+	}
+	case SettingsChange::Kind::ForgetLogWebhook: {
+		GuildSettings* guild{ settings.find(change.guild_id) };
+		if (!guild || !guild->has(GuildFeature::LogWebhooks)) return false;
+
+		bool any_left{ false };
+		for (std::size_t i{ 0 }; i < command_type_count; ++i) {
+			if (guild->log_channels[i] == change.channel_id) guild->log_webhooks[i] = 0;
+			any_left |= guild->log_webhooks[i] != 0;
+		}
+		guild->features.set(static_cast<std::size_t>(GuildFeature::LogWebhooks), any_left);
+		return true;
+	}
+	}
+	return false;
+}
+
+static json change_to_json(const SettingsChange& change) {
+	json entry{ { "kind", static_cast<uint8_t>(change.kind) }, { "guild", change.guild_id }, { "channel", change.channel_id } };
+	if (change.kind == SettingsChange::Kind::LogChannel) entry["type"] = static_cast<uint8_t>(change.command_type);
+	if (change.kind == SettingsChange::Kind::LogWebhook) entry["webhook_id"] = change.webhook_id;
+	return entry;
+}
+
+static SettingsChange change_from_json(const json& entry) {
+	return SettingsChange{
+		.kind = static_cast<SettingsChange::Kind>(entry.at("kind").get<uint8_t>()),
+		.guild_id = entry.at("guild").get<uint64_t>(),
+		.channel_id = entry.at("channel").get<uint64_t>(),
+		.command_type = static_cast<CommandType>(entry.value("type", static_cast<uint8_t>(CommandType::Unknown))),
+		.webhook_id = entry.value("webhook_id", uint64_t{ 0 })
+	};
+}
+
+// u32 payload length + u32 CRC-32 of the payload
+static constexpr std::size_t log_record_prefix_size{ 8 };
+
+SettingsLog::~SettingsLog() {
+	close();
+}
+
+std::filesystem::path SettingsLog::generation_path(const uint64_t number) const {
+	return file_generation_path(base, number);
+}
+
+std::vector<uint64_t> SettingsLog::list_generations() const {
+	return list_file_generations(base);
+}
+
+bool SettingsLog::open_generation(const uint64_t number) {
+	generation = number;
+	// The last good offset, a failed append is cut back to it
+	std::error_code ec{};
+	const std::uintmax_t existing{ std::filesystem::file_size(generation_path(number), ec) };
+	written = ec ? 0 : static_cast<std::size_t>(existing);
+	writer = std::fopen(generation_path(number).string().c_str(), "ab");
+	if (!writer) Logger::error(true, "Couldn't open the settings log {}", generation_path(number).string());
+	return writer != nullptr;
+}
+
+std::vector<SettingsChange> SettingsLog::open(const std::filesystem::path& base_path) {
+	close();
+	base = base_path;
+
+	std::error_code ec{};
+	if (base.has_parent_path()) std::filesystem::create_directories(base.parent_path(), ec);
+
+	std::vector<SettingsChange> changes{};
+	const std::vector<uint64_t> generations{ list_generations() };
+
+	for (const uint64_t number : generations) {
+		const std::filesystem::path path{ generation_path(number) };
+		std::ifstream file{ path, std::ios::binary };
+		const std::string data{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+		file.close();
+
+		std::size_t offset{ 0 };
+		while (offset + log_record_prefix_size <= data.size()) {
+			uint32_t length{ 0 }, checksum{ 0 };
+			std::memcpy(&length, data.data() + offset, sizeof(length));
+			std::memcpy(&checksum, data.data() + offset + 4, sizeof(checksum));
+
+			const std::size_t payload_offset{ offset + log_record_prefix_size };
+			if (length > data.size() - payload_offset || crc32(data.data() + payload_offset, length) != checksum) break;
+
+			try {
+				changes.push_back(change_from_json(json::parse(data.begin() + static_cast<std::ptrdiff_t>(payload_offset),
+					data.begin() + static_cast<std::ptrdiff_t>(payload_offset + length))));
+			}
+			catch (const std::exception& e) {
+				Logger::warn(true, "Skipped an unreadable record in {}: {}", path.string(), e.what());
+			}
+			offset = payload_offset + length;
+		}
+
+		// Only a crash mid-append leaves a partial record, and that change was never acknowledged
+		if (offset < data.size()) {
+			Logger::warn(true, "Cut {} bytes of a torn record off {}", data.size() - offset, path.string());
+			std::filesystem::resize_file(path, offset, ec);
+		}
+	}
+
+	if (!changes.empty()) Logger::info(true, "Replaying {} settings changes from {} log generations", changes.size(), generations.size());
+
+	open_generation(generations.empty() ? 1 : generations.back() + 1);
+	return changes;
+}
+
+void SettingsLog::close() {
+	if (!writer) return;
+	std::fclose(writer);
+	writer = nullptr;
+}
+
+bool SettingsLog::append(const SettingsChange& change) {
+	if (!writer) return false;
+
+	const std::string payload{ change_to_json(change).dump() };
+	const uint32_t length{ static_cast<uint32_t>(payload.size()) };
+	const uint32_t checksum{ crc32(payload.data(), payload.size()) };
+
+	std::string record(log_record_prefix_size, '\0');
+	std::memcpy(record.data(), &length, sizeof(length));
+	std::memcpy(record.data() + 4, &checksum, sizeof(checksum));
+	record += payload;
+
+	if (std::fwrite(record.data(), 1, record.size(), writer) != record.size() || !sync_file(writer)) {
+		const std::filesystem::path path{ generation_path(generation) };
+		Logger::error(true, "Couldn't append to the settings log {}", path.string());
+
+		// Cut what made it to disk, so the next record doesn't land after a torn one and get cut off with it on replay
+		std::fclose(writer);
+		std::error_code ec{};
+		std::filesystem::resize_file(path, written, ec);
+		if (ec) Logger::error(true, "Couldn't cut the torn record off the settings log {}: {}", path.string(), ec.message());
+		writer = std::fopen(path.string().c_str(), "ab");
+		if (!writer) Logger::error(true, "Couldn't reopen the settings log {}", path.string());
+		return false;
+	}
+
+	written += record.size();
+	return true;
+}
+
+uint64_t SettingsLog::rotate() {
+	const uint64_t closed{ generation };
+	close();
+	open_generation(closed + 1);
+	return closed;
+}
+
+void SettingsLog::retire(const uint64_t last) {
+	std::error_code ec{};
+	for (const uint64_t number : list_generations()) {
+		if (number > last) break;
+		std::filesystem::remove(generation_path(number), ec);
+	}
+}
+
+std::size_t SettingsLog::size() const {
+	return written;
+}
+
+void SettingsLog::discard(const std::filesystem::path& base_path) {
+	close();
+	base = base_path;
+
+	std::error_code ec{};
+	for (const uint64_t number : list_generations()) {
+		std::filesystem::path discarded{ generation_path(number) };
+		discarded += ".discarded";
+		std::filesystem::rename(generation_path(number), discarded, ec);
+	}
+}
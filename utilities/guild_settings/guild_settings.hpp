@@ -0,0 +1,245 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef GUILD_SETTINGS_HPP
+#define GUILD_SETTINGS_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <array>
+ * #include <vector>
+ * #include <bitset>
+ * #include <string>
+ * #include <optional>
+ * #include <memory>
+ * #include <filesystem>
+ * #include <atomic>
+ * #include <cstdio>
+ * #include <cstdint>
+ * #include <dpp/nlohmann/json.hpp>
+ * #include <other_utils/other_utils.hpp>
+ * #include <mapped_file/mapped_file.hpp>
+ */
+
+#include <pch.hpp>
+
+enum class GuildFeature : uint8_t {
+	LogWebhooks, // At least one log channel delivers through a webhook
+};
+
+inline constexpr std::size_t guild_feature_count{ 1 };
+
+// Everything the bot stores per guild, laid out so lookups are plain array reads
+struct GuildSettings {
+	std::array<uint64_t, command_type_count> log_channels{}; // Indexed by `CommandType`, 0 when unset
+	std::array<uint64_t, command_type_count> log_webhooks{}; // ID of the webhook in the log channel of the same index, 0 when none. Its token is never stored
+	std::bitset<guild_feature_count> features{};
+
+	bool has(const GuildFeature feature) const {
+		return features.test(static_cast<std::size_t>(feature));
+	}
+
+	// No log channel is set, the guild needs no entry
+	bool empty() const {
+		return std::all_of(log_channels.begin(), log_channels.end(), [](const uint64_t channel_id) { return channel_id == 0; });
+	}
+
+	bool operator==(const GuildSettings&) const = default;
+};
+
+/*
+ * @brief Open addressing hash map from guild ID to its settings, in a single array
+ *
+ * Guild IDs are never 0, so 0 marks an empty slot. Lookups hash the ID and probe
+ * linearly, without touching the heap. Guilds are never erased, only reset
+ */
+class GuildSettingsMap {
+public:
+	const GuildSettings* find(const uint64_t guild_id) const;
+	GuildSettings* find(const uint64_t guild_id);
+	// Inserts default settings for a guild that has none yet
+	GuildSettings& get_or_insert(const uint64_t guild_id);
+
+	std::size_t size() const;
+	void clear();
+
+	template <typename F>
+	void for_each(F&& f) const {
+		for (const Slot& slot : slots) if (slot.guild_id != 0) f(slot.guild_id, slot.settings);
+	}
+
+private:
+	struct Slot {
+		uint64_t guild_id{ 0 };
+		GuildSettings settings{};
+	};
+
+	std::vector<Slot> slots{};
+	std::size_t count{ 0 };
+
+	std::size_t slot_of(const uint64_t guild_id) const;
+	void grow();
+};
+
+// The fixed-width record of one guild in a binary snapshot, read in place from the mapping
+struct GuildSettingsRecord {
+	std::array<uint64_t, command_type_count> log_channels{};
+	std::array<uint64_t, command_type_count> webhook_ids{};
+	uint64_t features{ 0 };
+
+	bool has(const GuildFeature feature) const {
+		return (features >> static_cast<std::size_t>(feature)) & 1;
+	}
+
+	GuildSettings decode() const;
+	static GuildSettingsRecord encode(const GuildSettings& settings);
+};
+
+// The numbers of the files named `<base>.<number>` next to `base`, ascending
+std::vector<uint64_t> list_file_generations(const std::filesystem::path& base);
+std::filesystem::path file_generation_path(const std::filesystem::path& base, const uint64_t number);
+
+/*
+ * @brief A binary settings snapshot, memory mapped and queried in place
+ *
+ * Layout: a 32 byte header (magic, format version, byte order, record size and guild count),
+ * the guild IDs sorted ascending, then one `GuildSettingsRecord` per guild in the same order
+ * Opening only checks the header, lookups binary search the ID array, and pages are only
+ * read in as lookups touch them. A snapshot is never modified, a new one replaces it
+ * in a new file, as Windows can't replace or delete a file while it is mapped
+ */
+class GuildSettingsSnapshot {
+public:
+	GuildSettingsSnapshot() = default;
+	GuildSettingsSnapshot(const GuildSettingsSnapshot&) = delete;
+	GuildSettingsSnapshot& operator=(const GuildSettingsSnapshot&) = delete;
+	~GuildSettingsSnapshot();
+
+	// Returns false if the file is missing or isn't a snapshot this build can read
+	bool open(const std::filesystem::path& snapshot_path);
+	// Reads a snapshot of an older format into a map, so it can be rewritten. Returns nullopt if the file isn't one
+	static std::optional<GuildSettingsMap> read_legacy(const std::filesystem::path& path);
+
+	const GuildSettingsRecord* find(const uint64_t guild_id) const;
+	std::size_t size() const;
+
+	// The whole file, ex. to copy it somewhere
+	std::span<const uint8_t> bytes() const;
+
+	// Deletes the file once the last reference to the snapshot is gone and it is unmapped
+	void remove_when_released() const;
+
+	template <typename F>
+	void for_each(F&& f) const {
+		for (std::size_t i{ 0 }; i < count; ++i) f(guild_ids[i], records[i]);
+	}
+
+	/*
+	 * @brief Writes `base` with `changes` laid over it as a new snapshot at `path`
+	 * Guilds without a log channel are left out. The file is replaced atomically
+	 */
+	static bool write(const std::filesystem::path& path, const GuildSettingsSnapshot& base, const GuildSettingsMap& changes);
+
+private:
+	MappedFile file{};
+	std::filesystem::path path{};
+	mutable std::atomic<bool> remove_on_release{ false }; // Not part of the settings, so it can be set on a published snapshot
+	const uint64_t* guild_ids{ nullptr };
+	const GuildSettingsRecord* records{ nullptr };
+	std::size_t count{ 0 };
+};
+
+// JSON is only the import and export format, the layout of `guild_settings.json` only matters here
+nlohmann::json guild_settings_to_json(const GuildSettingsMap& settings);
+// Entries that can't be read are skipped with a warning, the rest still loads
+GuildSettingsMap guild_settings_from_json(const nlohmann::json& document);
+
+// One change to the settings, as stored in the write-ahead log
+struct SettingsChange {
+	enum class Kind : uint8_t {
+		LogChannel,
+		LogWebhook,
+		ForgetLogWebhook
+	};
+
+	Kind kind{ Kind::LogChannel };
+	uint64_t guild_id{ 0 };
+	uint64_t channel_id{ 0 };
+	CommandType command_type{ CommandType::Unknown }; // `LogChannel` only
+	uint64_t webhook_id{ 0 }; // `LogWebhook` only, the token isn't logged
+};
+
+/*
+ * @brief Applies a change to `settings`
+ *
+ * Every change sets absolute values, so replaying changes the settings already have is harmless
+ * @return false if the change doesn't apply, ex. a webhook for a channel that isn't a log channel
+ */
+bool apply_settings_change(GuildSettingsMap& settings, const SettingsChange& change);
+
+/*
+ * @brief Write-ahead log of settings changes, in numbered generations
+ *
+ * Each record is a u32 length, the CRC-32 of the payload and the payload (the change as
+ * compact JSON), synced to disk before `append` returns. A checkpoint starts a new
+ * generation; once the snapshot covering the older ones is written, they are deleted
+ * On startup every generation left is replayed, oldest first, and a torn record at the
+ * end of one is cut off
+ */
+class SettingsLog {
+public:
+	SettingsLog() = default;
+	SettingsLog(const SettingsLog&) = delete;
+	SettingsLog& operator=(const SettingsLog&) = delete;
+	~SettingsLog();
+
+	/*
+	 * @brief Reads every generation of the log at `base_path` and opens a new generation for appends
+	 * @return The logged changes, oldest first
+	 */
+	std::vector<SettingsChange> open(const std::filesystem::path& base_path);
+	void close();
+
+	// Returns once the change is on the disk. Returns false if it couldn't be written, the log is then cut back to its last record
+	bool append(const SettingsChange& change);
+
+	// Starts a new generation. Returns the generation that was closed
+	uint64_t rotate();
+
+	// Deletes every generation up to and including `generation`, the snapshot covers them
+	void retire(const uint64_t generation);
+
+	// Bytes written to the current generation
+	std::size_t size() const;
+
+	// Renames every generation of the log at `base_path` to `.discarded`, so none is replayed
+	void discard(const std::filesystem::path& base_path);
+
+private:
+	std::filesystem::path base{};
+	std::FILE* writer{ nullptr };
+	uint64_t generation{ 0 };
+	std::size_t written{ 0 }; // Size of the current generation up to its last complete record
+
+	std::filesystem::path generation_path(const uint64_t number) const;
+	std::vector<uint64_t> list_generations() const;
+	bool open_generation(const uint64_t number);
+};
+
+#endif // GUILD_SETTINGS_HPP
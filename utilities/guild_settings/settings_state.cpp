@@ -0,0 +1,67 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <memory>
+ * #include <atomic>
+ * #include <cstdint>
+ * #include <guild_settings/guild_settings.hpp>
+ * #include <guild_settings/settings_state.hpp>
+ */
+
+#include <pch.hpp>
+
+bool GuildSettingsState::apply(const SettingsChange& change) {
+	if (!changes.find(change.guild_id)) {
+		if (const GuildSettingsRecord* record{ snapshot->find(change.guild_id) }) changes.get_or_insert(change.guild_id) = record->decode();
+	}
+	return apply_settings_change(changes, change);
+}
+
+const GuildSettingsState& GuildSettingsStore::current() const {
+	// One per thread, the store is checked too so a thread reading two stores doesn't mix them up
+	struct Cached {
+		const GuildSettingsStore* store{ nullptr };
+		uint64_t version{ 0 };
+		std::shared_ptr<const GuildSettingsState> state{};
+	};
+	thread_local Cached cached{};
+
+	const uint64_t current_version{ version.load(std::memory_order_acquire) };
+	if (cached.store != this || cached.version != current_version) {
+		cached.state = state.load(std::memory_order_acquire);
+		cached.store = this;
+		cached.version = current_version;
+	}
+	return *cached.state;
+}
+
+std::shared_ptr<const GuildSettingsState> GuildSettingsStore::load() const {
+	return state.load(std::memory_order_acquire);
+}
+
+std::shared_ptr<GuildSettingsState> GuildSettingsStore::copy_with(const SettingsChange& change) const {
+	std::shared_ptr<GuildSettingsState> next{ std::make_shared<GuildSettingsState>(*state.load(std::memory_order_acquire)) };
+	if (!next->apply(change)) return nullptr;
+	return next;
+}
+
+void GuildSettingsStore::publish(std::shared_ptr<const GuildSettingsState> next) {
+	state.store(std::move(next), std::memory_order_release);
+	version.fetch_add(1, std::memory_order_release);
+}
@@ -0,0 +1,69 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SETTINGS_STATE_HPP
+#define SETTINGS_STATE_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <memory>
+ * #include <atomic>
+ * #include <cstdint>
+ * #include <guild_settings/guild_settings.hpp>
+ */
+
+#include <pch.hpp>
+
+// The binary snapshot the settings are read from in place, and the guilds changed since it was written
+struct GuildSettingsState {
+	std::shared_ptr<const GuildSettingsSnapshot> snapshot{ std::make_shared<const GuildSettingsSnapshot>() };
+	GuildSettingsMap changes{};
+
+	// A guild's first change since the snapshot starts from its record. Returns false if the change doesn't apply
+	bool apply(const SettingsChange& change);
+};
+
+/*
+ * @brief The settings state readers see, published through an atomic pointer
+ *
+ * Published states are never modified, writers copy the current one and publish the copy
+ * Readers never take a lock. Writers must be ordered by the caller, ex. with a mutex
+ */
+class GuildSettingsStore {
+public:
+	/*
+	 * Each thread keeps its own reference until a newer version is published, so a read
+	 * is an atomic load and a compare, with no shared reference count
+	 * The reference is valid until the calling thread's next call
+	 */
+	const GuildSettingsState& current() const;
+	std::shared_ptr<const GuildSettingsState> load() const;
+
+	// A copy of the current state with `change` applied, only the guilds changed since the snapshot are copied
+	// Returns nullptr if the change doesn't apply
+	std::shared_ptr<GuildSettingsState> copy_with(const SettingsChange& change) const;
+	void publish(std::shared_ptr<const GuildSettingsState> next);
+
+private:
+	std::atomic<std::shared_ptr<const GuildSettingsState>> state{ std::make_shared<const GuildSettingsState>() };
+	// Bumped after each publish, so readers know when their cached state is stale
+	std::atomic<uint64_t> version{ 1 };
+};
+
+#endif // SETTINGS_STATE_HPP
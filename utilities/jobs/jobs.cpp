@@ -0,0 +1,212 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <fstream>
+ * #include <string>
+ * #include <vector>
+ * #include <unordered_map>
+ * #include <functional>
+ * #include <memory>
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <filesystem>
+ * #include <format>
+ * #include <chrono>
+ * #include <exception>
+ * #include <cstdint>
+ * #include <dpp/cluster.h>
+ * #include <dpp/dispatcher.h>
+ * #include <dpp/nlohmann/json.hpp>
+ * #include <jobs/jobs.hpp>
+ * #include <shutdown/shutdown.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+using json = nlohmann::json;
+
+JobEngine job_engine;
+
+static const std::filesystem::path jobs_directory{ "data/jobs" };
+
+// How long pausing waits for the jobs' outstanding calls before checkpointing them as they are
+static constexpr std::chrono::seconds job_drain_deadline{ 2 };
+
+static std::filesystem::path checkpoint_path(const std::string& id) {
+	return jobs_directory / (id + ".json");
+}
+
+void Job::pause() {
+	std::scoped_lock lock{ mtx };
+	paused = true;
+}
+
+void Job::drain(const std::chrono::steady_clock::time_point deadline) {
+	std::unique_lock lock{ mtx };
+	if (!drained_cv.wait_until(lock, deadline, [this] { return outstanding_calls == 0; }))
+		Logger::warn(false, "Job {} still had {} calls outstanding when it was checkpointed", id, outstanding_calls);
+	if (!finished) write_checkpoint();
+}
+
+void Job::call_completed() {
+	if (outstanding_calls > 0 && --outstanding_calls == 0) drained_cv.notify_all();
+}
+
+void Job::checkpoint() {
+	if (paused || finished) return;
+	write_checkpoint();
+}
+
+void Job::write_checkpoint() {
+	const auto guard{ pending_writes.track() };
+	const json file_content{ { "type", type }, { "state", save() } };
+
+	try {
+		std::filesystem::create_directories(jobs_directory);
+
+		// Write to a temporary file first, a crash mid-write then can't leave a truncated checkpoint behind
+		const std::filesystem::path path{ checkpoint_path(id) };
+		std::filesystem::path temp_path{ path };
+		temp_path += ".tmp";
+		{
+			std::ofstream file{ temp_path, std::ios::trunc };
+			if (!file.is_open()) {
+				Logger::error(false, "Couldn't open {} for writing", temp_path.string());
+				return;
+			}
+			file << file_content.dump();
+		}
+		std::filesystem::rename(temp_path, path);
+	}
+	catch (const std::exception& e) {
+		Logger::exception(false, "Failed to checkpoint job {}: {}", id, std::string{ e.what() });
+	}
+}
+
+void Job::finish() {
+	if (finished) return;
+	finished = true;
+
+	std::error_code ec{};
+	std::filesystem::remove(checkpoint_path(id), ec);
+	if (ec) Logger::warn(false, "Couldn't delete the checkpoint of job {}: {}", id, ec.message());
+
+	job_engine.remove(id);
+}
+
+void JobEngine::register_type(std::string type, Factory factory) {
+	std::scoped_lock lock{ mtx };
+	factories[std::move(type)] = std::move(factory);
+}
+
+std::string JobEngine::start(dpp::cluster& bot, const std::string& type, const json& state) {
+	std::shared_ptr<Job> job{};
+	{
+		std::scoped_lock lock{ mtx };
+		const auto it{ factories.find(type) };
+		if (it == factories.end()) throw std::logic_error("No job type named " + type);
+
+		const uint64_t now_ms{ static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()) };
+		job = it->second(std::format("{}_{:x}_{}", type, now_ms, next_serial++), state);
+		running[job->get_id()] = job;
+	}
+
+	Logger::info(false, "Started job {}", job->get_id());
+	job->run(bot);
+	return job->get_id();
+}
+
+void JobEngine::attach(dpp::cluster& bot) {
+	// A rebuilt cluster picks up whatever the previous one paused
+	const auto cluster_once{ std::make_shared<std::once_flag>() };
+
+	bot.on_ready([this, &bot, cluster_once](const dpp::ready_t&) {
+		std::call_once(*cluster_once, [this, &bot] { resume_checkpointed(bot); });
+	});
+}
+
+void JobEngine::pause_all() {
+	std::unordered_map<std::string, std::shared_ptr<Job>> paused{};
+	{
+		std::scoped_lock lock{ mtx };
+		paused.swap(running);
+	}
+
+	// Outside the engine lock, a job finishing right now takes its own lock and then the engine's
+	for (const auto& [id, job] : paused) job->pause();
+
+	// The scheduler is still running, so queued calls come up as cancelled and in-flight ones complete
+	// Checkpointing after that, rather than right away, records the results of the calls that did go out
+	const auto deadline{ std::chrono::steady_clock::now() + job_drain_deadline };
+	for (const auto& [id, job] : paused) job->drain(deadline);
+
+	if (!paused.empty()) Logger::info(true, "Paused {} jobs", paused.size());
+}
+
+std::size_t JobEngine::running_count() const {
+	std::scoped_lock lock{ mtx };
+	return running.size();
+}
+
+void JobEngine::remove(const std::string& id) {
+	std::scoped_lock lock{ mtx };
+	running.erase(id);
+}
+
+void JobEngine::resume_checkpointed(dpp::cluster& bot) {
+	std::error_code ec{};
+	if (!std::filesystem::is_directory(jobs_directory, ec)) return;
+
+	std::vector<std::shared_ptr<Job>> resumed{};
+
+	for (const auto& entry : std::filesystem::directory_iterator{ jobs_directory, ec }) {
+		if (entry.path().extension() != ".json") continue;
+		const std::string id{ entry.path().stem().string() };
+
+		try {
+			json file_content{};
+			{
+				std::ifstream file{ entry.path() };
+				file >> file_content;
+			}
+
+			std::scoped_lock lock{ mtx };
+			if (running.contains(id)) continue;
+
+			const auto it{ factories.find(file_content.at("type").get<std::string>()) };
+			if (it == factories.end()) {
+				Logger::warn(true, "Skipped checkpoint {}, its job type isn't registered", entry.path().string());
+				continue;
+			}
+
+			std::shared_ptr<Job> job{ it->second(id, file_content.at("state")) };
+			running[id] = job;
+			resumed.push_back(std::move(job));
+		}
+		catch (const std::exception& e) {
+			Logger::exception(true, "Couldn't resume job from {}: {}", entry.path().string(), std::string{ e.what() });
+		}
+	}
+
+	for (const auto& job : resumed) {
+		Logger::info(true, "Resuming job {}", job->get_id());
+		job->run(bot);
+	}
+}
@@ -0,0 +1,137 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef JOBS_HPP
+#define JOBS_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <string>
+ * #include <unordered_map>
+ * #include <functional>
+ * #include <memory>
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <chrono>
+ * #include <atomic>
+ * #include <cstdint>
+ * #include <dpp/cluster.h>
+ * #include <dpp/nlohmann/json.hpp>
+ */
+
+#include <pch.hpp>
+
+/*
+ * @brief A long running piece of work that survives a rebuilt cluster
+ *
+ * Jobs don't own a thread, they are driven by REST callbacks and timers
+ * Their state is checkpointed to `data/jobs/<id>.json` and resumed from there by the next cluster
+ */
+class Job : public std::enable_shared_from_this<Job> {
+public:
+	Job(std::string id, std::string type) : id{ std::move(id) }, type{ std::move(type) } {}
+	Job(const Job&) = delete;
+	Job& operator=(const Job&) = delete;
+	virtual ~Job() = default;
+
+	const std::string& get_id() const noexcept { return id; }
+	const std::string& get_type() const noexcept { return type; }
+
+	// Starts or resumes the job on `bot`. Must return quickly
+	virtual void run(dpp::cluster& bot) = 0;
+
+	// Stops the job from queueing more work on its cluster, its calls still queued are answered as cancelled
+	void pause();
+
+	/*
+	 * @brief Waits for a paused job's outstanding calls to complete, then writes its last checkpoint
+	 * Past `deadline` the checkpoint is written anyway, the calls still outstanding are redone on resume
+	 */
+	void drain(const std::chrono::steady_clock::time_point deadline);
+
+protected:
+	// Guards the state of the job, callbacks lock it and return early once `paused` is set
+	std::mutex mtx;
+	bool paused{ false };
+
+	// Everything needed to resume the job. Called with `mtx` held
+	virtual nlohmann::json save() const = 0;
+
+	// Writes the result of `save()` to disk. Must be called with `mtx` held
+	void checkpoint();
+
+	// Deletes the checkpoint and forgets the job. Must be called with `mtx` held
+	void finish();
+
+	// Counts a call the job queued. Must be called with `mtx` held, before the call is submitted
+	void call_queued() noexcept { ++outstanding_calls; }
+
+	// Counts a call whose callback ran, paused or not. Must be called with `mtx` held
+	void call_completed();
+
+private:
+	const std::string id;
+	const std::string type;
+	bool finished{ false };
+
+	std::size_t outstanding_calls{ 0 };
+	std::condition_variable drained_cv;
+
+	void write_checkpoint();
+};
+
+/*
+ * @brief Starts, pauses and resumes `Job`s
+ * Each job type registers a factory that rebuilds a job from its checkpointed state
+ */
+class JobEngine {
+public:
+	using Factory = std::function<std::shared_ptr<Job>(std::string id, const nlohmann::json& state)>;
+
+	void register_type(std::string type, Factory factory);
+
+	/*
+	 * @brief Creates a job from `state`, checkpoints it and runs it
+	 * @return The ID of the job
+	 */
+	std::string start(dpp::cluster& bot, const std::string& type, const nlohmann::json& state);
+
+	// Resumes the checkpointed jobs once `bot` first becomes ready
+	void attach(dpp::cluster& bot);
+
+	// Pauses every running job and checkpoints it once its outstanding calls are done. Called before the cluster goes away
+	void pause_all();
+
+	std::size_t running_count() const;
+
+private:
+	friend class Job;
+
+	mutable std::mutex mtx;
+	std::unordered_map<std::string, Factory> factories;
+	std::unordered_map<std::string, std::shared_ptr<Job>> running;
+	uint64_t next_serial{ 0 };
+
+	void remove(const std::string& id);
+	void resume_checkpointed(dpp::cluster& bot);
+};
+
+extern JobEngine job_engine;
+
+#endif // JOBS_HPP
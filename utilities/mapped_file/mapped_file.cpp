@@ -0,0 +1,117 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <filesystem>
+ * #include <utility>
+ * #include <cstdint>
+ * #include <Windows.h> (Windows only)
+ * #include <sys/mman.h> (POSIX only)
+ * #include <sys/stat.h> (POSIX only)
+ * #include <fcntl.h> (POSIX only)
+ * #include <unistd.h> (POSIX only)
+ * #include <mapped_file/mapped_file.hpp>
+ */
+
+#include <pch.hpp>
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+#ifdef _WIN32
+	: file{ std::exchange(other.file, INVALID_HANDLE_VALUE) }, mapping{ std::exchange(other.mapping, nullptr) },
+	view{ std::exchange(other.view, nullptr) }, length{ std::exchange(other.length, 0) } {}
+#else
+	: view{ std::exchange(other.view, nullptr) }, length{ std::exchange(other.length, 0) } {}
+#endif // _WIN32
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this == &other) return *this;
+	unmap();
+#ifdef _WIN32
+	file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+	mapping = std::exchange(other.mapping, nullptr);
+#endif // _WIN32
+	view = std::exchange(other.view, nullptr);
+	length = std::exchange(other.length, 0);
+	return *this;
+}
+
+MappedFile::~MappedFile() {
+	unmap();
+}
+
+bool MappedFile::map(const std::filesystem::path& path) {
+	unmap();
+
+#ifdef _WIN32
+	// FILE_SHARE_WRITE and FILE_SHARE_DELETE, so the file can still be appended to and replaced
+	file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER file_size{};
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		unmap();
+		return false;
+	}
+
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		unmap();
+		return false;
+	}
+
+	view = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!view) {
+		unmap();
+		return false;
+	}
+	length = static_cast<std::size_t>(file_size.QuadPart);
+#else
+	const int fd{ ::open(path.c_str(), O_RDONLY) };
+	if (fd < 0) return false;
+
+	struct stat file_stat{};
+	if (::fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	// The mapping keeps the file alive on its own, the descriptor isn't needed past here
+	void* mapped{ ::mmap(nullptr, static_cast<std::size_t>(file_stat.st_size), PROT_READ, MAP_SHARED, fd, 0) };
+	::close(fd);
+	if (mapped == MAP_FAILED) return false;
+
+	view = static_cast<const uint8_t*>(mapped);
+	length = static_cast<std::size_t>(file_stat.st_size);
+#endif // _WIN32
+
+	return true;
+}
+
+void MappedFile::unmap() noexcept {
+#ifdef _WIN32
+	if (view) UnmapViewOfFile(view);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (view) ::munmap(const_cast<uint8_t*>(view), length);
+#endif // _WIN32
+	view = nullptr;
+	length = 0;
+}
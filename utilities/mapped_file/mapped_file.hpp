@@ -0,0 +1,62 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <filesystem>
+ * #include <utility>
+ * #include <cstdint>
+ * #include <Windows.h> (Windows only)
+ */
+
+#include <pch.hpp>
+
+/*
+ * @brief A read-only memory mapping of a whole file
+ * The mapping covers the file as it was when `map` was called, call it again to see later appends
+ */
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	~MappedFile();
+
+	// Returns false if the file couldn't be opened or mapped, the previous mapping is released either way
+	bool map(const std::filesystem::path& path);
+	void unmap() noexcept;
+
+	const uint8_t* data() const noexcept { return view; }
+	std::size_t size() const noexcept { return length; }
+
+private:
+#ifdef _WIN32
+	HANDLE file{ INVALID_HANDLE_VALUE };
+	HANDLE mapping{ nullptr };
+#endif // _WIN32
+	const uint8_t* view{ nullptr };
+	std::size_t length{ 0 };
+};
+
+#endif // MAPPED_FILE_HPP
@@ -17,34 +17,165 @@
 
 /*
  * The following includes are performed:
- * #include <corecrt.h>
  * #include <fstream>
  * #include <string>
+ * #include <vector>
  * #include <optional>
+ * #include <unordered_map>
  * #include <filesystem>
  * #include <chrono>
  * #include <mutex>
+ * #include <atomic>
+ * #include <condition_variable>
+ * #include <thread>
  * #include <functional>
  * #include <format>
  * #include <memory>
- * #include <ctime>
+ * #include <string_view>
  * #include <cstdint>
- * #include <dpp/cluster.h>
- * #include <dpp/timer.h>
  * #include <dpp/nlohmann/json.hpp>
  * #include <dpp/nlohmann/json_fwd.hpp>
  * #include <other_utils.hpp>
- * #include <Ishmael.hpp>
+ * #include <guild_settings/guild_settings.hpp>
+ * #include <guild_settings/settings_state.hpp>
+ * #include <durable_file/durable_file.hpp>
+ * #include <backup/backup.hpp>
  * #include <utilities/logger/logger.hpp>
+ * #include <shutdown/shutdown.hpp>
  */
 
 #include <pch.hpp>
 
 using json = nlohmann::json;
 
-static json guild_settings_json;
-static std::mutex settings_mutex;
-static const std::string guild_settings_file_path{ "data/guild_settings.json" };
+// Read on every audit log, written only when a moderator changes something
+static GuildSettingsStore guild_settings;
+// Orders the writers, their publishes and their log appends, readers never take it
+static std::mutex settings_write_mutex;
+// Webhook tokens are credentials, they're only kept in memory and never written with the settings
+// After a restart a webhook has no token here, and `ensure_log_webhook` replaces it
+static std::mutex webhook_tokens_mutex;
+static std::unordered_map<uint64_t, std::string> webhook_tokens{}; // By webhook ID
+// Imported on startup if present, then renamed to `.imported`
+static const std::string guild_settings_import_path{ "data/guild_settings.json" };
+
+// A change is acknowledged once it's in the log, the snapshot catches up in the background
+static SettingsLog settings_log;
+// Set by writers, cleared by checkpoints. Guarded by `settings_write_mutex`
+static bool settings_dirty{ false };
+
+// The log is folded into a new snapshot this often, or sooner once it grows past `checkpoint_log_size`
+static constexpr std::chrono::seconds checkpoint_interval{ 30 };
+static constexpr std::size_t checkpoint_log_size{ 64 * 1024 };
+
+// Keeps two checkpoints from writing the snapshot at once
+static std::mutex settings_file_mutex;
+// Number of the newest snapshot file, the next checkpoint writes the one after. Guarded by `settings_file_mutex`
+static uint64_t last_snapshot_generation{ 0 };
+
+// `data/guild_settings.bin.<number>`
+static std::filesystem::path snapshot_generation_path(const uint64_t number) {
+	return file_generation_path(guild_settings_snapshot_path, number);
+}
+
+static std::mutex checkpoint_mutex;
+static std::condition_variable checkpoint_cv;
+static bool checkpoint_requested{ false };
+static bool settings_writer_running{ false };
+static std::thread settings_writer;
+
+/*
+ * Folds the log into a new snapshot: the current state is written to a temporary file and
+ * renamed into place, then mapped and published, and the log generations it covers are deleted
+ * Returns false if the snapshot couldn't be written, the log then keeps the changes
+ */
+static bool checkpoint_guild_settings() {
+	const auto in_flight{ pending_writes.track() };
+	std::scoped_lock file_lock{ settings_file_mutex };
+
+	std::shared_ptr<const GuildSettingsState> written{};
+	uint64_t covered_generation{ 0 };
+	{
+		std::scoped_lock lock{ settings_write_mutex };
+		if (!settings_dirty) return true;
+
+		// Changes from here on go to a new generation, the snapshot covers the closed ones
+		written = guild_settings.load();
+		covered_generation = settings_log.rotate();
+		settings_dirty = false;
+	}
+
+	// Written with no settings lock held, readers and writers carry on meanwhile
+	// Each snapshot gets a new file, the current one stays mapped until its readers move on
+	const std::filesystem::path snapshot_path{ snapshot_generation_path(last_snapshot_generation + 1) };
+	std::shared_ptr<GuildSettingsSnapshot> snapshot{ std::make_shared<GuildSettingsSnapshot>() };
+	if (!GuildSettingsSnapshot::write(snapshot_path, *written->snapshot, written->changes) || !snapshot->open(snapshot_path)) {
+		Logger::error(true, "Couldn't write the settings snapshot, the changes stay in the log");
+		std::scoped_lock lock{ settings_write_mutex };
+		settings_dirty = true; // Retried on the next checkpoint
+		return false;
+	}
+
+	{
+		std::scoped_lock lock{ settings_write_mutex };
+
+		// Guilds changed again while the snapshot was written stay in `changes`
+		const std::shared_ptr<const GuildSettingsState> current{ guild_settings.load() };
+		std::shared_ptr<GuildSettingsState> next{ std::make_shared<GuildSettingsState>() };
+		next->snapshot = snapshot;
+		current->changes.for_each([&next, &written](const uint64_t guild_id, const GuildSettings& settings) {
+			const GuildSettings* in_snapshot{ written->changes.find(guild_id) };
+			if (!in_snapshot || !(*in_snapshot == settings)) next->changes.get_or_insert(guild_id) = settings;
+		});
+
+		guild_settings.publish(std::move(next));
+		settings_log.retire(covered_generation);
+	}
+	++last_snapshot_generation;
+	// Deleted once the last reader lets go of it, Windows can't delete a mapped file
+	written->snapshot->remove_when_released();
+
+	backup_engine.request();
+	return true;
+}
+
+static void request_checkpoint() {
+	{
+		std::scoped_lock lock{ checkpoint_mutex };
+		checkpoint_requested = true;
+	}
+	checkpoint_cv.notify_one();
+}
+
+/*
+ * Applies a change to a copy of the state, logs it and publishes the copy
+ * Only the guilds changed since the last snapshot are copied
+ * The change is on the disk when this returns. Returns false if it didn't apply
+ */
+static bool update_guild_settings(const SettingsChange& change) {
+	bool logged{ true };
+	bool log_full{ false };
+	{
+		std::scoped_lock lock{ settings_write_mutex };
+
+		std::shared_ptr<GuildSettingsState> next{ guild_settings.copy_with(change) };
+		if (!next) return false;
+
+		logged = settings_log.append(change);
+		guild_settings.publish(std::move(next));
+		settings_dirty = true;
+		log_full = settings_log.size() >= checkpoint_log_size;
+	}
+
+	// Without the log, the change is only durable once a new snapshot is written
+	if (!logged) {
+		Logger::warn(true, "A settings change couldn't be logged, writing the settings snapshot right away");
+		checkpoint_guild_settings();
+	}
+	else if (log_full) request_checkpoint();
+
+	return true;
+}
 
 inline std::string convert_time(uint64_t total_seconds) {
 	const uint64_t days{ total_seconds / 86400 };
@@ -59,172 +190,218 @@ inline std::string convert_time(uint64_t total_seconds) {
     return std::format("{}d {}h {}m {}s", days, hours, minutes, seconds);
 }
 
+std::string_view utf8_prefix(const std::string_view text, const std::size_t max_bytes) {
+	if (text.size() <= max_bytes) return text;
+
+	// Backs off continuation bytes (10xxxxxx) until the cut falls before the start of a code point
+	std::size_t cut{ max_bytes };
+	while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) --cut;
+	return text.substr(0, cut);
+}
+
 std::optional<uint64_t> get_log_channel(const uint64_t guild_id, const CommandType command_type) {
-	std::scoped_lock lock{ settings_mutex };
-	const std::string guild_id_str{ std::to_string(guild_id) };
-
-	if (guild_settings_json.contains(guild_id_str)) { // Check if the Guild ID exists in our JSON
-		const std::string channel_type{ [command_type]() -> std::string {
-			switch (command_type) {
-			case CommandType::RoleEdit: return "role_edit_logging_channel_id";
-			case CommandType::BanEdit: return "ban_edit_logging_channel_id";
-			default: return "general_logging_channel_id";
-			}
-		}() };
-
-		if (guild_settings_json[guild_id_str].contains(channel_type)) { // Check if the specific key exists in our JSON
-			return guild_settings_json[guild_id_str][channel_type].get<uint64_t>();
-		}
-	}
-	return std::nullopt; // Not found
+	const GuildSettingsState& state{ guild_settings.current() };
+	const std::size_t index{ static_cast<std::size_t>(command_type) };
+
+	uint64_t channel_id{ 0 };
+	// A guild changed since the snapshot was written is only up to date in `changes`
+	if (const GuildSettings* changed{ state.changes.find(guild_id) }) channel_id = changed->log_channels[index];
+	else if (const GuildSettingsRecord* record{ state.snapshot->find(guild_id) }) channel_id = record->log_channels[index];
+
+	if (channel_id == 0) return std::nullopt; // Not set
+	return channel_id;
 }
 
-static void write_guild_settings() {
-	std::string json_data{};
-	{
-		std::scoped_lock lock{ settings_mutex };
-		json_data = guild_settings_json.dump(4);
-	}
+void save_log_channel(const uint64_t guild_id, const uint64_t channel_id, const CommandType command_type) {
+	update_guild_settings(SettingsChange{ .kind = SettingsChange::Kind::LogChannel, .guild_id = guild_id, .channel_id = channel_id, .command_type = command_type });
+}
+
+std::optional<uint64_t> get_log_webhook_id(const uint64_t guild_id, const uint64_t channel_id) {
+	const GuildSettingsState& state{ guild_settings.current() };
 
-	std::ofstream file{ guild_settings_file_path };
-	if (!file.is_open()) {
-		Logger::exception(true, "Couldn't open {} for writing", guild_settings_file_path);
-		return;
+	if (const GuildSettings* changed{ state.changes.find(guild_id) }) {
+		if (!changed->has(GuildFeature::LogWebhooks)) return std::nullopt;
+		for (std::size_t i{ 0 }; i < command_type_count; ++i) {
+			if (changed->log_channels[i] == channel_id && changed->log_webhooks[i] != 0) return changed->log_webhooks[i];
+		}
+		return std::nullopt;
 	}
 
-	file << json_data;
-	file.close();
+	const GuildSettingsRecord* record{ state.snapshot->find(guild_id) };
+	if (!record || !record->has(GuildFeature::LogWebhooks)) return std::nullopt;
 
-	backup_guild_settings("backups/backup-instant-1/guild_settings.json");
-	backup_guild_settings("backups/backup-instant-2/guild_settings.json");
+	for (std::size_t i{ 0 }; i < command_type_count; ++i) {
+		if (record->log_channels[i] == channel_id && record->webhook_ids[i] != 0) return record->webhook_ids[i];
+	}
+	return std::nullopt;
 }
 
-void save_log_channel(const uint64_t guild_id, const uint64_t channel_id, const CommandType command_type) {
-	std::string guild_id_str{ std::to_string(guild_id) };
+std::optional<LogWebhook> get_log_webhook(const uint64_t guild_id, const uint64_t channel_id) {
+	const auto webhook_id{ get_log_webhook_id(guild_id, channel_id) };
+	if (!webhook_id.has_value()) return std::nullopt;
 
-	const std::string channel_type{ [command_type]() -> std::string {
-		switch (command_type) {
-		case CommandType::RoleEdit: return "role_edit_logging_channel_id";
-		case CommandType::BanEdit: return "ban_edit_logging_channel_id";
-		default: return "general_logging_channel_id";
-		}
-	}() };
+	std::scoped_lock lock{ webhook_tokens_mutex };
+	const auto it{ webhook_tokens.find(*webhook_id) };
+	if (it == webhook_tokens.end()) return std::nullopt;
+	return LogWebhook{ .id = *webhook_id, .token = it->second };
+}
 
-	// Update the in-memory object
+void save_log_webhook(const uint64_t guild_id, const uint64_t channel_id, const LogWebhook& webhook) {
 	{
-		std::scoped_lock lock{ settings_mutex };
-		guild_settings_json[guild_id_str][channel_type] = channel_id;
+		std::scoped_lock lock{ webhook_tokens_mutex };
+		webhook_tokens.insert_or_assign(webhook.id, webhook.token);
 	}
+	// Not stored if the channel stopped being a log channel while the webhook was created
+	update_guild_settings(SettingsChange{ .kind = SettingsChange::Kind::LogWebhook, .guild_id = guild_id, .channel_id = channel_id, .webhook_id = webhook.id });
+}
+
+void forget_log_webhook(const uint64_t guild_id, const uint64_t channel_id) {
+	// Checked on the current state first, so a guild without webhooks doesn't copy anything
+	const auto webhook_id{ get_log_webhook_id(guild_id, channel_id) };
+	if (!webhook_id.has_value()) return;
 
-	write_guild_settings();
+	{
+		std::scoped_lock lock{ webhook_tokens_mutex };
+		webhook_tokens.erase(*webhook_id);
+	}
+	update_guild_settings(SettingsChange{ .kind = SettingsChange::Kind::ForgetLogWebhook, .guild_id = guild_id, .channel_id = channel_id });
 }
 
 void load_guild_settings() {
-	std::unique_lock lock{ settings_mutex };
-	std::ifstream file{ guild_settings_file_path };
-
-	if (!file.is_open()) {
-		Logger::info(true, "{} not found, creating a new one", guild_settings_file_path);
+	std::shared_ptr<GuildSettingsState> loaded{ std::make_shared<GuildSettingsState>() };
+
+	// Mapped, not parsed: only the header is read here, the records are paged in as guilds are looked up
+	std::shared_ptr<GuildSettingsSnapshot> snapshot{ std::make_shared<GuildSettingsSnapshot>() };
+	std::error_code ec{};
+	std::vector<uint64_t> generations{ list_file_generations(guild_settings_snapshot_path) };
+
+	// An unnumbered snapshot was restored from a backup or written by an older build, it becomes the newest generation
+	// Renamed before it's mapped, Windows can't rename a mapped file
+	if (std::filesystem::exists(guild_settings_snapshot_path, ec)) {
+		const uint64_t number{ generations.empty() ? 1 : generations.back() + 1 };
+		std::filesystem::rename(guild_settings_snapshot_path, snapshot_generation_path(number), ec);
+		if (ec) Logger::error(true, "Couldn't number {}, it was left out: {}", guild_settings_snapshot_path, ec.message());
+		else generations.push_back(number);
+	}
 
-		try {
-			std::filesystem::create_directory("data");
+	last_snapshot_generation = generations.empty() ? 0 : generations.back();
+	if (generations.empty()) Logger::info(true, "No settings snapshot in {}, starting with empty settings", std::filesystem::path{ guild_settings_snapshot_path }.parent_path().string());
+
+	// Newest first. One that can't be read is moved aside and the one before it is tried, so a bad file doesn't empty the settings
+	std::filesystem::path snapshot_path{};
+	uint64_t read_generation{ 0 };
+	bool migrated{ false };
+	bool readable{ false };
+	for (auto it{ generations.rbegin() }; it != generations.rend() && !readable; ++it) {
+		read_generation = *it;
+		snapshot_path = snapshot_generation_path(read_generation);
+		readable = true;
+		if (snapshot->open(snapshot_path)) Logger::info(true, "Settings of {} guilds mapped from {}", snapshot->size(), snapshot_path.string());
+		else if (auto legacy{ GuildSettingsSnapshot::read_legacy(snapshot_path) }) {
+			// Rewritten in the current format by the checkpoint below
+			loaded->changes = std::move(*legacy);
+			migrated = true;
+			Logger::info(true, "Settings of {} guilds read from an older {}, it will be rewritten", loaded->changes.size(), snapshot_path.string());
 		}
-		catch (const std::filesystem::filesystem_error& e) {
-			Logger::exception(true, "Failed to create data directory: {}", e.what());
+		else {
+			// Moved aside, so it isn't taken for the newest generation again
+			std::filesystem::path unreadable_path{ snapshot_path };
+			unreadable_path += ".unreadable";
+			std::filesystem::rename(snapshot_path, unreadable_path, ec);
+			readable = false;
+			Logger::error(true, "{} isn't a settings snapshot this build can read, moved it to {}", snapshot_path.string(), unreadable_path.string());
 		}
 
-		guild_settings_json = json::object();
-		lock.unlock();
-		write_guild_settings();
+		// The log generations the newer snapshots covered were already deleted, so their changes are lost
+		if (readable && read_generation != last_snapshot_generation) {
+			Logger::warn(true, "Settings fell back to {}, changes made after it was written are lost", snapshot_path.string());
+		}
 	}
-	else {
+	if (!generations.empty() && !readable) Logger::error(true, "No settings snapshot could be read, starting with empty settings");
+
+	// Generations the one read replaced, left behind when the bot stopped before their last reader let go of them
+	if (readable) {
+		for (const uint64_t number : generations) {
+			if (number < read_generation) std::filesystem::remove(snapshot_generation_path(number), ec);
+		}
+	}
+	loaded->snapshot = std::move(snapshot);
+
+	// A settings file from before snapshots, or a restored JSON backup, is laid over the snapshot
+	bool imported{ false };
+	std::ifstream file{ guild_settings_import_path };
+	if (file.is_open()) {
 		try {
-			file >> guild_settings_json;
-			Logger::info(true, "Guild settings loaded from {}", guild_settings_file_path);
+			json document{};
+			file >> document;
+			const GuildSettingsMap imported_settings{ guild_settings_from_json(document) };
+			imported_settings.for_each([&loaded](const uint64_t guild_id, const GuildSettings& settings) { loaded->changes.get_or_insert(guild_id) = settings; });
+			imported = true;
+			Logger::info(true, "Imported the settings of {} guilds from {}", imported_settings.size(), guild_settings_import_path);
 		}
 		catch (const json::parse_error& e) {
-			Logger::exception(true, "Exception thrown while parsing {}: {}. Initialized empty settings.", guild_settings_file_path, e.what());
-			guild_settings_json = json::object();
+			Logger::exception(true, "Couldn't import {}, it was left in place: {}", guild_settings_import_path, e.what());
 		}
+		file.close();
 	}
-}
 
-void backup_guild_settings(const std::string& backup_file_path) {
-	std::scoped_lock lock{ settings_mutex };
-	try {
-		const std::filesystem::path path{ backup_file_path };
-		if (path.has_parent_path()) { std::filesystem::create_directories(path.parent_path()); }
+	bool replayed{ false };
+	{
+		std::scoped_lock lock{ settings_write_mutex };
 
-		std::ofstream backup_file{ backup_file_path };
-		if (!backup_file.is_open()) {
-			Logger::error(true, "Couldn't open `{}` for writing", backup_file_path);
-			return;
+		// Changes acknowledged after the snapshot was last written
+		for (const SettingsChange& change : settings_log.open(guild_settings_log_path)) {
+			loaded->apply(change);
+			replayed = true;
 		}
-		backup_file << guild_settings_json.dump(4);
-	}
-	catch (const std::filesystem::filesystem_error& e) {
-		Logger::exception(true, "File system exception while creating backup directory for `{}`: {}", backup_file_path, e.what());
-	}
-	catch (const std::exception& e) {
-		Logger::exception(true, "Exception during backup for `{}`: {}", backup_file_path, e.what());
-	}
-}
-
-void initialize_backups(dpp::cluster& bot) {
-	Logger::info(true, "Performing initial backups on startup");
-
-	backup_guild_settings("backups/backup-daily/guild_settings.json");
-	backup_guild_settings("backups/backup-per-12h/guild_settings.json");
-	backup_guild_settings("backups/backup-hourly/guild_settings.json");
-
-	const auto now{ std::chrono::system_clock::now() };
-	const std::time_t now_t{ std::chrono::system_clock::to_time_t(now) };
-	std::tm current_utc_time;
-
-#ifdef _WIN32
-	gmtime_s(&current_utc_time, &now_t);
-#else
-	gmtime_r(&now_t, &current_utc_time);
-#endif
 
-	const uint64_t seconds_past_hour{ static_cast<uint64_t>(current_utc_time.tm_min * 60) + static_cast<uint64_t>(current_utc_time.tm_sec) };
-	const uint64_t seconds_to_next_hour{ one_hour - (seconds_past_hour % one_hour) };
-
-	const uint64_t seconds_past_midnight{ static_cast<uint64_t>(current_utc_time.tm_hour) * one_hour + static_cast<uint64_t>(current_utc_time.tm_min * 60) + static_cast<uint64_t>(current_utc_time.tm_sec) };
-	const uint64_t seconds_to_next_midnight{ one_day - (seconds_past_midnight % one_day) };
+		guild_settings.publish(std::move(loaded));
+		settings_dirty = replayed || imported || migrated;
+	}
 
-	const uint64_t seconds_to_next_12_hr_mark{ twelve_hours - (seconds_past_midnight % twelve_hours) };
+	// Folded in right away, so the replayed generations don't pile up, the import isn't repeated and an older snapshot is replaced
+	if (!replayed && !imported && !migrated) return;
+	if (!checkpoint_guild_settings()) return;
+	if (imported) std::filesystem::rename(guild_settings_import_path, guild_settings_import_path + ".imported", ec);
+	// Never mapped, so nothing holds on to it
+	if (migrated) std::filesystem::remove(snapshot_path, ec);
+}
 
-	Logger::info(true, "Scheduling backups");
-	Logger::info(true, "Next hourly backup in {}", convert_time(seconds_to_next_hour));
-	Logger::info(true, "Next 12h backup in {}", convert_time(seconds_to_next_12_hr_mark));
-	Logger::info(true, "Next 00:00 UTC backup in {}", convert_time(seconds_to_next_midnight));
+void start_settings_writer() {
+	{
+		std::scoped_lock lock{ checkpoint_mutex };
+		if (settings_writer_running) return;
+		settings_writer_running = true;
+		checkpoint_requested = false;
+	}
 
-	auto schedule_backup = [&](const std::string& path, uint64_t initial_delay, uint64_t interval) {
-		bot.start_timer([&bot, path, interval](dpp::timer) {
-			Logger::info(true, "Performing first scheduled backup for: {}", path);
-			backup_guild_settings(path);
+	settings_writer = std::thread{ [] {
+		std::unique_lock lock{ checkpoint_mutex };
+		while (settings_writer_running) {
+			checkpoint_cv.wait_for(lock, checkpoint_interval, [] { return checkpoint_requested || !settings_writer_running; });
+			checkpoint_requested = false;
 
-			class RecurringBackupTask {
-			private:
-				dpp::cluster& bot;
-				const std::string path;
-				const uint64_t interval;
-			public:
-				RecurringBackupTask(dpp::cluster& bot, const std::string& path, const uint64_t interval) : bot{ bot }, path{ path }, interval{interval} {}
+			lock.unlock();
+			checkpoint_guild_settings();
+			lock.lock();
+		}
+	} };
+}
 
-				void operator()(dpp::timer) const {
-					Logger::info(true, "Performing recurring backup for: {}", path);
-					backup_guild_settings(path);
-					bot.start_timer(*this, interval);
-				}
-			};
+void stop_settings_writer() {
+	{
+		std::scoped_lock lock{ checkpoint_mutex };
+		if (!settings_writer_running) return;
+		settings_writer_running = false;
+	}
+	checkpoint_cv.notify_all();
+	if (settings_writer.joinable()) settings_writer.join();
 
-			bot.start_timer(RecurringBackupTask{ bot, path, interval }, interval);
-		}, initial_delay);
-	};
+	// Whatever is still only in the log goes into the snapshot
+	checkpoint_guild_settings();
+}
 
-	schedule_backup("backups/backup-hourly/guild_settings.json", seconds_to_next_hour, one_hour);
-	schedule_backup("backups/backup-per-12h/guild_settings.json", seconds_to_next_12_hr_mark, twelve_hours);
-	schedule_backup("backups/backup-daily/guild_settings.json", seconds_to_next_midnight, one_day);
+std::shared_ptr<const GuildSettingsSnapshot> checkpointed_guild_settings() {
+	checkpoint_guild_settings();
+	return guild_settings.load()->snapshot;
 }
@@ -23,9 +23,10 @@
 /*
  * The following includes are performed:
  * #include <string>
+ * #include <string_view>
  * #include <optional>
+ * #include <memory>
  * #include <cstdint>
- * #include <dpp/cluster.h>
  */
 
 #include <pch.hpp>
@@ -37,19 +38,51 @@
 */
 inline std::string convert_time(uint64_t total_seconds);
 
+// The longest prefix of `text` of at most `max_bytes` bytes that doesn't cut a UTF-8 code point in half
+std::string_view utf8_prefix(const std::string_view text, const std::size_t max_bytes);
+
 enum class CommandType {
 	RoleEdit,
 	BanEdit,
 	Unknown
 };
 
+inline constexpr std::size_t command_type_count{ 3 };
+
 std::optional<uint64_t> get_log_channel(const uint64_t guild_id, const CommandType command_type);
 void save_log_channel(const uint64_t guild_id, const uint64_t channel_id, const CommandType command_type);
 
+// A webhook the bot created in a log channel, audit logs are delivered through it when there is one
+struct LogWebhook {
+	uint64_t id{ 0 };
+	std::string token{};
+
+	bool operator==(const LogWebhook&) const = default;
+};
+
+// Returns nothing when the webhook's token isn't known, tokens are only kept in memory
+std::optional<LogWebhook> get_log_webhook(const uint64_t guild_id, const uint64_t channel_id);
+// The ID of the webhook stored for a log channel, whether or not its token is known
+std::optional<uint64_t> get_log_webhook_id(const uint64_t guild_id, const uint64_t channel_id);
+void save_log_webhook(const uint64_t guild_id, const uint64_t channel_id, const LogWebhook& webhook);
+// Called once a webhook turns out to be deleted, the channel falls back to bot messages
+void forget_log_webhook(const uint64_t guild_id, const uint64_t channel_id);
+
+// Each checkpoint writes the next `<path>.<number>`. A file at the path itself, ex. a restored backup, is taken as the newest on startup
+inline constexpr std::string_view guild_settings_snapshot_path{ "data/guild_settings.bin" };
+inline constexpr std::string_view guild_settings_log_path{ "data/guild_settings.wal" };
+
+// Maps the settings snapshot and replays the changes logged since it was written
 void load_guild_settings();
 
-// Backup handling
-void backup_guild_settings(const std::string& backup_file_path);
-void initialize_backups(dpp::cluster& bot);
+// The background writer that folds logged settings changes into a new snapshot
+void start_settings_writer();
+// Stops the writer after a last checkpoint
+void stop_settings_writer();
+
+class GuildSettingsSnapshot;
+
+// Folds the log into a new snapshot if anything changed, then returns the current snapshot
+std::shared_ptr<const GuildSettingsSnapshot> checkpointed_guild_settings();
 
 #endif // OTHER_UTILS_HPP
@@ -0,0 +1,103 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <string>
+ * #include <string_view>
+ * #include <vector>
+ * #include <mutex>
+ * #include <new>
+ * #include <stdexcept>
+ * #include <cstdlib>
+ * #include <cstdint>
+ * #include <dpp/message.h>
+ * #include <render/render.hpp>
+ * #include <secrets/secrets.hpp>
+ */
+
+#include <pch.hpp>
+
+#ifdef ISHMAEL_ALLOC_METRICS
+// Bumped by the global `operator new` below, read by `ReplyMeter`
+static thread_local uint64_t thread_allocations{ 0 };
+
+// Counting is the only change, the memory still comes from `malloc`
+void* operator new(std::size_t size) {
+	++thread_allocations;
+	if (void* p{ std::malloc(size == 0 ? 1 : size) }) return p;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+#endif // ISHMAEL_ALLOC_METRICS
+
+namespace render {
+	static std::string owner_mention_text{};
+	static std::string exception_text{};
+
+	static std::mutex stats_mtx;
+	static std::vector<ReplyStats> reply_stats{};
+
+	void init() {
+		constexpr Template<1> mention{ "<@{}>" };
+		constexpr Template<1> exception{ "An exception was thrown while processing this command. Please inform {} of this." };
+
+		owner_mention_text = mention(secrets.at("OWNER_ID"));
+		exception_text = exception(owner_mention_text);
+	}
+
+	const std::string& owner_mention() {
+		return owner_mention_text;
+	}
+
+	dpp::message exception_reply() {
+		return dpp::message{ exception_text }.set_flags(dpp::m_ephemeral);
+	}
+
+	EmbedTemplate::EmbedTemplate(dpp::embed embed_prototype) : prototype{ std::move(embed_prototype) } {
+		for (std::size_t i{ 0 }; i < prototype.fields.size(); ++i) if (prototype.fields[i].value.empty()) value_slots.push_back(i);
+	}
+
+#ifdef ISHMAEL_ALLOC_METRICS
+	ReplyMeter::ReplyMeter(const std::string_view command) : command{ command }, started_at{ thread_allocations } {}
+
+	ReplyMeter::~ReplyMeter() {
+		const uint64_t allocations{ thread_allocations - started_at };
+
+		std::scoped_lock lock{ stats_mtx };
+		for (ReplyStats& stats : reply_stats) {
+			if (stats.command != command) continue;
+			++stats.replies;
+			stats.allocations += allocations;
+			return;
+		}
+		reply_stats.push_back(ReplyStats{ .command = command, .replies = 1, .allocations = allocations });
+	}
+#endif // ISHMAEL_ALLOC_METRICS
+
+	std::vector<ReplyStats> get_reply_stats() {
+		std::scoped_lock lock{ stats_mtx };
+		return reply_stats;
+	}
+}
@@ -0,0 +1,244 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <string>
+ * #include <string_view>
+ * #include <vector>
+ * #include <array>
+ * #include <memory_resource>
+ * #include <charconv>
+ * #include <format>
+ * #include <iterator>
+ * #include <type_traits>
+ * #include <stdexcept>
+ * #include <cstdint>
+ * #include <dpp/message.h>
+ * #include <dpp/snowflake.h>
+ */
+
+#include <pch.hpp>
+
+namespace render {
+	// Builds the constant fragments, must be called once the secrets are loaded
+	void init();
+
+	// "<@owner ID>"
+	const std::string& owner_mention();
+
+	// The ephemeral reply of a handler that caught an exception
+	dpp::message exception_reply();
+
+	/*
+	 * @brief A message pattern with `{}` slots, split into its literal parts at compile time
+	 *
+	 * Rendering converts the arguments first and sizes the result before writing it,
+	 * so a reply costs one allocation (none if it fits the small string buffer)
+	 * Arguments are anything convertible to `std::string_view`, integers and snowflakes
+	 */
+	template <std::size_t Slots>
+	class Template {
+	public:
+		consteval Template(const char* pattern) {
+			const std::string_view text{ pattern };
+			std::size_t slot{ 0 }, begin{ 0 };
+			for (std::size_t i{ 0 }; i + 1 < text.size(); ++i) {
+				if (text[i] != '{' || text[i + 1] != '}') continue;
+				if (slot == Slots) throw std::logic_error("The pattern has more slots than the template");
+				literals[slot++] = text.substr(begin, i - begin);
+				begin = i + 2;
+				++i;
+			}
+			if (slot != Slots) throw std::logic_error("The pattern has fewer slots than the template");
+			literals[Slots] = text.substr(begin);
+			for (const std::string_view literal : literals) literal_size += literal.size();
+		}
+
+		template <typename... Args>
+		std::string operator()(const Args&... args) const {
+			std::string out{};
+			write(out, args...);
+			return out;
+		}
+
+		// Appends to a string of an arena
+		template <typename... Args>
+		void append_to(std::pmr::string& out, const Args&... args) const {
+			write(out, args...);
+		}
+
+	private:
+		struct Piece {
+			std::string_view text{};
+			std::array<char, 20> digits{};
+			std::size_t digit_count{ 0 };
+
+			std::string_view view() const { return digit_count > 0 ? std::string_view{ digits.data(), digit_count } : text; }
+		};
+
+		std::array<std::string_view, Slots + 1> literals{};
+		std::size_t literal_size{ 0 };
+
+		template <typename T>
+		static Piece to_piece(const T& arg) {
+			Piece piece{};
+			if constexpr (std::is_convertible_v<const T&, std::string_view>) piece.text = arg;
+			else {
+				char* const first{ piece.digits.data() };
+				char* const last{ first + piece.digits.size() };
+				std::to_chars_result result{};
+				if constexpr (std::is_same_v<T, dpp::snowflake>) result = std::to_chars(first, last, static_cast<uint64_t>(arg));
+				else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) result = std::to_chars(first, last, static_cast<int64_t>(arg));
+				else {
+					static_assert(std::is_integral_v<T>, "Template arguments are strings, integers or snowflakes");
+					result = std::to_chars(first, last, static_cast<uint64_t>(arg));
+				}
+				piece.digit_count = static_cast<std::size_t>(result.ptr - first);
+			}
+			return piece;
+		}
+
+		template <typename String, typename... Args>
+		void write(String& out, const Args&... args) const {
+			static_assert(sizeof...(Args) == Slots, "The template takes a different number of arguments");
+			const std::array<Piece, Slots> pieces{ to_piece(args)... };
+
+			std::size_t size{ out.size() + literal_size };
+			for (const Piece& piece : pieces) size += piece.view().size();
+			out.reserve(size);
+
+			for (std::size_t i{ 0 }; i < Slots; ++i) {
+				out.append(literals[i]);
+				out.append(pieces[i].view());
+			}
+			out.append(literals[Slots]);
+		}
+	};
+
+	/*
+	 * @brief An embed whose colour, title and fields are laid out once
+	 *
+	 * Each reply copies the prototype, which sizes the field list in one go, and moves
+	 * its values into the fields the prototype left empty, in order
+	 */
+	class EmbedTemplate {
+	public:
+		explicit EmbedTemplate(dpp::embed embed_prototype);
+
+		template <typename... Values>
+		dpp::embed operator()(Values&&... values) const {
+			if (sizeof...(Values) != value_slots.size()) throw std::logic_error("The embed template takes a different number of values");
+
+			dpp::embed embed{ prototype };
+			std::size_t slot{ 0 };
+			((embed.fields[value_slots[slot++]].value = std::forward<Values>(values)), ...);
+			return embed;
+		}
+
+	private:
+		dpp::embed prototype;
+		std::vector<std::size_t> value_slots; // Indices of the fields filled per reply
+	};
+
+	/*
+	 * @brief Scratch memory for the temporary strings of one reply
+	 *
+	 * The first few KiB come from a buffer inside the arena itself, and nothing is freed
+	 * before the arena goes away, so building up a field line by line costs no allocation
+	 * Only the final copy handed to D++ goes to the heap
+	 */
+	class Arena {
+	public:
+		Arena() = default;
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		std::pmr::string string() {
+			return std::pmr::string{ &resource };
+		}
+
+		template <typename... Args>
+		std::pmr::string format(std::format_string<Args...> fmt, Args&&... args) {
+			std::pmr::string out{ &resource };
+			std::format_to(std::back_inserter(out), fmt, std::forward<Args>(args)...);
+			return out;
+		}
+
+		template <typename... Args>
+		static void format_to(std::pmr::string& out, std::format_string<Args...> fmt, Args&&... args) {
+			std::format_to(std::back_inserter(out), fmt, std::forward<Args>(args)...);
+		}
+
+	private:
+		std::array<std::byte, 4096> buffer;
+		std::pmr::monotonic_buffer_resource resource{ buffer.data(), buffer.size() };
+	};
+
+	// Copies a string of an arena into one D++ can own
+	inline std::string to_string(const std::pmr::string& text) {
+		return std::string{ text.data(), text.size() };
+	}
+
+	struct ReplyStats {
+		std::string_view command{};
+		uint64_t replies{ 0 };
+		uint64_t allocations{ 0 };
+	};
+
+	/*
+	 * @brief Counts the heap allocations this thread makes while rendering a reply
+	 *
+	 * Counting replaces the global `operator new`, so it is only built with the `ISHMAEL_ALLOC_METRICS`
+	 * CMake option. Without it the meter does nothing
+	 * Must not live across a `co_await`, the coroutine may resume on another thread
+	 * The totals per command are shown in `/stats`
+	 */
+#ifdef ISHMAEL_ALLOC_METRICS
+	inline constexpr bool alloc_metrics_enabled{ true };
+
+	class ReplyMeter {
+	public:
+		explicit ReplyMeter(const std::string_view command);
+		ReplyMeter(const ReplyMeter&) = delete;
+		ReplyMeter& operator=(const ReplyMeter&) = delete;
+		~ReplyMeter();
+
+	private:
+		std::string_view command;
+		uint64_t started_at;
+	};
+#else // ^^^ ISHMAEL_ALLOC_METRICS || !ISHMAEL_ALLOC_METRICS vvv
+	inline constexpr bool alloc_metrics_enabled{ false };
+
+	class ReplyMeter {
+	public:
+		explicit ReplyMeter(const std::string_view) {}
+		ReplyMeter(const ReplyMeter&) = delete;
+		ReplyMeter& operator=(const ReplyMeter&) = delete;
+	};
+#endif // ISHMAEL_ALLOC_METRICS
+
+	std::vector<ReplyStats> get_reply_stats();
+}
+
+#endif // RENDER_HPP
@@ -0,0 +1,316 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <array>
+ * #include <deque>
+ * #include <vector>
+ * #include <string>
+ * #include <string_view>
+ * #include <charconv>
+ * #include <unordered_map>
+ * #include <functional>
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <thread>
+ * #include <chrono>
+ * #include <algorithm>
+ * #include <exception>
+ * #include <cstdint>
+ * #include <dpp/restresults.h>
+ * #include <dpp/coro.h>
+ * #include <rest_scheduler/rest_scheduler.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+RestScheduler rest_scheduler;
+RestScheduler webhook_scheduler;
+
+// How many calls each lane may hold before it starts shedding (or rejecting, for interactions)
+static constexpr std::array<std::size_t, rest_lane_count> lane_capacity{ 1024, 512, 256 };
+
+// Past this many queued calls in total, new background calls are shed right away
+static constexpr std::size_t pressure_threshold{ 512 };
+
+// Discord allows 50 requests per second globally, keep some headroom for D++'s own calls
+static constexpr double global_rate_per_second{ 45.0 };
+
+static dpp::confirmation_callback_t make_shed_result() {
+	dpp::confirmation_callback_t result{};
+	result.http_info.status = 429;
+	result.http_info.body = R"({"message":"Dropped by the REST scheduler under load","code":0})";
+	return result;
+}
+
+static constexpr std::size_t lane_index(const RestLane lane) {
+	return static_cast<std::size_t>(lane);
+}
+
+RestScheduler::~RestScheduler() {
+	stop();
+}
+
+void RestScheduler::start() {
+	if (running.exchange(true)) return;
+
+	{
+		std::scoped_lock lock{ mtx };
+		global_tokens = global_rate_per_second;
+		global_refilled_at = clock::now();
+	}
+
+	dispatcher = std::thread{ [this] { dispatch_loop(); } };
+}
+
+std::size_t RestScheduler::stop() {
+	if (!running.exchange(false)) return 0;
+
+	{
+		std::scoped_lock lock{ mtx };
+	}
+	cv.notify_all();
+	if (dispatcher.joinable()) dispatcher.join();
+
+	// Whatever is left is shed so awaiting coroutines resume
+	std::vector<Request> leftovers{};
+	{
+		std::scoped_lock lock{ mtx };
+		for (std::size_t i{ 0 }; i < rest_lane_count; ++i) {
+			for (Request& request : lanes[i]) leftovers.push_back(std::move(request));
+			lane_stats[i].shed += lanes[i].size();
+			lane_stats[i].queue_depth = 0;
+			lanes[i].clear();
+		}
+	}
+	idle_cv.notify_all();
+
+	if (!leftovers.empty()) Logger::warn(true, "REST scheduler stopped, {} queued calls were dropped", leftovers.size());
+
+	const dpp::confirmation_callback_t shed_result{ make_shed_result() };
+	for (Request& request : leftovers) if (request.callback) request.callback(shed_result);
+
+	return leftovers.size();
+}
+
+bool RestScheduler::submit(const RestLane lane, std::string route, RestCall call, dpp::command_completion_event_t callback) {
+	Request request{ .call = std::move(call), .callback = std::move(callback), .route = std::move(route), .enqueued = clock::now() };
+	std::vector<Request> shed_requests{};
+	bool accepted{ true };
+
+	{
+		std::scoped_lock lock{ mtx };
+		std::deque<Request>& queue{ lanes[lane_index(lane)] };
+
+		std::size_t total_queued{ 0 };
+		for (const auto& q : lanes) total_queued += q.size();
+
+		if (!running.load() || (lane == RestLane::Background && total_queued >= pressure_threshold)) accepted = false;
+		else if (queue.size() >= lane_capacity[lane_index(lane)]) {
+			// A full interaction lane pushes back on the caller, the other lanes drop their oldest call
+			if (lane == RestLane::Interaction) accepted = false;
+			else {
+				shed_requests.push_back(std::move(queue.front()));
+				queue.pop_front();
+				++lane_stats[lane_index(lane)].shed;
+			}
+		}
+
+		if (accepted) {
+			queue.push_back(std::move(request));
+			lane_stats[lane_index(lane)].queue_depth = queue.size();
+		}
+		else ++lane_stats[lane_index(lane)].shed;
+	}
+
+	if (accepted) cv.notify_one();
+	else shed_requests.push_back(std::move(request));
+
+	const dpp::confirmation_callback_t shed_result{ make_shed_result() };
+	for (Request& shed_request : shed_requests) if (shed_request.callback) shed_request.callback(shed_result);
+
+	return accepted;
+}
+
+dpp::async<dpp::confirmation_callback_t> RestScheduler::co_submit(const RestLane lane, std::string route, RestCall call) {
+	return dpp::async<dpp::confirmation_callback_t>{ [this, lane, route = std::move(route), call = std::move(call)](auto&& callback) mutable {
+		submit(lane, std::move(route), std::move(call), std::forward<decltype(callback)>(callback));
+	} };
+}
+
+bool RestScheduler::wait_idle(const clock::time_point deadline) {
+	std::unique_lock lock{ mtx };
+	return idle_cv.wait_until(lock, deadline, [this] {
+		return in_flight == 0 && std::all_of(lanes.begin(), lanes.end(), [](const auto& queue) { return queue.empty(); });
+	});
+}
+
+std::array<RestLaneStats, rest_lane_count> RestScheduler::get_lane_stats() const {
+	std::scoped_lock lock{ mtx };
+	return lane_stats;
+}
+
+// Must be called with `mtx` held
+std::string RestScheduler::bucket_key(const std::string& route) const {
+	const std::size_t split{ route.rfind(':') };
+	const auto it{ endpoint_buckets.find(split == std::string::npos ? route : route.substr(0, split)) };
+	if (it == endpoint_buckets.end()) return route;
+
+	// The bucket Discord named, still apart per major parameter
+	return split == std::string::npos ? it->second : it->second + route.substr(split);
+}
+
+// Must be called with `mtx` held
+bool RestScheduler::is_bucket_ready(const std::string& bucket_name, const clock::time_point now) {
+	Bucket& bucket{ buckets[bucket_name] };
+
+	if (bucket.remaining == 0 && now >= bucket.reset_at) bucket.remaining = std::max<uint64_t>(bucket.limit, 1);
+
+	// Don't run past what the bucket has left, counting the calls still in flight
+	return bucket.remaining > bucket.in_flight;
+}
+
+void RestScheduler::dispatch_loop() {
+	while (running.load()) {
+		std::unique_lock lock{ mtx };
+
+		const clock::time_point now{ clock::now() };
+
+		// Refill the global budget
+		global_tokens = std::min(global_rate_per_second,
+			global_tokens + std::chrono::duration<double>(now - global_refilled_at).count() * global_rate_per_second);
+		global_refilled_at = now;
+
+		std::optional<Request> next{};
+		std::string next_bucket{};
+		std::size_t next_lane{ 0 };
+
+		if (global_tokens >= 1.0 && now >= global_blocked_until) {
+			// Strict priority: take the oldest call of the highest lane whose route has room
+			for (std::size_t i{ 0 }; i < rest_lane_count && !next.has_value(); ++i) {
+				for (auto it{ lanes[i].begin() }; it != lanes[i].end(); ++it) {
+					std::string bucket{ bucket_key(it->route) };
+					if (!is_bucket_ready(bucket, now)) continue;
+					next = std::move(*it);
+					next_bucket = std::move(bucket);
+					lanes[i].erase(it);
+					next_lane = i;
+					break;
+				}
+			}
+		}
+
+		// Forget idle buckets once there are many of them, they're recreated on the next call
+		if (buckets.size() > 4096) std::erase_if(buckets, [now](const auto& pair) { return pair.second.in_flight == 0 && now >= pair.second.reset_at; });
+
+		if (!next.has_value()) {
+			// Nothing can go out yet, sleep until something is submitted or a bucket may have reset
+			cv.wait_for(lock, std::chrono::milliseconds{ 50 });
+			continue;
+		}
+
+		global_tokens -= 1.0;
+		++buckets[next_bucket].in_flight;
+		++in_flight;
+
+		RestLaneStats& stats{ lane_stats[next_lane] };
+		const auto waited{ std::chrono::duration_cast<std::chrono::microseconds>(now - next->enqueued) };
+		++stats.dispatched;
+		stats.queue_depth = lanes[next_lane].size();
+		stats.total_wait += waited;
+		if (waited > stats.max_wait) stats.max_wait = waited;
+
+		lock.unlock();
+
+		try {
+			next->call([this, route = next->route, bucket = next_bucket, callback = next->callback](const dpp::confirmation_callback_t& result) {
+				on_complete(route, bucket, result);
+				run_callback(route, callback, result);
+			});
+		}
+		catch (const std::exception& e) {
+			Logger::exception(false, "Exception while issuing a REST call for `{}`: {}", next->route, std::string{ e.what() });
+			const dpp::confirmation_callback_t shed_result{ make_shed_result() };
+			on_complete(next->route, next_bucket, shed_result);
+			run_callback(next->route, next->callback, shed_result);
+		}
+	}
+}
+
+// Discord sends the reset in fractional seconds, D++'s `ratelimit_reset_after` only keeps the whole part
+static std::chrono::milliseconds reset_after(const dpp::http_request_completion_t& http) {
+	if (const auto it{ http.headers.find("x-ratelimit-reset-after") }; it != http.headers.end()) {
+		const std::string_view value{ it->second };
+		double seconds{ 0 };
+		const auto [end, error] { std::from_chars(value.data(), value.data() + value.size(), seconds) };
+		if (error == std::errc{} && seconds >= 0) return std::chrono::ceil<std::chrono::milliseconds>(std::chrono::duration<double>{ seconds });
+	}
+
+	// Rounded up, a bucket that reopens a little late costs less than a 429
+	return std::chrono::seconds{ http.ratelimit_reset_after + 1 };
+}
+
+// `bucket_name` is the bucket the call was counted in when it was dispatched
+void RestScheduler::on_complete(const std::string& route, const std::string& bucket_name, const dpp::confirmation_callback_t& result) {
+	{
+		std::scoped_lock lock{ mtx };
+		const clock::time_point now{ clock::now() };
+		const dpp::http_request_completion_t& http{ result.http_info };
+
+		Bucket& dispatched{ buckets[bucket_name] };
+		if (dispatched.in_flight > 0) --dispatched.in_flight;
+
+		// Learn which bucket the endpoint belongs to, the headers below then apply to every endpoint sharing it
+		if (!http.ratelimit_bucket.empty()) {
+			const std::size_t split{ route.rfind(':') };
+			endpoint_buckets[split == std::string::npos ? route : route.substr(0, split)] = http.ratelimit_bucket;
+		}
+		Bucket& bucket{ buckets[bucket_key(route)] };
+
+		if (http.status == 429) {
+			const auto retry_after{ std::chrono::seconds{ std::max<uint64_t>(http.ratelimit_retry_after, 1) } };
+			if (http.ratelimit_global) global_blocked_until = now + retry_after;
+			bucket.remaining = 0;
+			bucket.reset_at = now + retry_after;
+		}
+		else if (http.ratelimit_limit > 0) {
+			bucket.limit = http.ratelimit_limit;
+			bucket.remaining = http.ratelimit_remaining;
+			bucket.reset_at = now + reset_after(http);
+		}
+		else bucket.remaining = std::max<uint64_t>(bucket.remaining, 1);
+	}
+	cv.notify_one();
+}
+
+// The call counts as in flight until its callback returns, callbacks may still use the cluster
+void RestScheduler::run_callback(const std::string& route, const dpp::command_completion_event_t& callback, const dpp::confirmation_callback_t& result) {
+	try {
+		if (callback) callback(result);
+	}
+	catch (const std::exception& e) {
+		Logger::exception(false, "Exception escaped the callback of a REST call for `{}`: {}", route, std::string{ e.what() });
+	}
+
+	{
+		std::scoped_lock lock{ mtx };
+		if (in_flight > 0) --in_flight;
+	}
+	idle_cv.notify_all();
+}
@@ -0,0 +1,160 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef REST_SCHEDULER_HPP
+#define REST_SCHEDULER_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <array>
+ * #include <deque>
+ * #include <string>
+ * #include <string_view>
+ * #include <format>
+ * #include <unordered_map>
+ * #include <functional>
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <thread>
+ * #include <atomic>
+ * #include <chrono>
+ * #include <cstdint>
+ * #include <dpp/restresults.h>
+ * #include <dpp/coro.h>
+ */
+
+#include <pch.hpp>
+
+// Lanes are served in strict priority order, the first one first
+enum class RestLane : uint8_t {
+	Interaction, // Calls a user is waiting on
+	AuditLog,
+	Background, // Command registration, cleanups and other housekeeping
+};
+
+inline constexpr std::size_t rest_lane_count{ 3 };
+
+struct RestLaneStats {
+	uint64_t queue_depth{ 0 };
+	uint64_t dispatched{ 0 };
+	uint64_t shed{ 0 }; // Dropped or rejected under pressure
+	std::chrono::microseconds total_wait{ 0 };
+	std::chrono::microseconds max_wait{ 0 };
+};
+
+/*
+ * @brief Builds the route key of a call, ex. `rest_route("message_create", channel_id)`
+ * @param name The endpoint, one name per method and path
+ * @param major_parameter The channel, guild or webhook the call is on, Discord rate limits each of them apart
+ */
+inline std::string rest_route(const std::string_view name, const uint64_t major_parameter) {
+	return std::format("{}:{}", name, major_parameter);
+}
+
+/*
+ * @brief Central queue for outgoing `dpp::cluster` REST calls
+ *
+ * Each call is tagged with a lane and a route key, see `rest_route`
+ * Until Discord names the bucket of an endpoint (`X-RateLimit-Bucket`), each route key is its own bucket
+ * Afterwards, every endpoint sharing that bucket is limited together, still per major parameter
+ * Calls are held back until their bucket has room, while other buckets keep flowing
+ * A global budget caps the total request rate
+ */
+class RestScheduler {
+public:
+	using clock = std::chrono::steady_clock;
+
+	// Issues the D++ call, which must invoke the callback it is given
+	using RestCall = std::function<void(dpp::command_completion_event_t)>;
+
+	RestScheduler() = default;
+	RestScheduler(const RestScheduler&) = delete;
+	RestScheduler& operator=(const RestScheduler&) = delete;
+	RestScheduler(RestScheduler&&) = delete;
+	RestScheduler& operator=(RestScheduler&&) = delete;
+	~RestScheduler();
+
+	void start();
+	// Stops the dispatcher, shedding whatever is still queued. Returns the number of shed calls
+	std::size_t stop();
+
+	/*
+	 * @brief Queues a REST call
+	 * @param lane The priority lane of the call
+	 * @param route The rate limit bucket the call falls in
+	 * @param call Issues the call
+	 * @param callback Called with the result, or with a synthetic 429 if the call is shed
+	 * @return false if the call was rejected because its lane is full, `callback` has been called already
+	 */
+	bool submit(const RestLane lane, std::string route, RestCall call, dpp::command_completion_event_t callback = {});
+
+	// Awaitable version of `submit`
+	dpp::async<dpp::confirmation_callback_t> co_submit(const RestLane lane, std::string route, RestCall call);
+
+	// Waits until no call is queued, in flight or running its callback. Returns false if `deadline` passed first
+	bool wait_idle(const clock::time_point deadline);
+
+	std::array<RestLaneStats, rest_lane_count> get_lane_stats() const;
+
+private:
+	struct Request {
+		RestCall call;
+		dpp::command_completion_event_t callback;
+		std::string route;
+		clock::time_point enqueued;
+	};
+
+	struct Bucket {
+		uint64_t limit{ 0 }; // 0 until Discord tells us
+		uint64_t remaining{ 1 }; // Unknown buckets get one call at a time
+		clock::time_point reset_at{};
+		uint32_t in_flight{ 0 };
+	};
+
+	mutable std::mutex mtx;
+	std::condition_variable cv;
+	std::condition_variable idle_cv; // Notified when the last in flight call completes
+	std::size_t in_flight{ 0 }; // Dispatched calls whose callback hasn't returned yet
+	std::thread dispatcher;
+	std::atomic_bool running{ false };
+
+	std::array<std::deque<Request>, rest_lane_count> lanes;
+	std::array<RestLaneStats, rest_lane_count> lane_stats{};
+	std::unordered_map<std::string, Bucket> buckets; // Keyed by `bucket_key`
+	std::unordered_map<std::string, std::string> endpoint_buckets; // Endpoint name to the bucket Discord reported for it
+
+	// Global token bucket
+	double global_tokens{ 0.0 };
+	clock::time_point global_refilled_at{};
+	clock::time_point global_blocked_until{};
+
+	void dispatch_loop();
+	std::string bucket_key(const std::string& route) const;
+	bool is_bucket_ready(const std::string& bucket, const clock::time_point now);
+	void on_complete(const std::string& route, const std::string& bucket, const dpp::confirmation_callback_t& result);
+	void run_callback(const std::string& route, const dpp::command_completion_event_t& callback, const dpp::confirmation_callback_t& result);
+};
+
+// The scheduler all REST calls that don't answer an interaction directly go through
+extern RestScheduler rest_scheduler;
+
+// Webhook executions, kept apart so audit logs have their own budget and queue
+extern RestScheduler webhook_scheduler;
+
+#endif // REST_SCHEDULER_HPP
@@ -0,0 +1,97 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The following includes are performed:
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <chrono>
+ * #include <cstdint>
+ * #include <shutdown/shutdown.hpp>
+ * #include <config/config.hpp>
+ * #include <executor/executor.hpp>
+ * #include <rest_scheduler/rest_scheduler.hpp>
+ * #include <moderation/audit_batcher.hpp>
+ * #include <other_utils/other_utils.hpp>
+ * #include <backup/backup.hpp>
+ * #include <logger/logger.hpp>
+ */
+
+#include <pch.hpp>
+
+InFlightTracker pending_interactions;
+InFlightTracker pending_writes;
+
+std::chrono::milliseconds shutdown_drain_deadline() {
+	return config_milliseconds("SHUTDOWN_DRAIN_MS", default_shutdown_drain_deadline);
+}
+
+InFlightTracker::Guard InFlightTracker::track() {
+	std::scoped_lock lock{ mtx };
+	++active;
+	return Guard{ this };
+}
+
+void InFlightTracker::release() {
+	{
+		std::scoped_lock lock{ mtx };
+		if (active > 0) --active;
+		if (active > 0) return;
+	}
+	idle_cv.notify_all();
+}
+
+bool InFlightTracker::wait_idle(const clock::time_point deadline) {
+	std::unique_lock lock{ mtx };
+	return idle_cv.wait_until(lock, deadline, [this] { return active == 0; });
+}
+
+std::size_t InFlightTracker::count() const {
+	std::scoped_lock lock{ mtx };
+	return active;
+}
+
+ShutdownReport drain_for_shutdown(const InFlightTracker::clock::time_point deadline) {
+	const auto started{ InFlightTracker::clock::now() };
+
+	// New interactions are turned away from here on, the queued ones still run
+	command_executor.close();
+
+	// Each stage only gets what is left of the deadline, a stage that times out doesn't skip the others
+	const bool executor_idle{ command_executor.wait_idle(deadline) };
+	const bool interactions_idle{ pending_interactions.wait_idle(deadline) };
+	// Handlers are done logging, so the buffered audit logs can go out without waiting for their window
+	audit_batcher.stop();
+	const bool rest_idle{ rest_scheduler.wait_idle(deadline) && webhook_scheduler.wait_idle(deadline) };
+	// A backup in progress is abandoned, settings changes still only in the log are folded into the snapshot
+	backup_engine.stop();
+	stop_settings_writer();
+	const bool writes_idle{ pending_writes.wait_idle(deadline) };
+
+	ShutdownReport report{};
+	report.dropped_jobs = command_executor.stop();
+	report.unfinished_interactions = pending_interactions.count();
+	report.dropped_rest_calls = rest_scheduler.stop() + webhook_scheduler.stop();
+	report.unfinished_writes = pending_writes.count();
+	report.took = std::chrono::duration_cast<std::chrono::milliseconds>(InFlightTracker::clock::now() - started);
+
+	if (executor_idle && interactions_idle && rest_idle && writes_idle) Logger::info(true, "Drained all work in {} ms", report.took.count());
+	else Logger::warn(true, "Shutdown deadline hit after {} ms: {} jobs and {} REST calls dropped, {} interactions and {} writes unfinished",
+		report.took.count(), report.dropped_jobs, report.dropped_rest_calls, report.unfinished_interactions, report.unfinished_writes);
+
+	return report;
+}
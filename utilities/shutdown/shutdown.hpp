@@ -0,0 +1,100 @@
+/*
+* Copyright (C) 2025 Omega493
+
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHUTDOWN_HPP
+#define SHUTDOWN_HPP
+
+#pragma once
+
+/*
+ * The following includes are performed:
+ * #include <mutex>
+ * #include <condition_variable>
+ * #include <chrono>
+ * #include <utility>
+ * #include <cstdint>
+ */
+
+#include <pch.hpp>
+
+// How long a shutdown may spend draining before whatever is left is dropped, unless `SHUTDOWN_DRAIN_MS` is set in the config
+constexpr std::chrono::seconds default_shutdown_drain_deadline{ 10 };
+
+std::chrono::milliseconds shutdown_drain_deadline();
+
+/*
+ * @brief Counts work that is in progress outside of the executor and the REST scheduler
+ *
+ * `track()` returns a guard that counts as one piece of work until it is destroyed
+ */
+class InFlightTracker {
+public:
+	using clock = std::chrono::steady_clock;
+
+	class Guard {
+	public:
+		explicit Guard(InFlightTracker* tracker) noexcept : tracker{ tracker } {}
+		Guard(Guard&& other) noexcept : tracker{ std::exchange(other.tracker, nullptr) } {}
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+		Guard& operator=(Guard&&) = delete;
+		~Guard() { if (tracker) tracker->release(); }
+
+	private:
+		InFlightTracker* tracker;
+	};
+
+	[[nodiscard]] Guard track();
+
+	// Waits until nothing is tracked. Returns false if `deadline` passed first
+	bool wait_idle(const clock::time_point deadline);
+
+	std::size_t count() const;
+
+private:
+	mutable std::mutex mtx;
+	std::condition_variable idle_cv;
+	std::size_t active{ 0 };
+
+	void release();
+};
+
+// Coroutine command handlers that haven't finished yet
+extern InFlightTracker pending_interactions;
+
+// Guild settings writes and backups that haven't reached the disk yet
+extern InFlightTracker pending_writes;
+
+// What a shutdown couldn't finish before its deadline
+struct ShutdownReport {
+	std::size_t dropped_jobs{ 0 };
+	std::size_t dropped_rest_calls{ 0 };
+	std::size_t unfinished_interactions{ 0 };
+	std::size_t unfinished_writes{ 0 };
+	std::chrono::milliseconds took{ 0 };
+};
+
+/*
+ * @brief Stops taking new interactions, then drains the command executor, coroutine handlers,
+ * the REST scheduler and pending writes, in that order
+ *
+ * Returns as soon as everything is idle, or once `deadline` has passed
+ * The executor and the REST scheduler are stopped afterwards, dropping whatever is still queued
+ */
+ShutdownReport drain_for_shutdown(const InFlightTracker::clock::time_point deadline);
+
+#endif // SHUTDOWN_HPP